@@ -1,27 +1,13 @@
-QT       += core gui
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-CONFIG += c++17
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    cprojectdialog.cpp \
-    main.cpp \
-    mainwindow.cpp
-
-HEADERS += \
-    cprojectdialog.h \
-    mainwindow.h
-
-FORMS += \
-    cprojectdialog.ui \
-    mainwindow.ui
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+# core: bild- och exportlogik utan QWidget (statiskt bibliotek)
+# app: programmet, runner: fönsterlös körning, tests: make check
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    core \
+    app \
+    runner \
+    tests
+
+app.depends = core
+runner.depends = core
+tests.depends = core
@@ -0,0 +1,33 @@
+TARGET = BeforeAfter
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+include(../core/core.pri)
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+    cprojectdialog.cpp \
+    loupe.cpp \
+    main.cpp \
+    mainwindow.cpp \
+    projectlistmodel.cpp
+
+HEADERS += \
+    cprojectdialog.h \
+    loupe.h \
+    mainwindow.h \
+    projectlistmodel.h
+
+FORMS += \
+    cprojectdialog.ui \
+    mainwindow.ui
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,65 @@
+#include "cprojectdialog.h"
+#include "ui_cprojectdialog.h"
+#include "projectlistmodel.h"
+#include "imageencoder.h"
+#include <QStandardItemModel>
+
+CProjectDialog::CProjectDialog(QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::CProjectDialog)
+{
+    ui->setupUi(this);
+}
+
+CProjectDialog::~CProjectDialog()
+{
+    delete ui;
+}
+
+void CProjectDialog::exec(const QList<QMap<QString,QVariant>>& allProjects, QStringList &selectedProjects, QString& title,
+                          ExportOptions& options, ThumbnailCache* thumbnails, MetadataIndex* metadata) {
+    ProjectListModel model(thumbnails);
+    model.setCheckable(true);
+    model.setMetadata(metadata);
+    model.setProjects(allProjects);
+    ui->sortByDateCheckBox->setEnabled(metadata != nullptr);
+    connect(ui->sortByDateCheckBox, &QCheckBox::toggled, &model, &ProjectListModel::sortByDate);
+    ProjectListModel::setupGridView(ui->projectList);
+    ui->projectList->setModel(&model);
+
+    ui->titleEdit->setText(title);
+    ui->budgetSpinBox->setValue(options.memoryBudgetMB);
+    ui->autoCropCheckBox->setChecked(options.autoCrop);
+    // WebP bara om Qts insticksmodul finns
+    if (!ImageEncoder::available(ExportOptions::WebP)) {
+        static_cast<QStandardItemModel*>(ui->formatCombo->model())->item(ExportOptions::WebP)->setEnabled(false);
+        if (options.imageFormat == ExportOptions::WebP) options.imageFormat = ExportOptions::Jpeg;
+    }
+    ui->formatCombo->setCurrentIndex(options.imageFormat);
+    ui->qualitySpinBox->setValue(options.quality);
+    ui->targetSizeSpinBox->setValue(options.targetKB);
+    ui->deepZoomCheckBox->setChecked(options.deepZoom);
+    ui->tileSizeCombo->setCurrentText(QString::number(options.tileSize));
+    ui->animationCheckBox->setChecked(options.wipeAnimation);
+    ui->framesSpinBox->setValue(options.animationFrames);
+    ui->animationWidthSpinBox->setValue(options.animationWidth);
+    ui->bundleCheckBox->setChecked(options.bundle);
+    ui->hashedAssetsCheckBox->setChecked(options.hashedAssets);
+    if (QDialog::exec()) {
+        title = ui->titleEdit->text();
+        options.memoryBudgetMB = ui->budgetSpinBox->value();
+        options.autoCrop = ui->autoCropCheckBox->isChecked();
+        options.imageFormat = ui->formatCombo->currentIndex();
+        options.quality = ui->qualitySpinBox->value();
+        options.targetKB = ui->targetSizeSpinBox->value();
+        options.deepZoom = ui->deepZoomCheckBox->isChecked();
+        options.tileSize = ui->tileSizeCombo->currentText().toInt();
+        options.wipeAnimation = ui->animationCheckBox->isChecked();
+        options.animationFrames = ui->framesSpinBox->value();
+        options.animationWidth = ui->animationWidthSpinBox->value();
+        options.bundle = ui->bundleCheckBox->isChecked();
+        options.hashedAssets = ui->hashedAssetsCheckBox->isChecked();
+        selectedProjects.append(model.checkedNames());
+    }
+    ui->projectList->setModel(nullptr);
+}
@@ -3,6 +3,9 @@
 
 #include <QDialog>
 #include <QListView>
+#include "exportoptions.h"
+#include "thumbnailcache.h"
+#include "imagemetadata.h"
 
 namespace Ui {
 class CProjectDialog;
@@ -15,7 +18,8 @@ class CProjectDialog : public QDialog
 public:
     explicit CProjectDialog(QWidget *parent = nullptr);
     ~CProjectDialog();
-    void exec(const QStringList& allProjects, QStringList& selectedProjects, QString& title);
+    void exec(const QList<QMap<QString,QVariant>>& allProjects, QStringList& selectedProjects, QString& title,
+              ExportOptions& options, ThumbnailCache* thumbnails, MetadataIndex* metadata = nullptr);
 private:
     Ui::CProjectDialog *ui;
 };
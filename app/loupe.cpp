@@ -0,0 +1,121 @@
+#include "loupe.h"
+#include <QPainter>
+#include <QHash>
+#include <qmath.h>
+
+Loupe::Loupe(QWidget* parent) : QWidget(parent), m_Tiles(64 * 1024 * 1024, this)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setFixedSize(paneSize * 2 + 3, paneSize + 18);
+    connect(&m_Tiles, &TileCache::ready, this, [this]() {
+        if (!isVisible()) return;
+        render();
+        update();
+    });
+    hide();
+}
+
+void Loupe::setSources(const Source& before, const Source& after)
+{
+    m_Sources[0] = before;
+    m_Sources[1] = after;
+    if (isVisible()) {
+        render();
+        update();
+    }
+}
+
+void Loupe::setZoom(int zoom)
+{
+    m_Zoom = zoom;
+    if (isVisible()) {
+        render();
+        update();
+    }
+}
+
+void Loupe::follow(const QPointF& scenePos, const QPoint& viewPos)
+{
+    m_Center = scenePos;
+    // Snett nedanför pekaren, på andra sidan om den inte får plats
+    QPoint p = viewPos + QPoint(24, 24);
+    if (p.x() + width() > parentWidget()->width()) p.setX(viewPos.x() - 24 - width());
+    if (p.y() + height() > parentWidget()->height()) p.setY(viewPos.y() - 24 - height());
+    move(p);
+    render();
+    update();
+}
+
+void Loupe::render()
+{
+    for (int i = 0; i < 2; i++) m_Panes[i] = renderPane(m_Sources[i]);
+}
+
+QImage Loupe::renderPane(const Source& source)
+{
+    QImage pane(paneSize, paneSize, QImage::Format_RGB32);
+    pane.fill(Qt::black);
+    if (source.size.isEmpty()) return pane;
+    bool invertible;
+    const QTransform inverse = source.transform.inverted(&invertible);
+    if (!invertible) return pane;
+
+    // Förebildens punkt -> bildens korrigerade punkt -> rå pixel, per rutpixel
+    QVector<QPoint> raw(paneSize * paneSize, QPoint(-1, -1));
+    QRect needed;
+    for (int y = 0; y < paneSize; y++) {
+        for (int x = 0; x < paneSize; x++) {
+            const QPointF o = m_Center + QPointF(x + 0.5 - paneSize / 2, y + 0.5 - paneSize / 2) / m_Zoom;
+            if (inverse.m13() * o.x() + inverse.m23() * o.y() + inverse.m33() <= 0) continue;
+            const QPointF s = source.lens.distort(inverse.map(o), source.size);
+            const QPoint p(qFloor(s.x()), qFloor(s.y()));
+            if (p.x() < 0 || p.y() < 0 || p.x() >= source.size.width() || p.y() >= source.size.height()) continue;
+            raw[y * paneSize + x] = p;
+            needed |= QRect(p, QSize(1, 1));
+        }
+    }
+    m_Tiles.request(source.path, needed, source.size);
+
+    // Närmaste pixel, så att originalets pixlar syns vid 4:1
+    const int ts = TileCache::tileSize;
+    const qreal px = source.proxy.isNull() ? 0 : qreal(source.proxy.width()) / source.size.width();
+    const qreal py = source.proxy.isNull() ? 0 : qreal(source.proxy.height()) / source.size.height();
+    QHash<quint64,QImage> tiles;
+    for (int y = 0; y < paneSize; y++) {
+        QRgb* line = reinterpret_cast<QRgb*>(pane.scanLine(y));
+        for (int x = 0; x < paneSize; x++) {
+            const QPoint p = raw[y * paneSize + x];
+            if (p.x() < 0) continue;
+            const quint64 k = (quint64(p.y() / ts) << 32) | quint32(p.x() / ts);
+            auto it = tiles.find(k);
+            if (it == tiles.end()) it = tiles.insert(k, m_Tiles.tile(source.path, p.x() / ts, p.y() / ts));
+            if (!it->isNull()) {
+                line[x] = it->pixel(p.x() % ts, p.y() % ts);
+            } else if (px > 0) {
+                line[x] = source.proxy.pixel(qMin(int(p.x() * px), source.proxy.width() - 1), qMin(int(p.y() * py), source.proxy.height() - 1));
+            }
+        }
+    }
+    source.lut.apply(pane);
+    return pane;
+}
+
+void Loupe::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().window());
+    const int c = paneSize / 2;
+    for (int i = 0; i < 2; i++) {
+        const QPoint origin(1 + i * (paneSize + 1), 1);
+        painter.drawImage(origin, m_Panes[i]);
+        // Hårkors i mitten, där ankaret hamnar
+        painter.setPen(i == 0 ? Qt::yellow : Qt::green);
+        painter.drawLine(origin + QPoint(c, c - 12), origin + QPoint(c, c - 3));
+        painter.drawLine(origin + QPoint(c, c + 3), origin + QPoint(c, c + 12));
+        painter.drawLine(origin + QPoint(c - 12, c), origin + QPoint(c - 3, c));
+        painter.drawLine(origin + QPoint(c + 3, c), origin + QPoint(c + 12, c));
+    }
+    painter.setPen(palette().windowText().color());
+    painter.drawText(QRect(0, paneSize + 2, width(), 16), Qt::AlignCenter,
+                     QString("Before | After   %1:1   (wheel to zoom)").arg(m_Zoom));
+}
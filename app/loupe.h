@@ -0,0 +1,46 @@
+#ifndef LOUPE_H
+#define LOUPE_H
+
+#include <QWidget>
+#include <QImage>
+#include <QTransform>
+#include "colourlut.h"
+#include "lensdistortion.h"
+#include "tilecache.h"
+
+// Förstoringsglas för ankarplaceringen. Visar förebilden och den transformerade
+// efterbilden runt pekaren i 1:1 eller 4:1, samplade direkt ur originalens rutor.
+// Scenen och huvudvyns zoom rörs inte. Rutor som ännu inte avkodats fylls från
+// proxyn tills de finns.
+
+class Loupe : public QWidget
+{
+public:
+    struct Source {
+        QString path;
+        QSize size;
+        QImage proxy;           // okorrigerad, se HighQualityImageItem::sourceImage
+        LensDistortion lens;
+        ColourLut lut;
+        QTransform transform;   // bildens koordinater -> förebildens
+    };
+    Loupe(QWidget* parent = nullptr);
+    void setSources(const Source& before, const Source& after);
+    void setZoom(int zoom);
+    int zoom() const { return m_Zoom; }
+    // scenePos är i förebildens koordinater, viewPos var pekaren står i vyn
+    void follow(const QPointF& scenePos, const QPoint& viewPos);
+protected:
+    void paintEvent(QPaintEvent* event) override;
+private:
+    void render();
+    QImage renderPane(const Source& source);
+    static constexpr int paneSize = 160;
+    Source m_Sources[2];
+    QImage m_Panes[2];
+    QPointF m_Center;
+    int m_Zoom = 1;
+    TileCache m_Tiles;
+};
+
+#endif // LOUPE_H
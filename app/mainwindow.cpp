@@ -0,0 +1,1237 @@
+#include "mainwindow.h"
+#include "ui_mainwindow.h"
+#include <QFileDialog>
+#include <QGraphicsPixmapItem>
+#include <QSettings>
+#include <QMessageBox>
+#include <QInputDialog>
+#include <QCloseEvent>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QDialogButtonBox>
+#include <QVBoxLayout>
+#include <QListWidget>
+#include <QLabel>
+#include <QDirIterator>
+#include <QPlainTextEdit>
+#include <QFontDatabase>
+#include <QDesktopServices>
+#include <qmath.h>
+#include "cprojectdialog.h"
+#include "stripexport.h"
+#include "imagepair.h"
+#include "gallerywriter.h"
+#include "gallerybundle.h"
+#include "previewserver.h"
+#include "projectstore.h"
+#include "epochstack.h"
+#include "projectvalues.h"
+#include "autoalign.h"
+#include "autostraighten.h"
+#include "anchorsolver.h"
+
+HighQualityImageItem::HighQualityImageItem(const QImage& image, QGraphicsItem* parent)
+    : QGraphicsItem(parent), m_Source(image.convertToFormat(QImage::Format_ARGB32_Premultiplied)), m_Image(m_Source),
+      m_OriginalSize(image.size()), m_transform()
+{
+    setFlag(QGraphicsItem::ItemIgnoresTransformations, false);
+}
+
+HighQualityImageItem::HighQualityImageItem(const QString &path, QGraphicsItem *parent) : QGraphicsItem(parent) {
+    load(path);
+}
+
+void HighQualityImageItem::setImage(const QImage& i)
+{
+    prepareGeometryChange();
+    // Samma format som ImagePrefetcher::decode, paint ska aldrig behöva konvertera
+    m_Source = i.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    m_Image = m_Source;
+    m_OriginalSize = i.size();
+    m_Perspective = QTransform();
+    m_ImageRect = QRectF(QPointF(0,0), m_OriginalSize);
+    updateMask();
+}
+
+void HighQualityImageItem::load(const QString& path, qint64 maxBytes, ImagePrefetcher* prefetcher)
+{
+    prepareGeometryChange();
+    m_Path = path;
+    // Förhämtad bild om den finns, annars avkodas den här
+    if (prefetcher) m_Source = prefetcher->take(path, maxBytes, &m_OriginalSize);
+    if (!prefetcher || m_Source.isNull()) m_Source = ImagePrefetcher::decode(path, maxBytes, &m_OriginalSize);
+    m_Image = m_Source;
+    m_Lut = ColourLut();
+    m_Lens = LensDistortion();
+    m_Filter = ScanFilter();
+    m_Perspective = QTransform();
+    m_ImageRect = QRectF(QPointF(0,0), m_OriginalSize);
+    updateMask();
+}
+
+void HighQualityImageItem::setColourLut(const ColourLut& lut)
+{
+    m_Lut = lut;
+    updateDisplayImage();
+}
+
+void HighQualityImageItem::setLensDistortion(const LensDistortion& lens)
+{
+    if (lens.key() == m_Lens.key()) return;
+    m_Lens = lens;
+    updateDisplayImage();
+}
+
+void HighQualityImageItem::setScanFilter(const ScanFilter& filter)
+{
+    if (filter.key() == m_Filter.key()) return;
+    m_Filter = filter;
+    updateDisplayImage();
+}
+
+void HighQualityImageItem::updateDisplayImage()
+{
+    // Filter, färg-, lins- och perspektivkorrigering görs en gång här, inte vid varje paint
+    prepareGeometryChange();
+    m_Image = ImagePair::perspectiveProxy(ImagePair::correctProxy(m_Source, m_OriginalSize, m_Lut, m_Lens, m_Filter),
+                                          m_OriginalSize, m_Perspective, &m_ImageRect);
+    updateMask();
+}
+
+void HighQualityImageItem::updateMask(const QRect& maskRect)
+{
+    if (!m_Mask || m_Mask->isNull() || m_Image.isNull()) {
+        m_Masked = QImage();
+        update();
+        return;
+    }
+    // Masken och visningsbilden täcker båda originalets ram, bara de ändrade
+    // rutorna räknas om medan man målar
+    const qreal scale = qreal(m_Mask->size().width()) / m_Image.width();
+    QRect rect = m_Image.rect();
+    if (m_Masked.size() != m_Image.size()) {
+        m_Masked = QImage(m_Image.size(), QImage::Format_ARGB32_Premultiplied);
+    } else if (!maskRect.isEmpty()) {
+        rect = QRectF(maskRect.x() / scale, maskRect.y() / scale, maskRect.width() / scale, maskRect.height() / scale)
+                   .toAlignedRect().adjusted(-1, -1, 1, 1).intersected(m_Image.rect());
+    }
+    QImage alpha(rect.size(), QImage::Format_Alpha8);
+    m_Mask->sample(alpha, rect.topLeft(), scale);
+    MaskLayer::multiply(m_Masked, m_Image, alpha, rect);
+    const qreal sx = m_ImageRect.width() / m_Image.width();
+    const qreal sy = m_ImageRect.height() / m_Image.height();
+    update(m_transform.mapRect(QRectF(m_ImageRect.x() + rect.x() * sx, m_ImageRect.y() + rect.y() * sy, rect.width() * sx, rect.height() * sy)));
+}
+
+void HighQualityImageItem::setTransformMatrix(const QTransform& transform)
+{
+    prepareGeometryChange();
+    // Resten ritas affint, lika billigt per bildruta som utan perspektiv
+    QTransform perspective;
+    ProjectValues::splitPerspective(transform, &perspective, &m_transform);
+    if (perspective != m_Perspective) {
+        m_Perspective = perspective;
+        updateDisplayImage();
+    }
+    update();
+}
+
+QRectF HighQualityImageItem::boundingRect() const
+{
+    return m_transform.mapRect(m_ImageRect);
+}
+
+void HighQualityImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
+{
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    painter->setTransform(m_transform, true);
+
+    // En proxy ritas utsträckt till originalets storlek
+    const bool masked = m_viewMode == MaskView && !m_Masked.isNull();
+    ImagePair::drawSplit(painter, m_ImageRect, masked ? m_Masked : m_Image, m_viewMode, m_splitFactor);
+
+    painter->setPen(m_OverlayPen);
+    painter->setBrush(m_OverlayBrush);
+    painter->drawPath(m_Perspective.map(m_OverlayPath));
+    painter->restore();
+}
+
+void HighQualityImageItem::setViewMode(ViewMode mode)
+{
+    m_viewMode = mode;
+    update();
+}
+
+void HighQualityImageItem::setSplitFactor(qreal factor)
+{
+    m_splitFactor = std::clamp(factor, 0.0, 1.0);
+    update();
+}
+
+QPointF HighQualityImageItem::mapToOriginal(const QPointF &pt) const
+{
+    bool invertible;
+    QTransform inverse = (m_Perspective * m_transform).inverted(&invertible);
+    if (invertible) {
+        return inverse.map(pt);
+    } else {
+        return QPointF(-1, -1); // eller std::optional/QVariant/etc
+    }
+}
+
+MainWindow::MainWindow(QWidget *parent)
+    : QMainWindow(parent)
+    , ui(new Ui::MainWindow)
+{
+    ui->setupUi(this);
+    ui->MainView->setScene(&Scene);
+    m_Loupe = new Loupe(ui->MainView->viewport());
+    ui->MainView->loupe = m_Loupe;
+    m_ProjectModel = new ProjectListModel(&m_Thumbnails, this);
+    m_ProjectModel->setMetadata(&m_Metadata);
+    QListView* projectView = new QListView(ui->ProjectCombo);
+    ProjectListModel::setupGridView(projectView);
+    projectView->setMinimumWidth(640);
+    ui->ProjectCombo->setView(projectView);
+    ui->ProjectCombo->setModel(m_ProjectModel);
+    ui->ProjectCombo->setIconSize(QSize(32, 24));
+    projectView->setMouseTracking(true);
+    connect(projectView,&QListView::entered,this,[this](const QModelIndex& i) { prefetchProjects(i.row()); });
+    connect(ui->LoadAfterButton,&QToolButton::clicked,this,&MainWindow::loadAfter);
+    connect(ui->StraightenAfterButton,&QToolButton::clicked,this,&MainWindow::autoStraighten);
+    connect(ui->SaveAfterButton,&QToolButton::clicked,this,&MainWindow::saveAfterDialog);
+    connect(ui->AddProjectToolButton,&QToolButton::clicked,this,&MainWindow::addProject);
+    connect(ui->RemoveProjectToolButton,&QToolButton::clicked,this,&MainWindow::removeCurrentProject);
+    connect(ui->ProjectCombo,&QComboBox::currentTextChanged,this,&MainWindow::loadProject);
+    connect(ui->EpochSlider,&QSlider::valueChanged,this,&MainWindow::selectEpoch);
+    connect(ui->AddEpochToolButton,&QToolButton::clicked,this,&MainWindow::addEpoch);
+    connect(ui->RemoveEpochToolButton,&QToolButton::clicked,this,&MainWindow::removeEpoch);
+    connect(ui->ToggleViewButton,&QPushButton::clicked,this,&MainWindow::toggleView);
+    connect(ui->ToneMatchCombo,QOverload<int>::of(&QComboBox::currentIndexChanged),this,&MainWindow::setToneMatch);
+    connect(ui->LensImageCombo,QOverload<int>::of(&QComboBox::currentIndexChanged),this,&MainWindow::showLensValues);
+    connect(ui->K1SpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::lensChanged);
+    connect(ui->K2SpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::lensChanged);
+    connect(ui->P1SpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::lensChanged);
+    connect(ui->P2SpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::lensChanged);
+    connect(ui->LensSolveButton,&QPushButton::clicked,this,&MainWindow::solveLens);
+    connect(ui->CleanupImageCombo,QOverload<int>::of(&QComboBox::currentIndexChanged),this,&MainWindow::showFilterValues);
+    connect(ui->DustSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::filterChanged);
+    connect(ui->DustSizeSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::filterChanged);
+    connect(ui->SharpenSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::filterChanged);
+    connect(ui->SharpenRadiusSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::filterChanged);
+    connect(ui->HTranslateSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->VTranslateSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->HShearSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->VShearSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->RotateSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->XRotateSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->YRotateSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->HPerspectiveSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->VPerspectiveSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->HScaleSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->VScaleSpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->TransparancySpinBox,QOverload<double>::of(&QDoubleSpinBox::valueChanged),this,&MainWindow::updateFrame);
+    connect(ui->MainView,&QGraphicsViewX::fingerMoved,this,&MainWindow::finger);
+    connect(ui->MainView,&QGraphicsViewX::brushStroke,this,&MainWindow::brushStroke);
+    connect(ui->ClearMaskToolButton,&QToolButton::clicked,this,&MainWindow::clearMask);
+    for (int i = 0; i < maxAnchors; ++i) {
+        QPushButton* b = findChild<QPushButton*>(QString("AnchorBefore%1Button").arg(i + 1));
+        QPushButton* a = findChild<QPushButton*>(QString("AnchorAfter%1Button").arg(i + 1));
+        anchors.before(i).button = b;
+        anchors.after(i).button = a;
+        connect(b, &QPushButton::clicked, this, [this, i]() { setAnchorBefore(i); });
+        connect(a, &QPushButton::clicked, this, [this, i]() { setAnchorAfter(i); });
+        if (i >= anchorCount) {
+            b->setVisible(false);
+            a->setVisible(false);
+        }
+    }
+    for (int i = 0; i < solverCount; i++) {
+        QPushButton* b = findChild<QPushButton*>(QString("Compute%1AnchorsButton").arg(i + 1));
+        anchors.computeButtons[i] = b;
+        connect(b, &QPushButton::clicked, this, [this, i]() { computeAnchors(i); });
+        if (i >= anchorCount) b->setVisible(false);
+    }
+    connect(ui->ClearButton,&QPushButton::clicked,this,&MainWindow::clearAnchors);
+    connect(ui->CreateWebSiteButton,&QPushButton::clicked,this,&MainWindow::createWebGallery);
+    connect(ui->PreviewWebSiteButton,&QPushButton::clicked,this,&MainWindow::previewGallery);
+    connect(ui->AlignProjectsButton,&QPushButton::clicked,this,&MainWindow::batchAlign);
+    connect(ui->PairImagesButton,&QPushButton::clicked,this,&MainWindow::pairImages);
+}
+
+void MainWindow::showEvent(QShowEvent* event)
+{
+    QMainWindow::showEvent(event);
+    QSettings s("Veinge Musik och Data","BeforeAfter");
+    this->setGeometry(s.value("Rect").toRect());
+    m_ExportOptions.load(s);
+    m_Prefetcher.setBudget(proxyBudget());
+    m_CurrentIndex = s.value("CurrentIndex",-1).toInt();
+    m_ProjectList = ProjectStore::load(s);
+    if (m_ProjectList.isEmpty())
+    {
+        addProject();
+    }
+    else
+    {
+        if (m_CurrentIndex == -1) m_CurrentIndex = 0;
+        loadProject();
+    }
+}
+
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    QSettings s("Veinge Musik och Data","BeforeAfter");
+    s.setValue("Rect",this->geometry());
+    s.setValue("CurrentIndex",m_CurrentIndex);
+    m_ExportOptions.save(s);
+    ProjectStore::save(s, m_ProjectList);
+    saveMask();
+    QMainWindow::closeEvent(event);
+}
+
+MainWindow::~MainWindow()
+{
+    delete ui;
+}
+
+void MainWindow::resizeEvent(QResizeEvent* event)
+{
+    QMainWindow::resizeEvent(event);
+    if (m_CurrentIndex > -1) updateFrame();
+}
+
+void MainWindow::updateValues()
+{
+    if (m_CurrentIndex > -1) {
+        setValue("HTranslate", ui->HTranslateSpinBox->value());
+        setValue("VTranslate", ui->VTranslateSpinBox->value());
+        setValue("HShear", ui->HShearSpinBox->value());
+        setValue("VShear", ui->VShearSpinBox->value());
+        setValue("Transparancy", ui->TransparancySpinBox->value());
+        setValue("HScale", ui->HScaleSpinBox->value());
+        setValue("VScale", ui->VScaleSpinBox->value());
+        setValue("Rotate", ui->RotateSpinBox->value());
+        setValue("XRotate", ui->XRotateSpinBox->value());
+        setValue("YRotate", ui->YRotateSpinBox->value());
+        setValue("HPerspective", ui->HPerspectiveSpinBox->value());
+        setValue("VPerspective", ui->VPerspectiveSpinBox->value());
+
+        for (int i = 0; i < anchorCount; ++i) {
+            setValue(QString("AnchorBefore%1").arg(i + 1), anchors.before(i));
+            setValue(QString("AnchorAfter%1").arg(i + 1), anchors.after(i));
+        }
+    }
+}
+
+void MainWindow::updateFrame()
+{
+    updateValues();
+    for (QGraphicsItem* i : (const QList<QGraphicsItem*>)Scene.items()) Scene.removeItem(i);
+    ui->MainView->origSize = beforeImage.originalSize();
+    QGraphicsScene* s = &Scene;
+    afterImage.setOverlay(anchors.after().path(),anchors.after().pen());
+    drawAfter(s,afterImage);
+    beforeImage.setOverlay(anchors.before().path(),anchors.before().pen());
+    drawBefore(s,beforeImage);
+    beforeImage.setViewMode((ViewMode)valueInt("ViewMode"));
+    beforeImage.setSplitFactor(valueDouble("Transparancy"));
+    ui->MainView->setPainting(valueInt("ViewMode") == MaskView);
+    updateLoupe();
+}
+
+void MainWindow::updateLoupe()
+{
+    // Samma korrigeringar och transform som bilderna i scenen
+    m_Loupe->setSources({ beforeImage.path(), beforeImage.originalSize(), beforeImage.sourceImage(), lensValue("Before"), ColourLut(), QTransform() },
+                        { afterImage.path(), afterImage.originalSize(), afterImage.sourceImage(), lensValue("After"), m_AfterLut, afterTransform() });
+}
+
+void MainWindow::drawBefore(QGraphicsScene* s, HighQualityImageItem& i) {
+    s->addItem(&i);
+}
+
+void MainWindow::drawAfter(QGraphicsScene* s, HighQualityImageItem& i) {
+    s->addItem(&i);
+    i.setTransformMatrix(afterTransform());
+    s->setSceneRect(beforeImage.originalRect().united(i.mapRectToScene(i.boundingRect()).toRect()));
+}
+
+QTransform MainWindow::afterTransform() {
+    return ProjectValues::afterTransform(m_ProjectList[m_CurrentIndex]);
+}
+
+// Arkivbilderna är ofta 16-bitars TIFF eller PNG
+static QString openFilter()
+{
+    return QObject::tr("Image Files (*.jpg *.jpeg *.png *.tif *.tiff *.webp)");
+}
+
+void MainWindow::loadBefore()
+{
+    QString p = QFileDialog::getOpenFileName(this, tr("Open Image"), "", openFilter());
+    if (!p.isEmpty())
+    {
+        beforeImage.load(p, proxyBudget());
+        setValue("BeforePix",p);
+    }
+}
+
+void MainWindow::loadAfter()
+{
+    QString p = QFileDialog::getOpenFileName(this, tr("Open Image"), "", openFilter());
+    if (!p.isEmpty())
+    {
+        afterImage.load(p, proxyBudget());
+        setValue("AfterPix",p);
+        updateToneMatch();
+    }
+    updateFrame();
+}
+
+void MainWindow::saveAfterDialog() {
+    const QString filter = tr("Image Files (%1)").arg(ImageEncoder::available(ExportOptions::WebP) ? "*.jpg *.jpeg *.png *.tif *.tiff *.webp" : "*.jpg *.jpeg *.png *.tif *.tiff");
+    const QString path = QFileDialog::getSaveFileName(this, tr("Save Image"), "", filter);
+    if (!path.isEmpty()) saveAfter(path);
+}
+
+void MainWindow::saveAfter(QString path, const QRect& rect, EncoderPool* encoders)
+{
+    const QRect target = rect.isEmpty() ? beforeImage.originalRect() : rect;
+    StripExporter exporter(m_ExportOptions.memoryBudget());
+    // Målningen nedan är 8 bitar och kodaren saknar TIFF, 16-bitarskällor och TIFF går bandvis
+    const bool deep = StripWriter::supportsDeep(path) && StripReader(afterImage.path()).isDeep();
+    const bool tiff = QFileInfo(path).suffix().toLower().startsWith("tif");
+    if (afterImage.isProxy() || deep || tiff || exporter.exceedsBudget(target.size(), afterImage.originalSize())) {
+        const int quality = ImageEncoder(m_ExportOptions).streamQuality(path, afterImage.displayImage(), qint64(target.width()) * target.height());
+        if (!path.isEmpty()) ImagePair(m_ProjectList[m_CurrentIndex]).exportAfter(path, m_ExportOptions.memoryBudget(), m_AfterLut, rect, quality);
+        return;
+    }
+    // Ryms bilden renderas den i minnet och kodas i kodarpoolen
+    if (path.isEmpty()) return;
+    const QImage outImage = ImagePair(m_ProjectList[m_CurrentIndex]).renderAfter(m_ExportOptions.memoryBudget(), m_AfterLut, rect);
+    if (outImage.isNull()) return;
+    if (encoders) encoders->write(outImage, path);
+    else ImageEncoder(m_ExportOptions).write(outImage, path);
+}
+
+void MainWindow::saveAnimation(const QString& path, const QRect& rect)
+{
+    ImagePair::renderAnimation(path, m_ExportOptions.animationWidth, m_ExportOptions.animationFrames, ViewMode(valueInt("ViewMode")),
+                               beforeImage.displayImage(), beforeImage.originalSize(),
+                               afterImage.displayImage(), afterImage.imageRect(), afterImage.transformMatrix(), rect);
+}
+
+void MainWindow::toggleView()
+{
+    int i = valueInt("ViewMode");
+    i++;
+    if (i > MaskView) i = 0;
+    setValue("ViewMode", static_cast<ViewMode>(i));
+    updateLabel();
+    updateFrame();
+}
+
+void MainWindow::loadMask()
+{
+    // Masken hör till projektet och följer inte epokerna
+    const QSize size = MaskLayer::maskSize(beforeImage.originalSize());
+    if (valueString("MaskFile") != m_MaskFile || m_Mask.size() != size) {
+        saveMask();
+        m_MaskFile = valueString("MaskFile");
+        if (m_MaskFile.isEmpty() || !m_Mask.load(m_MaskFile) || m_Mask.size() != size) m_Mask = MaskLayer(size);
+    }
+    beforeImage.setMask(&m_Mask);
+}
+
+void MainWindow::saveMask()
+{
+    if (m_MaskChanged && !m_MaskFile.isEmpty()) m_Mask.save(m_MaskFile);
+    m_MaskChanged = false;
+}
+
+void MainWindow::brushStroke(QPointF p, bool start)
+{
+    if (m_Mask.isNull()) return;
+    if (m_MaskFile.isEmpty()) {
+        m_MaskFile = MaskLayer::newPath();
+        setValue("MaskFile", m_MaskFile);
+    }
+    // Scenen är i förebildens originalkoordinater, penselns storlek likaså
+    const qreal scale = qreal(m_Mask.size().width()) / beforeImage.originalSize().width();
+    const qreal radius = qMax(0.5, ui->BrushSizeSpinBox->value() * 0.5 * scale);
+    // Stämplar med en fjärdedels radies mellanrum längs draget
+    const QPointF from = start ? p : m_LastBrush;
+    const int steps = qMax(1, qCeil(QLineF(from, p).length() * scale / qMax(1.0, radius * 0.25)));
+    QRect dirty;
+    for (int i = start ? steps : 1; i <= steps; i++) {
+        const QPointF c = from + (p - from) * (qreal(i) / steps);
+        dirty |= m_Mask.stroke(c * scale, radius, ui->BrushHardnessSpinBox->value(), ui->BrushFlowSpinBox->value(),
+                               ui->EraseCheckBox->isChecked());
+    }
+    m_LastBrush = p;
+    if (dirty.isEmpty()) return;
+    m_MaskChanged = true;
+    beforeImage.updateMask(dirty);
+}
+
+void MainWindow::clearMask()
+{
+    m_Mask.clear();
+    m_MaskChanged = true;
+    beforeImage.updateMask();
+}
+
+void MainWindow::setToneMatch(int mode)
+{
+    setValue("ToneMatch", mode);
+    updateToneMatch();
+}
+
+void MainWindow::updateToneMatch()
+{
+    // Efterbilden anpassas till förebildens färger, skattat över överlappet
+    const ColourLut::Mode mode = static_cast<ColourLut::Mode>(valueInt("ToneMatch"));
+    m_AfterLut = ColourLut::estimate(mode, afterImage.sourceImage(), afterImage.originalSize(), afterTransform(),
+                                     beforeImage.sourceImage(), beforeImage.originalSize());
+    afterImage.setColourLut(m_AfterLut);
+}
+
+QString MainWindow::lensPrefix()
+{
+    return ui->LensImageCombo->currentIndex() == 0 ? "Before" : "After";
+}
+
+void MainWindow::showLensValues()
+{
+    const QString prefix = lensPrefix();
+    ui->K1SpinBox->setValueSilent(valueDouble(prefix + "K1"));
+    ui->K2SpinBox->setValueSilent(valueDouble(prefix + "K2"));
+    ui->P1SpinBox->setValueSilent(valueDouble(prefix + "P1"));
+    ui->P2SpinBox->setValueSilent(valueDouble(prefix + "P2"));
+}
+
+void MainWindow::lensChanged()
+{
+    const QString prefix = lensPrefix();
+    setValue(prefix + "K1", ui->K1SpinBox->value());
+    setValue(prefix + "K2", ui->K2SpinBox->value());
+    setValue(prefix + "P1", ui->P1SpinBox->value());
+    setValue(prefix + "P2", ui->P2SpinBox->value());
+    updateLens();
+    updateFrame();
+}
+
+void MainWindow::updateLens()
+{
+    beforeImage.setLensDistortion(lensValue("Before"));
+    afterImage.setLensDistortion(lensValue("After"));
+}
+
+QString MainWindow::filterPrefix()
+{
+    return ui->CleanupImageCombo->currentIndex() == 0 ? "Before" : "After";
+}
+
+void MainWindow::showFilterValues()
+{
+    const ScanFilter f = ScanFilter::fromValues(m_ProjectList[m_CurrentIndex], filterPrefix());
+    ui->DustSpinBox->setValueSilent(f.dust);
+    ui->DustSizeSpinBox->setValueSilent(f.dustSize);
+    ui->SharpenSpinBox->setValueSilent(f.sharpen);
+    ui->SharpenRadiusSpinBox->setValueSilent(f.sharpenRadius);
+}
+
+void MainWindow::filterChanged()
+{
+    const QString prefix = filterPrefix();
+    setValue(prefix + "Dust", qRound(ui->DustSpinBox->value()));
+    setValue(prefix + "DustSize", qRound(ui->DustSizeSpinBox->value()));
+    setValue(prefix + "Sharpen", ui->SharpenSpinBox->value());
+    setValue(prefix + "SharpenRadius", ui->SharpenRadiusSpinBox->value());
+    updateFilter();
+    updateFrame();
+}
+
+void MainWindow::updateFilter()
+{
+    // Förhandsvisningen filtreras på proxyn, lupen visar råa pixlar för ankarna
+    beforeImage.setScanFilter(ScanFilter::fromValues(m_ProjectList[m_CurrentIndex], "Before"));
+    afterImage.setScanFilter(ScanFilter::fromValues(m_ProjectList[m_CurrentIndex], "After"));
+}
+
+void MainWindow::solveLens()
+{
+    // Ankarna ligger i korrigerade koordinater, den valda bildens punkter räknas
+    // tillbaka till råa med de nuvarande parametrarna innan de skattas om
+    const QString prefix = lensPrefix();
+    const bool freeBefore = prefix == "Before";
+    const QSize freeSize = freeBefore ? beforeImage.originalSize() : afterImage.originalSize();
+    LensDistortion lens = lensValue(prefix);
+    QList<QPointF> fixedPoints;
+    QList<QPointF> freePoints;
+    for (int i = 0; i < anchorCount; ++i) {
+        if (!anchors.before(i).isSet() || !anchors.after(i).isSet()) break;
+        fixedPoints.append(freeBefore ? anchors.after(i) : anchors.before(i));
+        freePoints.append(lens.distort(freeBefore ? anchors.before(i) : anchors.after(i), freeSize));
+    }
+    QTransform m;
+    if (!LensDistortion::solve(fixedPoints, freePoints, freeSize, lens, m)) {
+        QMessageBox::warning(this, "Lens", "Set at least three anchor pairs.");
+        return;
+    }
+    setValue(prefix + "K1", lens.k1);
+    setValue(prefix + "K2", lens.k2);
+    setValue(prefix + "P1", lens.p1);
+    setValue(prefix + "P2", lens.p2);
+    for (int i = 0; i < freePoints.size(); ++i) {
+        Anchor& a = freeBefore ? anchors.before(i) : anchors.after(i);
+        a.setPoint(lens.undistort(freePoints[i], freeSize));
+    }
+    showLensValues();
+    updateLens();
+    // m går från den fasta bildens korrigerade koordinater till den fria bildens
+    QTransform t = freeBefore ? m : m.inverted();
+    saveTransform(t);
+    updateFrame();
+}
+
+void MainWindow::updateLabel()
+{
+    QString s = "Transparancy";
+    if (valueInt("ViewMode") == ViewMode::SplitView) s = "Vertical Split";
+    if (valueInt("ViewMode") == ViewMode::HSplitView) s = "Horizontal Split";
+    if (valueInt("ViewMode") == ViewMode::MaskView) s = "Mask";
+    ui->TransparancyLabel->setText(s);
+}
+
+void MainWindow::loadProject(QString name)
+{
+    if (!name.isEmpty()) m_CurrentIndex = indexFromName(name);
+    // Referensen är densamma för alla epoker, den avkodas inte om vid epokbyte
+    if (beforeImage.path() != valueString("BeforePix") || beforeImage.originalSize().isEmpty()) {
+        beforeImage.load(valueString("BeforePix"), proxyBudget(), &m_Prefetcher);
+    }
+    loadMask();
+    afterImage.load(valueString("AfterPix"), proxyBudget(), &m_Prefetcher);
+
+    showTransformValues();
+    ui->TransparancySpinBox->setValueSilent(valueDouble("Transparancy"));
+    ui->ToneMatchCombo->blockSignals(true);
+    ui->ToneMatchCombo->setCurrentIndex(valueInt("ToneMatch"));
+    ui->ToneMatchCombo->blockSignals(false);
+    updateToneMatch();
+    updateLens();
+    showLensValues();
+    updateFilter();
+    showFilterValues();
+
+    for (int i = 0; i < anchorCount; ++i) {
+        anchors.before(i).setPoint(valuePointF(QString("AnchorBefore%1").arg(i + 1)));
+        anchors.after(i).setPoint(valuePointF(QString("AnchorAfter%1").arg(i + 1)));
+    }
+    anchors.setButtonColor();
+    anchors.enableComputeButtons();
+
+    updateLabel();
+    updateFrame();
+    updateProjects();
+    showEpochs();
+    ui->ProjectCombo->blockSignals(true);
+    ui->ProjectCombo->setCurrentText(valueString("ProjectName"));
+    ui->ProjectCombo->blockSignals(false);
+    prefetchProjects();
+}
+
+void MainWindow::prefetchProjects(int hovered)
+{
+    // Det pekaren står över först, sedan nästa och föregående projekt
+    QStringList paths;
+    for (const int i : { hovered, m_CurrentIndex + 1, m_CurrentIndex - 1 }) {
+        if (i < 0 || i >= m_ProjectList.size() || i == m_CurrentIndex) continue;
+        paths << m_ProjectList[i].value("BeforePix").toString() << m_ProjectList[i].value("AfterPix").toString();
+    }
+    m_Prefetcher.prefetch(paths, proxyBudget());
+}
+
+void MainWindow::updateProjects()
+{
+    ui->ProjectCombo->blockSignals(true);
+    m_ProjectModel->setProjects(m_ProjectList);
+    ui->ProjectCombo->blockSignals(false);
+}
+
+void MainWindow::addProject()
+{
+    bool ok;
+    QString text;
+    do {
+        text = QInputDialog::getText(this, "Project name",
+                                             "Project name:", QLineEdit::Normal,
+                                             QDir::home().dirName(), &ok);
+        if (!ok) return;
+    }
+    while (valueExist("ProjectName",text) || text.isEmpty());
+
+    QString p = QFileDialog::getOpenFileName(this, tr("Open Image"), "", openFilter());
+    if (!p.isEmpty())
+    {
+        QMap<QString,QVariant> proj;
+        proj.insert("ProjectName",text);
+        m_ProjectList.append(proj);
+        m_CurrentIndex = indexFromName(text);
+        setValue("HTranslate",0);
+        setValue("VTranslate",0);
+        setValue("HShear",0);
+        setValue("VShear",0);
+        setValue("Rotate",0);
+        setValue("XRotate",0);
+        setValue("YRotate",0);
+        setValue("HPerspective",0);
+        setValue("VPerspective",0);
+        setValue("ViewMode",0);
+        setValue("Transparancy",0.5);
+        setValue("HScale",1);
+        setValue("VScale",1);
+        beforeImage.load(p, proxyBudget());
+        setValue("BeforePix",p);
+        loadProject();
+        loadAfter();
+    }
+}
+
+void MainWindow::removeCurrentProject()
+{
+    removeProject(ui->ProjectCombo->currentText());
+}
+
+void MainWindow::computeMax() {
+    const int count = anchors.setCount();
+    if (count > 0) computeAnchors(qMin(count, solverCount) - 1);
+}
+
+void MainWindow::showTransformValues() {
+    ui->HTranslateSpinBox->setValueSilent(valueDouble("HTranslate"));
+    ui->VTranslateSpinBox->setValueSilent(valueDouble("VTranslate"));
+    ui->HShearSpinBox->setValueSilent(valueDouble("HShear"));
+    ui->VShearSpinBox->setValueSilent(valueDouble("VShear"));
+    ui->HScaleSpinBox->setValueSilent(valueDouble("HScale"));
+    ui->VScaleSpinBox->setValueSilent(valueDouble("VScale"));
+    ui->RotateSpinBox->setValueSilent(valueDouble("Rotate"));
+    ui->XRotateSpinBox->setValueSilent(valueDouble("XRotate"));
+    ui->YRotateSpinBox->setValueSilent(valueDouble("YRotate"));
+    ui->HPerspectiveSpinBox->setValueSilent(valueDouble("HPerspective"));
+    ui->VPerspectiveSpinBox->setValueSilent(valueDouble("VPerspective"));
+}
+
+void MainWindow::saveTransform(QTransform &t) {
+    // Perspektiv, förflyttning, rotation, skala och skjuvning, se ProjectValues
+    ProjectValues::setAfterTransform(m_ProjectList[m_CurrentIndex], t);
+    showTransformValues();
+    qDebug() << t << afterTransform();
+}
+
+void MainWindow::generateFolders(const QString& baseDirPath, const QStringList& projectNames, GalleryBundle* bundle){
+    const QString currentProject = ui->ProjectCombo->currentText();
+    QDir baseDir(baseDirPath);
+    QStringList caseDirs;
+    // Med bundle exporteras projekten till arbetsmappar och läggs i arkivet ett i taget
+    if (!bundle && baseDir.exists()) {
+        QMessageBox msgBox;
+        msgBox.setText("Directory Exists!");
+        msgBox.setInformativeText("Do you want to use this Directory?");
+        msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::Cancel);
+        msgBox.setDefaultButton(QMessageBox::Yes);
+        int ret = msgBox.exec();
+        if (ret == QMessageBox::Cancel) return;
+    }
+    else if (!bundle) {
+        baseDir.mkpath(baseDirPath);
+        baseDir.setPath(baseDirPath);
+    }
+    saveMask();
+    const ImageEncoder encoder(m_ExportOptions);
+    const QString ext = "." + m_ExportOptions.imageSuffix();
+    // Bilder i minnet kodas på en egen pool medan nästa projekt förvrängs
+    EncoderPool encoders(m_ExportOptions);
+    bool written = true;
+    for (const QString& pName : projectNames) {
+        loadProject(pName);
+        if (!bundle) baseDir.mkdir(pName);
+        const QString dir = (bundle ? bundle->stagingDir(pName) : baseDirPath + "/" + pName) + "/";
+        // Utan överlapp (eller utan beskärning) exporteras hela förebildens ram
+        const QRect rect = m_ExportOptions.autoCrop ? ImagePair::overlapRect(beforeImage.originalSize(), afterImage.originalSize(), afterTransform()) : QRect();
+        const QSize canvas = rect.isEmpty() ? beforeImage.originalSize() : rect.size();
+        const qint64 pixels = qint64(canvas.width()) * canvas.height();
+        if (beforeImage.isProxy()) {
+            ImagePair(m_ProjectList[m_CurrentIndex]).exportBefore(dir + "before" + ext, m_ExportOptions.memoryBudget(), rect,
+                                                                  encoder.streamQuality(dir + "before" + ext, beforeImage.displayImage(), pixels));
+        }
+        else {
+            encoders.write(beforeImage.copy(rect), dir + "before" + ext);
+        }
+        saveAfter(dir + "after" + ext, rect, &encoders);
+        if (m_ExportOptions.wipeAnimation) saveAnimation(dir + "wipe.avi", rect);
+        if (!m_Mask.isEmpty() &&
+            !ImagePair(m_ProjectList[m_CurrentIndex]).exportComposite(dir + "composite" + ext, m_ExportOptions.memoryBudget(), m_AfterLut, rect,
+                                                                      encoder.streamQuality(dir + "composite" + ext, beforeImage.displayImage(), pixels))) {
+            written = false;
+        }
+        updateValues();
+        if (!EpochStack::exportEpochs(m_ProjectList[m_CurrentIndex], dir, m_ExportOptions, rect)) written = false;
+        if (bundle) {
+            // Arkivet behöver färdiga filer
+            if (!encoders.waitForDone()) written = false;
+            if (!bundle->addProject(pName, m_ProjectList[m_CurrentIndex])) written = false;
+        }
+    }
+    if (!encoders.waitForDone()) written = false;
+    if (!written) QMessageBox::warning(this, "Export", "Some images could not be written.");
+    if (!currentProject.isEmpty()) loadProject(currentProject);
+}
+
+void MainWindow::removeProject(QString name) {
+    foreach(QMap p, m_ProjectList) {
+        if (p.value("ProjectName") == name)
+        {
+            QMessageBox msgBox;
+            msgBox.setText("Remove Project.");
+            msgBox.setInformativeText("Do you want to remove this Project?");
+            msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::Cancel);
+            msgBox.setDefaultButton(QMessageBox::Yes);
+            int ret = msgBox.exec();
+            if (ret == QMessageBox::Cancel) return;
+            m_ProjectList.removeOne(p);
+            if (m_ProjectList.size() == 0) {
+                addProject();
+                return;
+            }
+            if (m_CurrentIndex >= m_ProjectList.size()) m_CurrentIndex = m_ProjectList.size() - 1;
+            loadProject();
+        }
+    }
+}
+
+void MainWindow::finger(QPointF p) {
+    ViewMode v = static_cast<ViewMode>(valueInt("ViewMode"));
+    if (v == SplitView) {
+        ui->TransparancySpinBox->setValue(p.x());
+    }
+    if (v == HSplitView) {
+        ui->TransparancySpinBox->setValue(p.y());
+    }
+    if (v == EditView) {
+        ui->TransparancySpinBox->setValue((p.x()+p.y())*0.5);
+    }
+}
+
+void MainWindow::setAnchorBefore(int index) {
+    Anchor& a = anchors.before(index);
+    ui->MainView->loopForPoint(a);
+    anchors.enableComputeButtons();
+    computeMax();
+    updateFrame();
+}
+
+void MainWindow::setAnchorAfter(int index) {
+    Anchor& a = anchors.after(index);
+    ui->MainView->loopForPoint(a);
+    if (a.isSet()) a.setPoint(afterImage.mapToOriginal(a));
+    anchors.enableComputeButtons();
+    computeMax();
+    updateFrame();
+}
+/*
+void MainWindow::clearValues() {
+    ui->HTranslateSpinBox->setValueSilent(0);
+    ui->VTranslateSpinBox->setValueSilent(0);
+    ui->HShearSpinBox->setValueSilent(0);
+    ui->VShearSpinBox->setValueSilent(0);
+    ui->HScaleSpinBox->setValueSilent(1);
+    ui->VScaleSpinBox->setValueSilent(1);
+    ui->RotateSpinBox->setValueSilent(0);
+    ui->XRotateSpinBox->setValueSilent(0);
+    ui->YRotateSpinBox->setValueSilent(0);
+    updateFrame();
+}
+*/
+void MainWindow::clearAnchors() {
+    anchors.clear();
+    ui->HTranslateSpinBox->setValueSilent(0);
+    ui->VTranslateSpinBox->setValueSilent(0);
+    ui->HShearSpinBox->setValueSilent(0);
+    ui->VShearSpinBox->setValueSilent(0);
+    ui->HScaleSpinBox->setValueSilent(1);
+    ui->VScaleSpinBox->setValueSilent(1);
+    ui->RotateSpinBox->setValueSilent(0);
+    ui->XRotateSpinBox->setValueSilent(0);
+    ui->YRotateSpinBox->setValueSilent(0);
+    ui->HPerspectiveSpinBox->setValueSilent(0);
+    ui->VPerspectiveSpinBox->setValueSilent(0);
+    updateFrame();
+}
+
+void MainWindow::computeAnchors(int index) {
+    // Alla satta par används, fyra eller fler ger en projektiv anpassning
+    const int count = anchors.setCount();
+    const QList<QPointF> after(anchors.after().begin(), anchors.after().begin() + count);
+    const QList<QPointF> before(anchors.before().begin(), anchors.before().begin() + count);
+    QTransform t;
+    switch (index) {
+    case 0:
+        t = AnchorSolver::pointTransform(after, before);
+        break;
+    case 1:
+        t = AnchorSolver::alignTransform(after, before);
+        break;
+    case 2:
+        t = AnchorSolver::affineFromThreePoints(after, before);
+        break;
+    case 3:
+        t = AnchorSolver::homography(after, before);
+        break;
+    }
+    saveTransform(t);
+    // Manuellt justerad, inte längre markerad för granskning
+    setValue("NeedsReview", false);
+    setValue("Registered", EpochStack::registrationStamp(m_ProjectList[m_CurrentIndex]));
+    updateFrame();
+    // Överlappet har ändrats, skatta om färgmatchningen
+    if (valueInt("ToneMatch") != ColourLut::None) updateToneMatch();
+}
+
+void MainWindow::batchAlign()
+{
+    QDialog d(this);
+    d.setWindowTitle("Align Projects");
+    QVBoxLayout* layout = new QVBoxLayout(&d);
+    QListView* view = new QListView(&d);
+    ProjectListModel model(&m_Thumbnails);
+    model.setCheckable(true);
+    model.setMetadata(&m_Metadata);
+    model.setProjects(m_ProjectList);
+    ProjectListModel::setupGridView(view);
+    view->setModel(&model);
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &d);
+    connect(buttons,&QDialogButtonBox::accepted,&d,&QDialog::accept);
+    connect(buttons,&QDialogButtonBox::rejected,&d,&QDialog::reject);
+    layout->addWidget(view);
+    layout->addWidget(buttons);
+    d.resize(640, 480);
+    if (!d.exec()) return;
+    const QStringList names = model.checkedNames();
+    if (names.isEmpty()) return;
+
+    // Jobben arbetar på kopior av projektposterna, en per epok som saknar
+    // giltig registrering. Resultaten skrivs tillbaka här.
+    updateValues();
+    QList<QMap<QString,QVariant>> jobs;
+    for (const QString& name : names) {
+        const QMap<QString,QVariant>& p = m_ProjectList[indexFromName(name)];
+        for (int e = 1; e < EpochStack::count(p); e++) {
+            if (!EpochStack::isRegistered(p, e)) jobs.append(EpochStack::pair(p, e));
+        }
+    }
+    if (jobs.isEmpty()) {
+        QMessageBox::information(this, "Align Projects", "All epochs of the selected projects are already aligned.");
+        return;
+    }
+    QProgressDialog progress("Aligning projects...", "Cancel", 0, int(jobs.size()), this);
+    progress.setWindowModality(Qt::WindowModal);
+    QFutureWatcher<AutoAlign::Result> watcher;
+    connect(&watcher,&QFutureWatcherBase::progressValueChanged,&progress,&QProgressDialog::setValue);
+    connect(&watcher,&QFutureWatcherBase::finished,&progress,&QProgressDialog::reset);
+    connect(&progress,&QProgressDialog::canceled,&watcher,&QFutureWatcherBase::cancel);
+    watcher.setFuture(QtConcurrent::mapped(jobs, &AutoAlign::align));
+    progress.exec();
+    watcher.waitForFinished();
+
+    int done = 0;
+    int review = 0;
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (!watcher.future().isResultReadyAt(i)) continue;
+        const AutoAlign::Result r = watcher.future().resultAt(i);
+        QMap<QString,QVariant> pair = jobs[i];
+        if (r.ok) ProjectValues::setAfterTransform(pair, r.transform);
+        pair.insert("AlignConfidence", r.confidence);
+        pair.insert("NeedsReview", r.needsReview());
+        pair.insert("Registered", EpochStack::registrationStamp(pair));
+        EpochStack::setPair(m_ProjectList[indexFromName(pair.value("ProjectName").toString())], pair.value("Epoch", 1).toInt(), pair);
+        ++done;
+        if (r.needsReview()) ++review;
+    }
+    loadProject();
+    QMessageBox::information(this, "Align Projects",
+                             QString("%1 of %2 images aligned, %3 flagged for review.").arg(done).arg(jobs.size()).arg(review));
+}
+
+// Bildfilerna under dir, i undermappar också
+static QStringList imageFiles(const QString& dir)
+{
+    QStringList files;
+    QDirIterator it(dir, { "*.jpg", "*.jpeg", "*.png", "*.tif", "*.tiff", "*.webp" }, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) files << it.next();
+    files.sort();
+    return files;
+}
+
+void MainWindow::pairImages()
+{
+    const QString beforeDir = QFileDialog::getExistingDirectory(this, tr("Before Images (archive)"), "/home");
+    if (beforeDir.isEmpty()) return;
+    const QString afterDir = QFileDialog::getExistingDirectory(this, tr("After Images (new shots)"), beforeDir);
+    if (afterDir.isEmpty()) return;
+    const QStringList befores = imageFiles(beforeDir);
+    QStringList afters;
+    // Efterbilder som redan har ett projekt föreslås inte igen
+    for (const QString& path : imageFiles(afterDir)) {
+        if (!valueExist("AfterPix", path) && !befores.contains(path)) afters << path;
+    }
+    if (befores.isEmpty() || afters.isEmpty()) {
+        QMessageBox::information(this, "Pair Images", "No unpaired images found.");
+        return;
+    }
+
+    // Hasharna räknas i bakgrunden, de som redan finns i indexet hoppas över
+    QProgressDialog progress("Indexing images...", "Cancel", 0, 0, this);
+    progress.setWindowModality(Qt::WindowModal);
+    QFutureWatcher<void> watcher;
+    connect(&watcher,&QFutureWatcherBase::progressRangeChanged,&progress,&QProgressDialog::setRange);
+    connect(&watcher,&QFutureWatcherBase::progressValueChanged,&progress,&QProgressDialog::setValue);
+    connect(&watcher,&QFutureWatcherBase::finished,&progress,&QProgressDialog::reset);
+    connect(&progress,&QProgressDialog::canceled,&watcher,&QFutureWatcherBase::cancel);
+    watcher.setFuture(m_Hashes.scan(befores + afters));
+    progress.exec();
+    watcher.waitForFinished();
+    if (watcher.isCanceled()) return;
+    m_Hashes.setCandidates(befores);
+
+    // Närmaste förebild för varje efterbild, säkra förslag är förvalda
+    const int maxDistance = 24;
+    const int likely = 12;
+    QDialog d(this);
+    d.setWindowTitle("Pair Images");
+    QVBoxLayout* layout = new QVBoxLayout(&d);
+    QListWidget* list = new QListWidget(&d);
+    for (const QString& after : std::as_const(afters)) {
+        quint64 h;
+        if (!m_Hashes.hash(after, &h)) continue;
+        const QList<HashIndex::Match> m = m_Hashes.nearest(h, 1, maxDistance);
+        if (m.isEmpty()) continue;
+        QListWidgetItem* item = new QListWidgetItem(QString("%1  <-  %2  (%3)").arg(QFileInfo(after).fileName(), QFileInfo(m.first().path).fileName()).arg(m.first().distance), list);
+        item->setData(Qt::UserRole, after);
+        item->setData(Qt::UserRole + 1, m.first().path);
+        item->setToolTip(after + "\n" + m.first().path);
+        item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+        item->setCheckState(m.first().distance <= likely ? Qt::Checked : Qt::Unchecked);
+    }
+    if (list->count() == 0) {
+        QMessageBox::information(this, "Pair Images", "No likely pairs found.");
+        return;
+    }
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &d);
+    connect(buttons,&QDialogButtonBox::accepted,&d,&QDialog::accept);
+    connect(buttons,&QDialogButtonBox::rejected,&d,&QDialog::reject);
+    layout->addWidget(new QLabel("Create projects for the checked pairs (after <- before, hash distance):", &d));
+    layout->addWidget(list);
+    layout->addWidget(buttons);
+    d.resize(640, 480);
+    if (!d.exec()) return;
+
+    updateValues();
+    QString first;
+    for (int i = 0; i < list->count(); ++i) {
+        const QListWidgetItem* item = list->item(i);
+        if (item->checkState() != Qt::Checked) continue;
+        const QString after = item->data(Qt::UserRole).toString();
+        // Projektet heter som efterbilden, med löpnummer om namnet är taget
+        QString name = QFileInfo(after).completeBaseName();
+        for (int n = 2; valueExist("ProjectName", name); n++) name = QString("%1 %2").arg(QFileInfo(after).completeBaseName()).arg(n);
+        QMap<QString,QVariant> p;
+        p.insert("ProjectName", name);
+        p.insert("BeforePix", item->data(Qt::UserRole + 1));
+        p.insert("AfterPix", after);
+        p.insert("ViewMode", 0);
+        p.insert("Transparancy", 0.5);
+        ProjectValues::setAfterTransform(p, QTransform());
+        m_ProjectList.append(p);
+        if (first.isEmpty()) first = name;
+    }
+    if (!first.isEmpty()) loadProject(first);
+}
+
+void MainWindow::showEpochs()
+{
+    const QMap<QString,QVariant>& p = m_ProjectList[m_CurrentIndex];
+    const int count = EpochStack::count(p);
+    const int e = EpochStack::current(p);
+    ui->EpochSlider->blockSignals(true);
+    ui->EpochSlider->setRange(1, qMax(1, count - 1));
+    ui->EpochSlider->setValue(e);
+    ui->EpochSlider->blockSignals(false);
+    ui->EpochSlider->setEnabled(count > 2);
+    ui->RemoveEpochToolButton->setEnabled(count > 2);
+    ui->EpochLabel->setText(QString("%1 / %2").arg(EpochStack::label(p, 0), EpochStack::label(p, e)));
+}
+
+void MainWindow::selectEpoch(int epoch)
+{
+    if (epoch == EpochStack::current(m_ProjectList[m_CurrentIndex])) return;
+    updateValues();
+    EpochStack::select(m_ProjectList[m_CurrentIndex], epoch);
+    loadProject();
+}
+
+void MainWindow::addEpoch()
+{
+    QString p = QFileDialog::getOpenFileName(this, tr("Open Image"), "", openFilter());
+    if (p.isEmpty()) return;
+    updateValues();
+    const int e = EpochStack::add(m_ProjectList[m_CurrentIndex], p);
+    EpochStack::select(m_ProjectList[m_CurrentIndex], e);
+    loadProject();
+    alignEpoch(e);
+}
+
+void MainWindow::removeEpoch()
+{
+    QMessageBox msgBox;
+    msgBox.setText("Remove Epoch.");
+    msgBox.setInformativeText("Do you want to remove this image from the project?");
+    msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::Cancel);
+    msgBox.setDefaultButton(QMessageBox::Yes);
+    if (msgBox.exec() == QMessageBox::Cancel) return;
+    updateValues();
+    EpochStack::remove(m_ProjectList[m_CurrentIndex], EpochStack::current(m_ProjectList[m_CurrentIndex]));
+    loadProject();
+}
+
+void MainWindow::alignEpoch(int epoch)
+{
+    // Bara den nya epoken registreras, i bakgrunden. De andra har sina kvar.
+    const QMap<QString,QVariant> pair = EpochStack::pair(m_ProjectList[m_CurrentIndex], epoch);
+    QFutureWatcher<AutoAlign::Result>* watcher = new QFutureWatcher<AutoAlign::Result>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, pair, epoch]() {
+        watcher->deleteLater();
+        const AutoAlign::Result r = watcher->result();
+        const int index = indexFromName(pair.value("ProjectName").toString());
+        if (index < 0 || EpochStack::path(m_ProjectList[index], epoch) != pair.value("AfterPix").toString()) return;
+        const bool shown = index == m_CurrentIndex && EpochStack::current(m_ProjectList[index]) == epoch;
+        if (shown) updateValues();
+        QMap<QString,QVariant> p = EpochStack::pair(m_ProjectList[index], epoch);
+        if (r.ok) ProjectValues::setAfterTransform(p, r.transform);
+        p.insert("AlignConfidence", r.confidence);
+        p.insert("NeedsReview", r.needsReview());
+        p.insert("Registered", EpochStack::registrationStamp(p));
+        EpochStack::setPair(m_ProjectList[index], epoch, p);
+        if (shown) loadProject();
+    });
+    watcher->setFuture(QtConcurrent::run(&AutoAlign::align, pair));
+}
+
+void MainWindow::autoStraighten()
+{
+    // Skattas i bakgrunden på efterbildens linskorrigerade proxy
+    if (m_CurrentIndex < 0 || afterImage.sourceImage().isNull()) return;
+    const QString path = afterImage.path();
+    const QImage source = afterImage.sourceImage();
+    const QSize size = afterImage.originalSize();
+    const LensDistortion lens = lensValue("After");
+    ui->StraightenAfterButton->setEnabled(false);
+    QFutureWatcher<AutoStraighten::Result>* watcher = new QFutureWatcher<AutoStraighten::Result>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, path]() {
+        watcher->deleteLater();
+        ui->StraightenAfterButton->setEnabled(true);
+        const AutoStraighten::Result r = watcher->result();
+        if (m_CurrentIndex < 0 || afterImage.path() != path) return;
+        if (!r.ok) {
+            QMessageBox::information(this, "Straighten", "No dominant horizontal or vertical lines found.");
+            return;
+        }
+        // Uppriktningen verkar först, i efterbildens koordinater. Spinnrutorna
+        // uppdateras tysta och scenen ritas om en gång.
+        updateValues();
+        QTransform t = r.transform * afterTransform();
+        saveTransform(t);
+        updateFrame();
+        if (valueInt("ToneMatch") != ColourLut::None) updateToneMatch();
+        ui->statusbar->showMessage(QString("%1 %2°, confidence %3%")
+                                   .arg(r.keystone ? "Keystone corrected," : "Straightened")
+                                   .arg(r.angle, 0, 'f', 1).arg(qRound(r.confidence * 100)), 5000);
+    });
+    watcher->setFuture(QtConcurrent::run([source, size, lens]() {
+        return AutoStraighten::estimate(ImagePair::correctProxy(source, size, ColourLut(), lens), size);
+    }));
+}
+
+void MainWindow::createWebGallery() {
+    QStringList projectNames;
+    QString title = "Before/After Gallery";
+    CProjectDialog p(this);
+    p.exec(m_ProjectList,projectNames,title,m_ExportOptions,&m_Thumbnails,&m_Metadata);
+    m_Prefetcher.setBudget(proxyBudget());
+    if (projectNames.isEmpty()) return;
+    qDebug() << projectNames;
+    if (m_ExportOptions.bundle) {
+        const QString path = QFileDialog::getSaveFileName(this, tr("Gallery Archive"), "/home/gallery.zip", tr("Archives (*.zip *.tar)"));
+        if (path.isEmpty()) return;
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            QMessageBox::warning(this, "Export", "Could not create " + path);
+            return;
+        }
+        GalleryBundle bundle(&file, ArchiveWriter::formatFor(path), m_ExportOptions);
+        if (!bundle.isValid()) return;
+        generateFolders(path,projectNames,&bundle);
+        if (!bundle.finish(title)) QMessageBox::warning(this, "Export", "Could not write " + path);
+        else m_LastGallery = path;
+        return;
+    }
+    const QString path = QFileDialog::getExistingDirectory(this, tr("Base Path"), "/home", QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if (path.isEmpty()) return;
+    qDebug() << path;
+    generateFolders(path,projectNames);
+    GalleryWriter(m_ExportOptions).write(path, title, m_ProjectList);
+    m_LastGallery = path;
+}
+
+void MainWindow::previewGallery()
+{
+    // Senast exporterade galleriet, mapp eller paket, annars väljs en mapp
+    QString root = m_LastGallery;
+    if (root.isEmpty()) root = QFileDialog::getExistingDirectory(this, tr("Gallery"), "/home", QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if (root.isEmpty()) return;
+    QDialog* d = new QDialog(this);
+    d->setAttribute(Qt::WA_DeleteOnClose);
+    d->setWindowTitle("Gallery Preview");
+    // Servern lever med fönstret
+    PreviewServer* server = new PreviewServer(d);
+    if (!server->start(root)) {
+        delete d;
+        QMessageBox::warning(this, "Preview", "Could not serve " + root);
+        return;
+    }
+    QVBoxLayout* layout = new QVBoxLayout(d);
+    QLabel* summary = new QLabel(server->url().toString(), d);
+    QPlainTextEdit* log = new QPlainTextEdit(d);
+    log->setReadOnly(true);
+    log->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, d);
+    QPushButton* browse = buttons->addButton("Open in Browser", QDialogButtonBox::ActionRole);
+    connect(browse,&QPushButton::clicked,d,[server]() { QDesktopServices::openUrl(server->url()); });
+    connect(buttons,&QDialogButtonBox::rejected,d,&QDialog::reject);
+    connect(server,&PreviewServer::served,d,[server, summary, log](const PreviewServer::Request& r) {
+        log->appendPlainText(r.toString());
+        summary->setText(QString("%1   %2 requests, %3 kB since the page was loaded").arg(server->url().toString())
+                             .arg(server->pageRequests()).arg(server->pageBytes() / 1024.0, 0, 'f', 1));
+    });
+    layout->addWidget(summary);
+    layout->addWidget(log);
+    layout->addWidget(buttons);
+    d->resize(720, 400);
+    d->show();
+    QDesktopServices::openUrl(server->url());
+}
@@ -13,19 +13,28 @@
 #include <QApplication>
 #include <QPushButton>
 #include <QScrollBar>
+#include <QCursor>
+#include "exportoptions.h"
+#include "colourlut.h"
+#include "lensdistortion.h"
+#include "projectlistmodel.h"
+#include "imageprefetcher.h"
+#include "imagepair.h"
+#include "masklayer.h"
+#include "loupe.h"
+#include "imageencoder.h"
+#include "imagehash.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
-#define maxAnchors 4
-#define anchorCount 3
+class GalleryBundle;
 
-enum ViewMode {
-    EditView,
-    SplitView,
-    HSplitView
-};
+#define maxAnchors 6
+#define anchorCount 6
+// 1, 2, 3 och 4+ punkter
+#define solverCount 4
 
 class HighQualityImageItem : public QGraphicsItem
 {
@@ -34,17 +43,30 @@ public:
     HighQualityImageItem(const QString& path, QGraphicsItem* parent = nullptr);
 
     void setImage(const QImage& image);
-    void load(const QString& path) { m_Image.load(path); }
-    void save(const QString& path) { m_Image.save(path); }
+    void load(const QString& path, qint64 maxBytes = 0, ImagePrefetcher* prefetcher = nullptr);
+    const QString& path() const { return m_Path; }
+    QImage copy(const QRect& rect = QRect()) const { return rect.isEmpty() ? m_Image : m_Image.copy(rect); }
+    bool isProxy() const { return m_Source.size() != m_OriginalSize; }
     void setTransformMatrix(const QTransform& transform);
+    void setColourLut(const ColourLut& lut);
+    void setLensDistortion(const LensDistortion& lens);
+    void setScanFilter(const ScanFilter& filter);
+    const QImage& sourceImage() const { return m_Source; }
+    const QImage& displayImage() const { return m_Image; }
+    // Visningsbildens läge och den affina transform den ritas med
+    QRectF imageRect() const { return m_ImageRect; }
+    QTransform transformMatrix() const { return m_transform; }
+    // Masken visas i MaskView, maskRect är det ändrade området i maskens koordinater (tomt = allt)
+    void setMask(const MaskLayer* mask) { m_Mask = mask; updateMask(); }
+    void updateMask(const QRect& maskRect = QRect());
 
     QRectF boundingRect() const override;
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
 
     void setViewMode(ViewMode mode);
     void setSplitFactor(qreal factor);
-    QSize originalSize() { return m_Image.size(); }
-    QRect originalRect() { return m_Image.rect(); }
+    QSize originalSize() { return m_OriginalSize; }
+    QRect originalRect() { return QRect(QPoint(0,0), m_OriginalSize); }
     QPointF mapToOriginal(const QPointF& pt) const;
     void setOverlay(const QPainterPath& path, const QPen& pen = QPen(), const QBrush& brush = QBrush()) {
         m_OverlayPath = path;
@@ -52,11 +74,24 @@ public:
         m_OverlayBrush = brush;
     }
 private:
+    void updateDisplayImage();
+    ColourLut m_Lut;
+    // Perspektivdelen av transformen är inbakad i m_Image, som täcker m_ImageRect
+    QTransform m_Perspective;
+    QRectF m_ImageRect;
+    LensDistortion m_Lens;
+    ScanFilter m_Filter;
     QPainterPath m_OverlayPath;
     QPen m_OverlayPen;
     QBrush m_OverlayBrush;
+    QString m_Path;
+    QImage m_Source;
     QImage m_Image;
+    QSize m_OriginalSize;
     QTransform m_transform;
+    // Visningsbilden multiplicerad med masken, förmultiplicerad
+    const MaskLayer* m_Mask = nullptr;
+    QImage m_Masked;
     ViewMode m_viewMode = ViewMode::SplitView;
     qreal m_splitFactor = 1.0;
 };
@@ -167,9 +202,15 @@ public:
         return true;
     }
     void enableComputeButtons() {
-        for (int i = 0; i < maxAnchors; i++) computeButtons[i]->setEnabled(computeEnabled(i + 1));
+        for (int i = 0; i < solverCount; i++) computeButtons[i]->setEnabled(computeEnabled(i + 1));
+    }
+    // Antal par i följd från det första där båda punkterna är satta
+    int setCount() {
+        int count = 0;
+        while (count < maxAnchors && computeEnabled(count + 1)) count++;
+        return count;
     }
-    std::array<QPushButton*,maxAnchors> computeButtons;
+    std::array<QPushButton*,solverCount> computeButtons;
 };
 
 class QGraphicsViewX: public QGraphicsView
@@ -193,15 +234,29 @@ public:
         looping = true;
         a.setLoopColor();
         QApplication::setOverrideCursor(Qt::PointingHandCursor);
+        if (loupe) {
+            const QPoint v = viewport()->mapFromGlobal(QCursor::pos());
+            loupe->follow(mapToScene(v), v);
+            loupe->show();
+        }
         while (looping) {
             usleep(100);
             QApplication::processEvents();
         }
         breakLoop(a);
     }
+    // Med penseln målas masken i stället för att delningen flyttas
+    void setPainting(bool on) {
+        painting = on;
+        setDragMode(on ? NoDrag : ScrollHandDrag);
+        if (on) viewport()->setCursor(Qt::CrossCursor);
+    }
     QSizeF origSize;
+    // Visas medan en ankarpunkt väljs
+    Loupe* loupe = nullptr;
 signals:
     void fingerMoved(QPointF);
+    void brushStroke(QPointF, bool start);
 protected:
     virtual bool event(QEvent *event)
     {
@@ -217,11 +272,17 @@ protected:
     void mousePressEvent(QMouseEvent* event) {
         m_MouseDown = true;
         loopPoint = mapToScene(event->position().toPoint());
+        if (painting && !looping) emit brushStroke(loopPoint, true);
         looping = false;
     }
     void mouseMoveEvent(QMouseEvent* event) {
+        if (looping && loupe) loupe->follow(mapToScene(event->position().toPoint()), event->position().toPoint());
         if (m_MouseDown) {
             QPointF p = mapToScene(event->position().toPoint());
+            if (painting) {
+                emit brushStroke(p, false);
+                return;
+            }
             p.setX(p.x() / origSize.width());
             p.setY(p.y() / origSize.height());
             if (p.x() < 0) p.setX(0);
@@ -234,13 +295,23 @@ protected:
     void mouseReleaseEvent(QMouseEvent* /*event*/) {
         m_MouseDown = false;
     }
+    void wheelEvent(QWheelEvent* event) {
+        // Hjulet växlar luppens förstoring i stället för att rulla scenen
+        if (looping && loupe) {
+            loupe->setZoom(event->angleDelta().y() > 0 ? 4 : 1);
+            return;
+        }
+        QGraphicsView::wheelEvent(event);
+    }
 private:
     bool m_MouseDown = false;
     bool looping = false;
+    bool painting = false;
     QPointF loopPoint;
     void breakLoop(Anchor& a) {
         looping = false;
         QApplication::restoreOverrideCursor();
+        if (loupe) loupe->hide();
         if (loopPoint != QPointF(0,0)) a.setPoint(loopPoint);
         a.setButtonColor();
     }
@@ -315,15 +386,47 @@ public:
 private:
     Ui::MainWindow *ui;
     QGraphicsScene Scene;
+    ExportOptions m_ExportOptions;
+    QString m_LastGallery; // mapp eller paket, för förhandsvisningen
     int m_CurrentIndex = -1;
     QList<QMap<QString,QVariant>> m_ProjectList;
+    MetadataIndex m_Metadata;
+    HashIndex m_Hashes;
+    ThumbnailCache m_Thumbnails;
+    ProjectListModel* m_ProjectModel;
+    ImagePrefetcher m_Prefetcher;
+    void prefetchProjects(int hovered = -1);
     void drawBefore(QGraphicsScene*, HighQualityImageItem&);
     void drawAfter(QGraphicsScene*, HighQualityImageItem&);
+    QTransform afterTransform();
+    qint64 proxyBudget() { return m_ExportOptions.memoryBudget() / 2; }
     HighQualityImageItem beforeImage;
     HighQualityImageItem afterImage;
     Anchors anchors;
+    ColourLut m_AfterLut;
+    MaskLayer m_Mask;
+    QString m_MaskFile;
+    bool m_MaskChanged = false;
+    QPointF m_LastBrush;
+    void loadMask();
+    void saveMask();
+    Loupe* m_Loupe;
+    void updateLoupe();
+    void updateToneMatch();
+    void updateLens();
+    void showLensValues();
+    QString lensPrefix();
+    LensDistortion lensValue(const QString& prefix) {
+        return LensDistortion::fromValues(m_ProjectList[m_CurrentIndex], prefix);
+    }
+    void updateFilter();
+    void showFilterValues();
+    QString filterPrefix();
     void updateValues();
     void updateProjects();
+    void showEpochs();
+    void alignEpoch(int epoch);
+    void autoStraighten();
     void addProject();
     void loadProject(QString name = QString());
     void removeProject(QString);
@@ -355,113 +458,22 @@ private:
         return false;
     }
     void computeMax();
-    QTransform computePointTransform(std::array<Anchor,maxAnchors> after,std::array<Anchor,maxAnchors> before) {
-        QTransform t;
-        t.translate(before[0].x(), before[0].y());
-        t.translate(-after[0].x(), -after[0].y());
-        return t;
-    }
-    QTransform computeAlignTransform(std::array<Anchor,maxAnchors> after,std::array<Anchor,maxAnchors> before)
-    {
-        // Steg 1: Vektorer
-        QPointF vAfter = after[1] - after[0];
-        QPointF vBefore = before[1] - before[0];
-
-        // Steg 2: Längder och skala
-        const double lenAfter = qHypot(vAfter.x(), vAfter.y());
-        const double lenBefore = qHypot(vBefore.x(), vBefore.y());
-        const double scale = lenBefore / lenAfter;
-
-        // Steg 3: Rotation i grader
-        const double angleAfter = qAtan2(vAfter.y(), vAfter.x());
-        const double angleBefore = qAtan2(vBefore.y(), vBefore.x());
-        const double rotationRad = angleBefore - angleAfter;
-
-        QTransform t;
-        t.translate(before[0].x(), before[0].y());        // 3. flytta till slutposition
-        t.rotateRadians(rotationRad);                           // 2. rotera
-        t.scale(scale, scale);                        // 2. skala
-        t.translate(-after[0].x(), -after[0].y());        // 1. flytta från startpunkt
-
-        for (int i = 0; i < 2; i++) qDebug() << "Mapped after " << i + 1 << t.map(after[i]) << "Expected:" << before[i];
-        return t;
-    }
-    QTransform computeAffineFromThreePoints(std::array<Anchor,maxAnchors> after,std::array<Anchor,maxAnchors> before)
-    {
-        /*
-        QPolygonF srcPoly = {a1, a2, a3};
-        QPolygonF dstPoly = {b1, b2, b3};
-        QTransform q;
-        bool ok = QTransform::quadToQuad(srcPoly, dstPoly, q);
-        return q;
-*/
-        // Vi vill hitta en affinn transform T så att:
-        //   T * a1 = b1
-        //   T * a2 = b2
-        //   T * a3 = b3
-        //
-        // Alltså vill vi lösa:
-        //   [ x1 y1 1 0  0 0 ]   [m11]   = [x1']
-        //   [ 0  0 0 x1 y1 1 ]   [m12]     [y1']
-        //   [ x2 y2 1 0  0 0 ]   [m21]     ...
-        //   [ 0  0 0 x2 y2 1 ]   [m22]
-        //   [ x3 y3 1 0  0 0 ]   [dx ]
-        //   [ 0  0 0 x3 y3 1 ]   [dy ]
-
-        // Extrahera koordinater
-        const double x1 = after[0].x(), y1 = after[0].y();
-        const double x2 = after[1].x(), y2 = after[1].y();
-        const double x3 = after[2].x(), y3 = after[2].y();
-
-        const double u1 = before[0].x(), v1 = before[0].y();
-        const double u2 = before[1].x(), v2 = before[1].y();
-        const double u3 = before[2].x(), v3 = before[2].y();
-
-        // Lös med Cramers regel eller Gauss-elimination – här direkt formelbaserat
-        const double denom = x1*(y2 - y3) - y1*(x2 - x3) + (x2*y3 - x3*y2);
-
-        if (std::abs(denom) < 1e-8) {
-            qWarning("Points are colinear; cannot compute affine transform.");
-            return QTransform(); // Identitet
-        }
-
-        // Lös koefficienterna
-        const double a = ((u1*(y2 - y3) - u2*(y1 - y3) + u3*(y1 - y2)) / denom);
-        const double b = ((u1*(x3 - x2) + u2*(x1 - x3) + u3*(x2 - x1)) / denom);
-        const double c = ((u1*(x2*y3 - x3*y2) - u2*(x1*y3 - x3*y1) + u3*(x1*y2 - x2*y1)) / denom);
-
-        const double d = ((v1*(y2 - y3) - v2*(y1 - y3) + v3*(y1 - y2)) / denom);
-        const double e = ((v1*(x3 - x2) + v2*(x1 - x3) + v3*(x2 - x1)) / denom);
-        const double f = ((v1*(x2*y3 - x3*y2) - v2*(x1*y3 - x3*y1) + v3*(x1*y2 - x2*y1)) / denom);
-
-        QTransform t(a, d, b, e, c, f); // m11 m12 m21 m22 dx dy
-
-        for (int i = 0; i < 3; i++) qDebug() << "Mapped after " << i + 1 << t.map(after[i]) << "Expected:" << before[i];
-        return t;
-    }
-    QTransform computeAffineFromFourPoints(std::array<Anchor,maxAnchors> after,std::array<Anchor,maxAnchors> before)
-    {
-        QList<QPointF> a;
-        QList<QPointF> b;
-        for (int i = 0; i < 4; i++) {
-            a.append(after[i]);
-            b.append(before[i]);
-        }
-        QPolygonF srcPoly(a);
-        QPolygonF dstPoly(b);
-        QTransform q;
-        QTransform::quadToQuad(srcPoly, dstPoly, q);
-        return q;
-    }
+    void showTransformValues();
     void saveTransform(QTransform& t);
-    void generateFolders(const QString& baseDirPath, const QStringList& projectNames);
-    void generateHtmlGallery(const QString& baseDirPath, const QString& title);
+    void generateFolders(const QString& baseDirPath, const QStringList& projectNames, GalleryBundle* bundle = nullptr);
 private slots:
     void loadBefore();
     void loadAfter();
     void saveAfterDialog();
-    void saveAfter(QString path);
+    void saveAfter(QString path, const QRect& rect = QRect(), EncoderPool* encoders = nullptr);
+    void saveAnimation(const QString& path, const QRect& rect = QRect());
     void toggleView();
+    void brushStroke(QPointF p, bool start);
+    void clearMask();
+    void setToneMatch(int mode);
+    void lensChanged();
+    void filterChanged();
+    void solveLens();
     void updateLabel();
     void finger(QPointF);
     void setAnchorBefore(int index);
@@ -469,6 +481,12 @@ private slots:
     void clearAnchors();
     void computeAnchors(int index);
     void createWebGallery();
+    void previewGallery();
+    void batchAlign();
+    void pairImages();
+    void selectEpoch(int epoch);
+    void addEpoch();
+    void removeEpoch();
 public slots:
     void updateFrame();
     void showEvent(QShowEvent*);
@@ -0,0 +1,162 @@
+#include "projectlistmodel.h"
+#include <QColor>
+#include <QLocale>
+#include <numeric>
+
+ProjectListModel::ProjectListModel(ThumbnailCache* cache, QObject* parent)
+    : QAbstractListModel(parent), m_Cache(cache)
+{
+    connect(m_Cache, &ThumbnailCache::ready, this, &ProjectListModel::thumbnailReady);
+}
+
+void ProjectListModel::setProjects(const QList<QMap<QString,QVariant>>& projects)
+{
+    beginResetModel();
+    m_Projects = projects;
+    m_Order.resize(projects.size());
+    std::iota(m_Order.begin(), m_Order.end(), 0);
+    m_Keys = QVector<QString>(projects.size());
+    m_Checked.clear();
+    endResetModel();
+}
+
+void ProjectListModel::sortByDate(bool byDate)
+{
+    QVector<int> order(m_Order.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (byDate && m_Metadata) {
+        // Alla huvuden läses parallellt först, sedan sorteras det ur indexet
+        QStringList paths;
+        for (const QMap<QString,QVariant>& p : std::as_const(m_Projects)) paths << p.value("BeforePix").toString();
+        m_Metadata->scan(paths);
+        QHash<int,QDateTime> captured;
+        for (int row = 0; row < m_Projects.size(); ++row) captured.insert(m_Order[row], m_Metadata->info(paths[row]).captured);
+        std::stable_sort(order.begin(), order.end(), [&captured](int a, int b) { return captured[a] < captured[b]; });
+    }
+    // Ny ordning: order[rad] är index i den ursprungliga listan
+    QVector<int> rowOf(m_Order.size());
+    for (int row = 0; row < m_Order.size(); ++row) rowOf[m_Order[row]] = row;
+    beginResetModel();
+    QList<QMap<QString,QVariant>> projects;
+    QVector<QString> keys;
+    QSet<int> checked;
+    for (int row = 0; row < order.size(); ++row) {
+        const int old = rowOf[order[row]];
+        projects.append(m_Projects[old]);
+        keys.append(m_Keys[old]);
+        if (m_Checked.contains(old)) checked.insert(row);
+    }
+    m_Projects = projects;
+    m_Keys = keys;
+    m_Checked = checked;
+    m_Order = order;
+    endResetModel();
+}
+
+QStringList ProjectListModel::checkedNames() const
+{
+    QStringList names;
+    for (int i = 0; i < m_Projects.size(); ++i) {
+        if (m_Checked.contains(i)) names.append(m_Projects[i].value("ProjectName").toString());
+    }
+    return names;
+}
+
+int ProjectListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : int(m_Projects.size());
+}
+
+QString ProjectListModel::keyAt(int row) const
+{
+    if (m_Keys[row].isEmpty()) m_Keys[row] = ThumbnailCache::key(m_Projects[row]);
+    return m_Keys[row];
+}
+
+QVariant ProjectListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_Projects.size()) return QVariant();
+    const int row = index.row();
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return m_Projects[row].value("ProjectName");
+    case Qt::DecorationRole: {
+        const QImage i = m_Cache->thumbnail(keyAt(row), m_Projects[row]);
+        if (!i.isNull()) return i;
+        // Tom ruta i rätt storlek tills miniatyren är klar
+        static QImage placeholder;
+        if (placeholder.isNull()) {
+            placeholder = QImage(ThumbnailCache::thumbnailSize(), QImage::Format_ARGB32_Premultiplied);
+            placeholder.fill(QColor(40, 40, 40));
+        }
+        return placeholder;
+    }
+    case Qt::ToolTipRole: {
+        QStringList tip;
+        if (m_Metadata) {
+            const ImageInfo info = m_Metadata->info(m_Projects[row].value("BeforePix").toString());
+            if (info.isValid()) {
+                tip << QString("%1 x %2, %3").arg(info.size.width()).arg(info.size.height()).arg(QLocale().toString(info.captured, QLocale::ShortFormat));
+                if (!info.camera.isEmpty()) tip << info.camera;
+            }
+        }
+        if (m_Projects[row].contains("AlignConfidence")) {
+            tip << QString("Alignment confidence %1%2").arg(m_Projects[row].value("AlignConfidence").toDouble(), 0, 'f', 2)
+                .arg(m_Projects[row].value("NeedsReview").toBool() ? ", needs review" : "");
+        }
+        if (!tip.isEmpty()) return tip.join("\n");
+        break;
+    }
+    case Qt::ForegroundRole:
+        // Osäkra automatiska justeringar markeras för granskning
+        if (m_Projects[row].value("NeedsReview").toBool()) return QColor(Qt::red);
+        break;
+    case Qt::CheckStateRole:
+        if (m_Checkable) return m_Checked.contains(row) ? Qt::Checked : Qt::Unchecked;
+        break;
+    }
+    return QVariant();
+}
+
+bool ProjectListModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+    if (!m_Checkable || role != Qt::CheckStateRole || !index.isValid()) return false;
+    if (value.toInt() == Qt::Checked) {
+        m_Checked.insert(index.row());
+    }
+    else {
+        m_Checked.remove(index.row());
+    }
+    emit dataChanged(index, index, { Qt::CheckStateRole });
+    return true;
+}
+
+Qt::ItemFlags ProjectListModel::flags(const QModelIndex& index) const
+{
+    Qt::ItemFlags f = QAbstractListModel::flags(index);
+    if (m_Checkable) f |= Qt::ItemIsUserCheckable;
+    return f;
+}
+
+void ProjectListModel::thumbnailReady(const QString& key)
+{
+    for (int i = 0; i < m_Keys.size(); ++i) {
+        if (m_Keys[i] == key) emit dataChanged(index(i), index(i), { Qt::DecorationRole });
+    }
+}
+
+void ProjectListModel::setupGridView(QListView* view)
+{
+    const QSize s = ThumbnailCache::thumbnailSize();
+    view->setViewMode(QListView::IconMode);
+    view->setResizeMode(QListView::Adjust);
+    view->setMovement(QListView::Static);
+    view->setWrapping(true);
+    view->setIconSize(s);
+    view->setGridSize(s + QSize(24, 32));
+    view->setUniformItemSizes(true);
+    view->setLayoutMode(QListView::Batched);
+    view->setBatchSize(200);
+    view->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+}
@@ -0,0 +1,42 @@
+#ifndef PROJECTLISTMODEL_H
+#define PROJECTLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QListView>
+#include <QSet>
+#include "thumbnailcache.h"
+#include "imagemetadata.h"
+
+// Projektnamn med miniatyrer för ProjectCombo och exportdialogen. Vyn frågar
+// bara efter de rader som syns, så nycklar och miniatyrer tas fram först då.
+
+class ProjectListModel : public QAbstractListModel
+{
+public:
+    ProjectListModel(ThumbnailCache* cache, QObject* parent = nullptr);
+    void setProjects(const QList<QMap<QString,QVariant>>& projects);
+    void setCheckable(bool checkable) { m_Checkable = checkable; }
+    // Uppgifter ur bildhuvudena för verktygstips och sortering
+    void setMetadata(MetadataIndex* metadata) { m_Metadata = metadata; }
+    // Efter förebildernas tagningstid, eller tillbaka i listans ordning. Valen följer med.
+    void sortByDate(bool byDate);
+    QStringList checkedNames() const;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    // Rutnät med enhetliga celler och batchvis layout, klarar tusentals rader
+    static void setupGridView(QListView* view);
+private:
+    QString keyAt(int row) const;
+    void thumbnailReady(const QString& key);
+    ThumbnailCache* m_Cache;
+    MetadataIndex* m_Metadata = nullptr;
+    QList<QMap<QString,QVariant>> m_Projects;
+    QVector<int> m_Order; // rad -> index i listan som gavs till setProjects
+    mutable QVector<QString> m_Keys;
+    QSet<int> m_Checked;
+    bool m_Checkable = false;
+};
+
+#endif // PROJECTLISTMODEL_H
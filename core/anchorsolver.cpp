@@ -0,0 +1,115 @@
+#include "anchorsolver.h"
+#include <array>
+
+QTransform AnchorSolver::fromPoints(const QList<QPointF>& after, const QList<QPointF>& before)
+{
+    const int n = int(qMin(after.size(), before.size()));
+    if (n == 0) return QTransform();
+    if (n == 1) return QTransform::fromTranslate(before[0].x() - after[0].x(), before[0].y() - after[0].y());
+    if (n == 2) {
+        const QPointF va = after[1] - after[0];
+        const QPointF vb = before[1] - before[0];
+        const double la = qHypot(va.x(), va.y());
+        if (la == 0) return QTransform();
+        QTransform t;
+        t.translate(before[0].x(), before[0].y());
+        t.rotateRadians(qAtan2(vb.y(), vb.x()) - qAtan2(va.y(), va.x()));
+        t.scale(qHypot(vb.x(), vb.y()) / la, qHypot(vb.x(), vb.y()) / la);
+        t.translate(-after[0].x(), -after[0].y());
+        return t;
+    }
+    // Affin med minsta kvadrat: samma normalmatris [x y 1] för båda utdatakoordinaterna
+    double m[3][3] = {};
+    double bu[3] = {};
+    double bv[3] = {};
+    for (int i = 0; i < n; ++i) {
+        const double r[3] = { after[i].x(), after[i].y(), 1 };
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < 3; ++k) m[j][k] += r[j] * r[k];
+            bu[j] += r[j] * before[i].x();
+            bv[j] += r[j] * before[i].y();
+        }
+    }
+    const auto det3 = [](const double a[3][3]) {
+        return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+             - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+             + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    };
+    const double d = det3(m);
+    if (std::abs(d) < 1e-12) {
+        qWarning("AnchorSolver: points are colinear");
+        return QTransform();
+    }
+    // Cramers regel
+    double u[3], v[3];
+    for (int c = 0; c < 3; ++c) {
+        double mu[3][3], mv[3][3];
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                mu[j][k] = k == c ? bu[j] : m[j][k];
+                mv[j][k] = k == c ? bv[j] : m[j][k];
+            }
+        }
+        u[c] = det3(mu) / d;
+        v[c] = det3(mv) / d;
+    }
+    return QTransform(u[0], v[0], u[1], v[1], u[2], v[2]);
+}
+
+// Skalar och flyttar punkterna till tyngdpunkt i origo och medelavstånd sqrt(2)
+static QTransform normalization(const QList<QPointF>& points, int n)
+{
+    QPointF c;
+    for (int i = 0; i < n; i++) c += points[i];
+    c /= n;
+    double d = 0;
+    for (int i = 0; i < n; i++) d += qHypot(points[i].x() - c.x(), points[i].y() - c.y());
+    d /= n;
+    const double s = d > 0 ? M_SQRT2 / d : 1;
+    return QTransform(s, 0, 0, s, -s * c.x(), -s * c.y());
+}
+
+QTransform AnchorSolver::homography(const QList<QPointF>& after, const QList<QPointF>& before)
+{
+    const int n = int(qMin(after.size(), before.size()));
+    if (n < 4) return fromPoints(after, before);
+    const QTransform ta = normalization(after, n);
+    const QTransform tb = normalization(before, n);
+
+    // Okända m11 m21 dx m12 m22 dy m13 m23 med m33 = 1. Varje par ger två rader,
+    // normalekvationerna (8x8) löses med Gauss-elimination och radpivotering.
+    std::array<std::array<double,9>,8> m {};
+    auto addRow = [&m](const std::array<double,8>& r, double rhs) {
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 8; j++) m[i][j] += r[i] * r[j];
+            m[i][8] += r[i] * rhs;
+        }
+    };
+    for (int i = 0; i < n; i++) {
+        const QPointF a = ta.map(after[i]);
+        const QPointF b = tb.map(before[i]);
+        addRow({ a.x(), a.y(), 1, 0, 0, 0, -a.x() * b.x(), -a.y() * b.x() }, b.x());
+        addRow({ 0, 0, 0, a.x(), a.y(), 1, -a.x() * b.y(), -a.y() * b.y() }, b.y());
+    }
+    for (int col = 0; col < 8; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < 8; row++) if (qAbs(m[row][col]) > qAbs(m[pivot][col])) pivot = row;
+        if (qAbs(m[pivot][col]) < 1e-12) {
+            qWarning("AnchorSolver: degenerate anchors");
+            return fromPoints(after, before);
+        }
+        std::swap(m[col], m[pivot]);
+        for (int row = 0; row < 8; row++) {
+            if (row == col) continue;
+            const double f = m[row][col] / m[col][col];
+            for (int k = col; k < 9; k++) m[row][k] -= f * m[col][k];
+        }
+    }
+    double h[8];
+    for (int i = 0; i < 8; i++) h[i] = m[i][8] / m[i][i];
+    const QTransform hn(h[0], h[3], h[6], h[1], h[4], h[7], h[2], h[5], 1);
+    // Tillbaka till pixelkoordinater: normalisera efterbilden, avbilda, avnormalisera
+    const QTransform t = ta * hn * tb.inverted();
+    return t;
+}
+
@@ -0,0 +1,104 @@
+#ifndef ANCHORSOLVER_H
+#define ANCHORSOLVER_H
+
+#include <QTransform>
+#include <QList>
+#include <QPolygonF>
+#include <QDebug>
+#include <qmath.h>
+
+// Transformer ur ankarpar, efterbild -> förebild. Fria funktioner utan
+// tillstånd, så de kan anropas från vilken tråd som helst.
+
+class AnchorSolver
+{
+public:
+    static QTransform pointTransform(const QList<QPointF>& after, const QList<QPointF>& before) {
+        QTransform t;
+        t.translate(before[0].x(), before[0].y());
+        t.translate(-after[0].x(), -after[0].y());
+        return t;
+    }
+    static QTransform alignTransform(const QList<QPointF>& after, const QList<QPointF>& before)
+    {
+        // Steg 1: Vektorer
+        QPointF vAfter = after[1] - after[0];
+        QPointF vBefore = before[1] - before[0];
+
+        // Steg 2: Längder och skala
+        const double lenAfter = qHypot(vAfter.x(), vAfter.y());
+        const double lenBefore = qHypot(vBefore.x(), vBefore.y());
+        const double scale = lenBefore / lenAfter;
+
+        // Steg 3: Rotation i grader
+        const double angleAfter = qAtan2(vAfter.y(), vAfter.x());
+        const double angleBefore = qAtan2(vBefore.y(), vBefore.x());
+        const double rotationRad = angleBefore - angleAfter;
+
+        QTransform t;
+        t.translate(before[0].x(), before[0].y());        // 3. flytta till slutposition
+        t.rotateRadians(rotationRad);                           // 2. rotera
+        t.scale(scale, scale);                        // 2. skala
+        t.translate(-after[0].x(), -after[0].y());        // 1. flytta från startpunkt
+        return t;
+    }
+    static QTransform affineFromThreePoints(const QList<QPointF>& after, const QList<QPointF>& before)
+    {
+        /*
+        QPolygonF srcPoly = {a1, a2, a3};
+        QPolygonF dstPoly = {b1, b2, b3};
+        QTransform q;
+        bool ok = QTransform::quadToQuad(srcPoly, dstPoly, q);
+        return q;
+*/
+        // Vi vill hitta en affinn transform T så att:
+        //   T * a1 = b1
+        //   T * a2 = b2
+        //   T * a3 = b3
+        //
+        // Alltså vill vi lösa:
+        //   [ x1 y1 1 0  0 0 ]   [m11]   = [x1']
+        //   [ 0  0 0 x1 y1 1 ]   [m12]     [y1']
+        //   [ x2 y2 1 0  0 0 ]   [m21]     ...
+        //   [ 0  0 0 x2 y2 1 ]   [m22]
+        //   [ x3 y3 1 0  0 0 ]   [dx ]
+        //   [ 0  0 0 x3 y3 1 ]   [dy ]
+
+        // Extrahera koordinater
+        const double x1 = after[0].x(), y1 = after[0].y();
+        const double x2 = after[1].x(), y2 = after[1].y();
+        const double x3 = after[2].x(), y3 = after[2].y();
+
+        const double u1 = before[0].x(), v1 = before[0].y();
+        const double u2 = before[1].x(), v2 = before[1].y();
+        const double u3 = before[2].x(), v3 = before[2].y();
+
+        // Lös med Cramers regel eller Gauss-elimination – här direkt formelbaserat
+        const double denom = x1*(y2 - y3) - y1*(x2 - x3) + (x2*y3 - x3*y2);
+
+        if (std::abs(denom) < 1e-8) {
+            qWarning("Points are colinear; cannot compute affine transform.");
+            return QTransform(); // Identitet
+        }
+
+        // Lös koefficienterna
+        const double a = ((u1*(y2 - y3) - u2*(y1 - y3) + u3*(y1 - y2)) / denom);
+        const double b = ((u1*(x3 - x2) + u2*(x1 - x3) + u3*(x2 - x1)) / denom);
+        const double c = ((u1*(x2*y3 - x3*y2) - u2*(x1*y3 - x3*y1) + u3*(x1*y2 - x2*y1)) / denom);
+
+        const double d = ((v1*(y2 - y3) - v2*(y1 - y3) + v3*(y1 - y2)) / denom);
+        const double e = ((v1*(x3 - x2) + v2*(x1 - x3) + v3*(x2 - x1)) / denom);
+        const double f = ((v1*(x2*y3 - x3*y2) - v2*(x1*y3 - x3*y1) + v3*(x1*y2 - x2*y1)) / denom);
+
+        QTransform t(a, d, b, e, c, f); // m11 m12 m21 m22 dx dy
+        return t;
+    }
+    // Projektiv transform, minsta kvadrat för fyra eller fler par (exakt för fyra).
+    // Punkterna normaliseras först (tyngdpunkt i origo, medelavstånd sqrt(2))
+    // så att ekvationssystemet blir välkonditionerat även för stora bilder.
+    static QTransform homography(const QList<QPointF>& after, const QList<QPointF>& before);
+    // Förflyttning (1 par), likformighet (2) eller affin minsta kvadrat (3+)
+    static QTransform fromPoints(const QList<QPointF>& after, const QList<QPointF>& before);
+};
+
+#endif // ANCHORSOLVER_H
@@ -0,0 +1,225 @@
+#include "archivereader.h"
+#include <QFileInfo>
+#include <QDebug>
+#include <cstring>
+#ifdef QT_BUNDLED_ZLIB
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+static const qint64 chunkSize = 1 << 20;
+static const quint64 zip32Max = 0xffffffffu;
+
+static quint64 readLE(const QByteArray& a, int pos, int bytes)
+{
+    quint64 v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | uchar(a[pos + i]);
+    return v;
+}
+
+static QDateTime fromDos(quint16 time, quint16 date)
+{
+    return QDateTime(QDate(1980 + (date >> 9), (date >> 5) & 15, date & 31),
+                     QTime(time >> 11, (time >> 5) & 63, (time & 31) * 2));
+}
+
+// Oktalt tal i ett TAR-fält, eller bas 256 när första biten är satt
+static quint64 tarNumber(const char* p, int length)
+{
+    quint64 v = 0;
+    if (uchar(p[0]) & 0x80) {
+        for (int i = 1; i < length; i++) v = (v << 8) | uchar(p[i]);
+        return v;
+    }
+    for (int i = 0; i < length && p[i]; i++) {
+        if (p[i] >= '0' && p[i] <= '7') v = (v << 3) | quint64(p[i] - '0');
+    }
+    return v;
+}
+
+static QString tarString(const char* p, int length)
+{
+    return QString::fromUtf8(p, int(qstrnlen(p, uint(length))));
+}
+
+bool ArchiveReader::open(const QString& path)
+{
+    m_File.close();
+    m_Entries.clear();
+    m_File.setFileName(path);
+    if (!m_File.open(QIODevice::ReadOnly)) {
+        qWarning() << "ArchiveReader: cannot read" << path;
+        return false;
+    }
+    m_Zip = QFileInfo(path).suffix().toLower() != "tar";
+    if (m_Zip ? readZip() : readTar()) return true;
+    qWarning() << "ArchiveReader: not a" << (m_Zip ? "ZIP" : "TAR") << "archive" << path;
+    m_File.close();
+    m_Entries.clear();
+    return false;
+}
+
+bool ArchiveReader::readZip()
+{
+    // Slutposten ligger sist, följd av högst 64 kB kommentar
+    const qint64 size = m_File.size();
+    const qint64 tail = qMin<qint64>(size, 22 + 0xffff + 20);
+    m_File.seek(size - tail);
+    const QByteArray end = m_File.read(tail);
+    int pos = -1;
+    for (int i = end.size() - 22; i >= 0; i--) {
+        if (readLE(end, i, 4) == 0x06054b50) {
+            pos = i;
+            break;
+        }
+    }
+    if (pos < 0) return false;
+    quint64 count = readLE(end, pos + 10, 2);
+    quint64 directorySize = readLE(end, pos + 12, 4);
+    quint64 directoryOffset = readLE(end, pos + 16, 4);
+    if (pos >= 20 && readLE(end, pos - 20, 4) == 0x07064b50) {
+        m_File.seek(qint64(readLE(end, pos - 12, 8)));
+        const QByteArray record = m_File.read(56);
+        if (record.size() < 56 || readLE(record, 0, 4) != 0x06064b50) return false;
+        count = readLE(record, 32, 8);
+        directorySize = readLE(record, 40, 8);
+        directoryOffset = readLE(record, 48, 8);
+    }
+    if (directoryOffset + directorySize > quint64(size)) return false;
+    m_File.seek(qint64(directoryOffset));
+    const QByteArray d = m_File.read(qint64(directorySize));
+    int p = 0;
+    for (quint64 i = 0; i < count; i++) {
+        if (p + 46 > d.size() || readLE(d, p, 4) != 0x02014b50) return false;
+        Entry e;
+        e.method = quint16(readLE(d, p + 10, 2));
+        e.modified = fromDos(quint16(readLE(d, p + 12, 2)), quint16(readLE(d, p + 14, 2)));
+        e.crc = quint32(readLE(d, p + 16, 4));
+        e.compressedSize = readLE(d, p + 20, 4);
+        e.size = readLE(d, p + 24, 4);
+        const int nameLength = int(readLE(d, p + 28, 2));
+        const int extraLength = int(readLE(d, p + 30, 2));
+        const int commentLength = int(readLE(d, p + 32, 2));
+        e.offset = readLE(d, p + 42, 4);
+        if (p + 46 + nameLength + extraLength > d.size()) return false;
+        const QString name = QString::fromUtf8(d.constData() + p + 46, nameLength);
+        // ZIP64-fältet har bara de värden som inte rymdes, i den här ordningen
+        for (int x = p + 46 + nameLength; x + 4 <= p + 46 + nameLength + extraLength;) {
+            const int id = int(readLE(d, x, 2));
+            const int length = int(readLE(d, x + 2, 2));
+            if (id == 0x0001) {
+                int f = x + 4;
+                if (e.size == zip32Max && f + 8 <= x + 4 + length) { e.size = readLE(d, f, 8); f += 8; }
+                if (e.compressedSize == zip32Max && f + 8 <= x + 4 + length) { e.compressedSize = readLE(d, f, 8); f += 8; }
+                if (e.offset == zip32Max && f + 8 <= x + 4 + length) e.offset = readLE(d, f, 8);
+            }
+            x += 4 + length;
+        }
+        if (!name.endsWith('/')) m_Entries.insert(name, e);
+        p += 46 + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+bool ArchiveReader::readTar()
+{
+    const quint64 size = quint64(m_File.size());
+    quint64 pos = 0;
+    QString longName;
+    while (pos + 512 <= size) {
+        m_File.seek(qint64(pos));
+        const QByteArray h = m_File.read(512);
+        if (h.size() < 512) return false;
+        if (h.count(char(0)) == 512) return true;
+        const char* p = h.constData();
+        const quint64 length = tarNumber(p + 124, 12);
+        const char type = p[156];
+        Entry e;
+        e.offset = pos + 512;
+        e.size = length;
+        e.compressedSize = length;
+        e.modified = QDateTime::fromSecsSinceEpoch(qint64(tarNumber(p + 136, 12)));
+        pos += 512 + (length + 511) / 512 * 512;
+        if (type == 'L') {
+            // GNU-långnamnet gäller nästa post
+            m_File.seek(qint64(e.offset));
+            longName = QString::fromUtf8(m_File.read(qint64(length))).section(QChar(0), 0, 0);
+            continue;
+        }
+        QString name = tarString(p, 100);
+        if (std::memcmp(p + 257, "ustar", 5) == 0 && p[345]) name = tarString(p + 345, 155) + "/" + name;
+        if (!longName.isEmpty()) name = longName;
+        longName.clear();
+        if (type == '0' || type == '\0') m_Entries.insert(name, e);
+    }
+    return !m_Entries.isEmpty();
+}
+
+qint64 ArchiveReader::dataOffset(const Entry& e)
+{
+    if (!m_Zip) return qint64(e.offset);
+    // Lokala huvudets extrafält kan skilja sig från centralkatalogens
+    m_File.seek(qint64(e.offset));
+    const QByteArray h = m_File.read(30);
+    if (h.size() < 30 || readLE(h, 0, 4) != 0x04034b50) return -1;
+    return qint64(e.offset + 30 + readLE(h, 26, 2) + readLE(h, 28, 2));
+}
+
+QByteArray ArchiveReader::read(const QString& name, quint64 from, qint64 length)
+{
+    if (!m_Entries.contains(name)) return QByteArray();
+    const Entry e = m_Entries.value(name);
+    if (from >= e.size) return QByteArray();
+    const quint64 count = length < 0 ? e.size - from : qMin(quint64(length), e.size - from);
+    const qint64 data = dataOffset(e);
+    if (data < 0) {
+        qWarning() << "ArchiveReader: damaged entry" << name;
+        return QByteArray();
+    }
+    if (e.method == 0) {
+        m_File.seek(data + qint64(from));
+        return m_File.read(qint64(count));
+    }
+    if (e.method != 8) {
+        qWarning() << "ArchiveReader: unsupported method" << e.method << name;
+        return QByteArray();
+    }
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, -MAX_WBITS) != Z_OK) return QByteArray();
+    m_File.seek(data);
+    QByteArray result;
+    result.reserve(qsizetype(count));
+    QByteArray out(chunkSize, 0);
+    quint64 position = 0;
+    quint64 remaining = e.compressedSize;
+    int status = Z_OK;
+    while (status == Z_OK && remaining > 0 && quint64(result.size()) < count) {
+        const QByteArray in = m_File.read(qMin<qint64>(chunkSize, qint64(remaining)));
+        if (in.isEmpty()) break;
+        remaining -= quint64(in.size());
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.constData()));
+        z.avail_in = uInt(in.size());
+        do {
+            z.next_out = reinterpret_cast<Bytef*>(out.data());
+            z.avail_out = uInt(out.size());
+            status = inflate(&z, Z_NO_FLUSH);
+            // Inget mer att göra utan mer indata, nästa bit läses
+            if (status == Z_BUF_ERROR) {
+                status = Z_OK;
+                break;
+            }
+            if (status != Z_OK && status != Z_STREAM_END) break;
+            const quint64 produced = quint64(out.size()) - z.avail_out;
+            // Bara den del av utdata som ligger i intervallet sparas
+            const quint64 first = qMax(position, from);
+            const quint64 last = qMin(position + produced, from + count);
+            if (last > first) result.append(out.constData() + (first - position), qsizetype(last - first));
+            position += produced;
+        } while ((z.avail_in > 0 || z.avail_out == 0) && status == Z_OK && quint64(result.size()) < count);
+    }
+    inflateEnd(&z);
+    if (quint64(result.size()) != count) qWarning() << "ArchiveReader: damaged entry" << name;
+    return result;
+}
@@ -0,0 +1,42 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <QFile>
+#include <QHash>
+#include <QDateTime>
+#include <QStringList>
+
+// Läser poster ur ett ZIP- eller TAR-arkiv som ArchiveWriter skrivit, utan att
+// packa upp det. ZIP läses ur centralkatalogen (ZIP64 när den finns), TAR går
+// igenom huvudena en gång. Lagrade poster läses direkt ur filen, deflate-poster
+// packas upp fram till det efterfrågade intervallet.
+
+class ArchiveReader
+{
+public:
+    struct Entry {
+        quint64 offset = 0;         // ZIP: lokala huvudet, TAR: datat
+        quint64 size = 0;
+        quint64 compressedSize = 0;
+        quint16 method = 0;         // 0 lagrad, 8 deflate
+        quint32 crc = 0;            // bara ZIP
+        QDateTime modified;
+    };
+    bool open(const QString& path);
+    bool isOpen() const { return m_File.isOpen(); }
+    QString path() const { return m_File.fileName(); }
+    bool contains(const QString& name) const { return m_Entries.contains(name); }
+    Entry entry(const QString& name) const { return m_Entries.value(name); }
+    QStringList names() const { return m_Entries.keys(); }
+    // Byte from till from + length (-1 = resten) av postens okomprimerade innehåll
+    QByteArray read(const QString& name, quint64 from = 0, qint64 length = -1);
+private:
+    bool readZip();
+    bool readTar();
+    qint64 dataOffset(const Entry& e);
+    QFile m_File;
+    bool m_Zip = true;
+    QHash<QString,Entry> m_Entries;
+};
+
+#endif // ARCHIVEREADER_H
@@ -0,0 +1,298 @@
+#include "archivewriter.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QBuffer>
+#include <QDebug>
+#include <cstring>
+#ifdef QT_BUNDLED_ZLIB
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+static const qint64 chunkSize = 1 << 20;
+static const quint64 zip32Max = 0xffffffffu;
+
+static void appendLE(QByteArray& a, quint64 v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) a.append(char(v >> (8 * i)));
+}
+
+// DOS-tid med två sekunders upplösning
+static quint16 dosTime(const QDateTime& t)
+{
+    return quint16((t.time().hour() << 11) | (t.time().minute() << 5) | (t.time().second() / 2));
+}
+
+static quint16 dosDate(const QDateTime& t)
+{
+    return quint16((qMax(0, t.date().year() - 1980) << 9) | (t.date().month() << 5) | t.date().day());
+}
+
+ArchiveWriter::Format ArchiveWriter::formatFor(const QString& path)
+{
+    return QFileInfo(path).suffix().toLower() == "tar" ? Tar : Zip;
+}
+
+bool ArchiveWriter::compressible(const QString& name)
+{
+    static const QStringList stored = { "jpg", "jpeg", "png", "webp", "avi", "gz", "br", "zip" };
+    return !stored.contains(QFileInfo(name).suffix().toLower());
+}
+
+bool ArchiveWriter::write(const QByteArray& data)
+{
+    if (m_Device->write(data) != data.size()) {
+        qWarning() << "ArchiveWriter:" << m_Device->errorString();
+        return false;
+    }
+    m_Offset += data.size();
+    return true;
+}
+
+bool ArchiveWriter::addData(const QString& name, const QByteArray& data, const QDateTime& modified)
+{
+    QByteArray copy = data;
+    QBuffer buffer(&copy);
+    buffer.open(QIODevice::ReadOnly);
+    return addEntry(name, &buffer, quint64(data.size()), modified);
+}
+
+bool ArchiveWriter::addFile(const QString& name, const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "ArchiveWriter: cannot read" << path;
+        return false;
+    }
+    return addEntry(name, &file, quint64(file.size()), QFileInfo(path).lastModified());
+}
+
+bool ArchiveWriter::addDirectory(const QString& prefix, const QString& dirPath)
+{
+    const QDir dir(dirPath);
+    QStringList files;
+    QDirIterator it(dirPath, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) files << dir.relativeFilePath(it.next());
+    // Stabil ordning, så att samma export ger samma arkiv
+    files.sort();
+    for (const QString& file : files) {
+        if (!addFile(prefix.isEmpty() ? file : prefix + "/" + file, dir.filePath(file))) return false;
+    }
+    return true;
+}
+
+bool ArchiveWriter::addEntry(const QString& name, QIODevice* source, quint64 size, const QDateTime& modified)
+{
+    const QByteArray n = name.toUtf8();
+    return m_Format == Zip ? zipEntry(n, source, size, modified) : tarEntry(n, source, size, modified);
+}
+
+bool ArchiveWriter::zipEntry(const QByteArray& name, QIODevice* source, quint64 size, const QDateTime& modified)
+{
+    Entry e;
+    e.name = name;
+    e.offset = m_Offset;
+    e.method = compressible(QString::fromUtf8(name)) ? 8 : 0;
+    e.time = dosTime(modified);
+    e.date = dosDate(modified);
+    e.crc = crc32(0, nullptr, 0);
+    e.size = 0;
+    e.compressedSize = 0;
+    // Deflate kan växa något för data som inte går att packa
+    const bool zip64 = size >= zip32Max - (size >> 8) - 1024;
+
+    // Lokalt huvud: bit 3 = storlek och CRC följer efter datat, bit 11 = UTF-8-namn
+    QByteArray h;
+    appendLE(h, 0x04034b50, 4);
+    appendLE(h, zip64 ? 45 : 20, 2);
+    appendLE(h, 0x0808, 2);
+    appendLE(h, e.method, 2);
+    appendLE(h, e.time, 2);
+    appendLE(h, e.date, 2);
+    appendLE(h, 0, 4);
+    appendLE(h, zip64 ? zip32Max : 0, 4);
+    appendLE(h, zip64 ? zip32Max : 0, 4);
+    appendLE(h, name.size(), 2);
+    appendLE(h, zip64 ? 20 : 0, 2);
+    h.append(name);
+    if (zip64) {
+        appendLE(h, 0x0001, 2);
+        appendLE(h, 16, 2);
+        appendLE(h, 0, 8);
+        appendLE(h, 0, 8);
+    }
+    if (!write(h)) return false;
+
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (e.method == 8 && deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+    QByteArray out(chunkSize, 0);
+    bool ok = true;
+    for (bool last = false; ok && !last;) {
+        const QByteArray in = source->read(chunkSize);
+        last = in.size() < chunkSize;
+        e.crc = crc32(e.crc, reinterpret_cast<const Bytef*>(in.constData()), uInt(in.size()));
+        e.size += in.size();
+        if (e.method == 0) {
+            ok = write(in);
+            e.compressedSize += in.size();
+            continue;
+        }
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.constData()));
+        z.avail_in = uInt(in.size());
+        do {
+            z.next_out = reinterpret_cast<Bytef*>(out.data());
+            z.avail_out = uInt(out.size());
+            deflate(&z, last ? Z_FINISH : Z_NO_FLUSH);
+            const int produced = out.size() - int(z.avail_out);
+            ok = write(QByteArray::fromRawData(out.constData(), produced));
+            e.compressedSize += produced;
+        } while (ok && z.avail_out == 0);
+    }
+    if (e.method == 8) deflateEnd(&z);
+    if (!ok) return false;
+    if (e.size != size) qWarning() << "ArchiveWriter: size changed while reading" << name;
+
+    QByteArray d;
+    appendLE(d, 0x08074b50, 4);
+    appendLE(d, e.crc, 4);
+    appendLE(d, e.compressedSize, zip64 ? 8 : 4);
+    appendLE(d, e.size, zip64 ? 8 : 4);
+    m_Entries.append(e);
+    return write(d);
+}
+
+bool ArchiveWriter::tarHeader(const QByteArray& name, quint64 size, const QDateTime& modified, char type)
+{
+    QByteArray h(512, 0);
+    char* p = h.data();
+    // ustar delar långa namn i prefix (155) och namn (100) vid ett snedstreck
+    QByteArray prefix;
+    QByteArray rest = name;
+    if (rest.size() > 100) {
+        const int cut = rest.lastIndexOf('/', 155);
+        if (cut > 0 && rest.size() - cut - 1 <= 100) {
+            prefix = rest.left(cut);
+            rest = rest.mid(cut + 1);
+        }
+    }
+    memcpy(p, rest.constData(), qMin<qsizetype>(rest.size(), 100));
+    memcpy(p + 100, "0000644", 7);
+    memcpy(p + 108, "0000000", 7);
+    memcpy(p + 116, "0000000", 7);
+    if (size < 077777777777ull) {
+        qsnprintf(p + 124, 12, "%011llo", static_cast<unsigned long long>(size));
+    } else {
+        // Bas 256 för storlekar över 8 GB
+        p[124] = char(0x80);
+        for (int i = 0; i < 8; i++) p[135 - i] = char(size >> (8 * i));
+    }
+    qsnprintf(p + 136, 12, "%011llo", static_cast<unsigned long long>(qMax<qint64>(0, modified.toSecsSinceEpoch())));
+    memset(p + 148, ' ', 8);
+    p[156] = type;
+    memcpy(p + 257, "ustar", 6);
+    memcpy(p + 263, "00", 2);
+    memcpy(p + 345, prefix.constData(), qMin<qsizetype>(prefix.size(), 155));
+    unsigned int sum = 0;
+    for (int i = 0; i < 512; i++) sum += uchar(p[i]);
+    qsnprintf(p + 148, 8, "%06o", sum);
+    p[155] = ' ';
+    return write(h);
+}
+
+bool ArchiveWriter::tarEntry(const QByteArray& name, QIODevice* source, quint64 size, const QDateTime& modified)
+{
+    // Namn som inte ryms i ustar får ett GNU-långnamn före posten
+    const int cut = name.lastIndexOf('/', 155);
+    if (name.size() > 100 && !(cut > 0 && name.size() - cut - 1 <= 100)) {
+        const QByteArray longName = name + '\0';
+        if (!tarHeader("././@LongLink", quint64(longName.size()), modified, 'L')) return false;
+        if (!write(longName + QByteArray((512 - longName.size() % 512) % 512, 0))) return false;
+    }
+    if (!tarHeader(name, size, modified, '0')) return false;
+    quint64 written = 0;
+    while (written < size) {
+        QByteArray in = source->read(qMin<qint64>(chunkSize, qint64(size - written)));
+        if (in.isEmpty()) {
+            // Filen krympte, huvudet har redan lovat size byte
+            qWarning() << "ArchiveWriter: size changed while reading" << name;
+            in = QByteArray(int(qMin<quint64>(chunkSize, size - written)), 0);
+        }
+        if (!write(in)) return false;
+        written += in.size();
+    }
+    return write(QByteArray(int((512 - size % 512) % 512), 0));
+}
+
+bool ArchiveWriter::finish()
+{
+    if (m_Format == Tar) return write(QByteArray(1024, 0));
+
+    const quint64 directoryOffset = m_Offset;
+    for (const Entry& e : m_Entries) {
+        QByteArray extra;
+        if (e.size >= zip32Max) appendLE(extra, e.size, 8);
+        if (e.compressedSize >= zip32Max) appendLE(extra, e.compressedSize, 8);
+        if (e.offset >= zip32Max) appendLE(extra, e.offset, 8);
+        if (!extra.isEmpty()) {
+            QByteArray field;
+            appendLE(field, 0x0001, 2);
+            appendLE(field, extra.size(), 2);
+            extra.prepend(field);
+        }
+        QByteArray h;
+        appendLE(h, 0x02014b50, 4);
+        appendLE(h, (3 << 8) | 45, 2);
+        appendLE(h, extra.isEmpty() ? 20 : 45, 2);
+        appendLE(h, 0x0808, 2);
+        appendLE(h, e.method, 2);
+        appendLE(h, e.time, 2);
+        appendLE(h, e.date, 2);
+        appendLE(h, e.crc, 4);
+        appendLE(h, qMin(e.compressedSize, zip32Max), 4);
+        appendLE(h, qMin(e.size, zip32Max), 4);
+        appendLE(h, e.name.size(), 2);
+        appendLE(h, extra.size(), 2);
+        appendLE(h, 0, 2);
+        appendLE(h, 0, 2);
+        appendLE(h, 0, 2);
+        appendLE(h, quint64(0100644) << 16, 4);
+        appendLE(h, qMin(e.offset, zip32Max), 4);
+        h.append(e.name);
+        h.append(extra);
+        if (!write(h)) return false;
+    }
+    const quint64 directorySize = m_Offset - directoryOffset;
+    const quint64 count = quint64(m_Entries.size());
+    QByteArray end;
+    if (count >= 0xffff || directoryOffset >= zip32Max || directorySize >= zip32Max) {
+        const quint64 recordOffset = m_Offset;
+        appendLE(end, 0x06064b50, 4);
+        appendLE(end, 44, 8);
+        appendLE(end, 45, 2);
+        appendLE(end, 45, 2);
+        appendLE(end, 0, 4);
+        appendLE(end, 0, 4);
+        appendLE(end, count, 8);
+        appendLE(end, count, 8);
+        appendLE(end, directorySize, 8);
+        appendLE(end, directoryOffset, 8);
+        appendLE(end, 0x07064b50, 4);
+        appendLE(end, 0, 4);
+        appendLE(end, recordOffset, 8);
+        appendLE(end, 1, 4);
+    }
+    appendLE(end, 0x06054b50, 4);
+    appendLE(end, 0, 2);
+    appendLE(end, 0, 2);
+    appendLE(end, qMin<quint64>(count, 0xffff), 2);
+    appendLE(end, qMin<quint64>(count, 0xffff), 2);
+    appendLE(end, qMin(directorySize, zip32Max), 4);
+    appendLE(end, qMin(directoryOffset, zip32Max), 4);
+    appendLE(end, 0, 2);
+    m_Entries.clear();
+    return write(end);
+}
@@ -0,0 +1,50 @@
+#ifndef ARCHIVEWRITER_H
+#define ARCHIVEWRITER_H
+
+#include <QIODevice>
+#include <QDateTime>
+#include <QList>
+
+// Sekventiellt skrivet ZIP- eller TAR-arkiv. Inget skrivs om och ingenting söks
+// tillbaka, så utdata kan gå direkt till en fil eller ett rör. ZIP-posternas CRC
+// och storlekar står i en databeskrivare efter datat (ZIP64 när de behövs).
+// Redan komprimerade format (JPEG, PNG, WebP, AVI) lagras som de är.
+
+class ArchiveWriter
+{
+public:
+    enum Format { Zip, Tar };
+    ArchiveWriter(QIODevice* device, Format format) : m_Device(device), m_Format(format) {}
+    // TAR för .tar, annars ZIP
+    static Format formatFor(const QString& path);
+    bool addData(const QString& name, const QByteArray& data, const QDateTime& modified = QDateTime::currentDateTime());
+    // Filen läses och skrivs i bitar, den hålls aldrig hel i minnet
+    bool addFile(const QString& name, const QString& path);
+    // Alla filer under dirPath, med prefix/ framför de relativa sökvägarna
+    bool addDirectory(const QString& prefix, const QString& dirPath);
+    // Centralkatalogen (ZIP) eller slutblocken (TAR)
+    bool finish();
+    static bool compressible(const QString& name);
+private:
+    struct Entry {
+        QByteArray name;
+        quint32 crc;
+        quint64 compressedSize;
+        quint64 size;
+        quint64 offset;
+        quint16 method;
+        quint16 time;
+        quint16 date;
+    };
+    bool write(const QByteArray& data);
+    bool addEntry(const QString& name, QIODevice* source, quint64 size, const QDateTime& modified);
+    bool zipEntry(const QByteArray& name, QIODevice* source, quint64 size, const QDateTime& modified);
+    bool tarEntry(const QByteArray& name, QIODevice* source, quint64 size, const QDateTime& modified);
+    bool tarHeader(const QByteArray& name, quint64 size, const QDateTime& modified, char type);
+    QIODevice* m_Device;
+    Format m_Format;
+    quint64 m_Offset = 0;
+    QList<Entry> m_Entries;
+};
+
+#endif // ARCHIVEWRITER_H
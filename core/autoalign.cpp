@@ -0,0 +1,192 @@
+#include "autoalign.h"
+#include "anchorsolver.h"
+#include "imagemetadata.h"
+#include <QImageReader>
+#include <QDebug>
+#include <qmath.h>
+
+float AutoAlign::Level::at(double x, double y, bool* inside) const
+{
+    x -= 0.5;
+    y -= 0.5;
+    if (x < 0 || y < 0 || x > width - 1 || y > height - 1) {
+        *inside = false;
+        return 0;
+    }
+    const int x0 = qMin(int(x), qMax(0, width - 2));
+    const int y0 = qMin(int(y), qMax(0, height - 2));
+    const float fx = float(x - x0);
+    const float fy = float(y - y0);
+    const float* p = data.constData() + y0 * width + x0;
+    const int dx = width > 1 ? 1 : 0;
+    const int dy = height > 1 ? width : 0;
+    *inside = true;
+    return (p[0] * (1 - fx) + p[dx] * fx) * (1 - fy) + (p[dy] * (1 - fx) + p[dy + dx] * fx) * fy;
+}
+
+AutoAlign::Level AutoAlign::gradient(const QImage& image, double scale)
+{
+    const QImage g = image.convertToFormat(QImage::Format_Grayscale8);
+    Level l;
+    l.width = g.width();
+    l.height = g.height();
+    l.scale = scale;
+    l.data = QVector<float>(l.width * l.height, 0);
+    // Gradientens storlek tål att före- och efterbilden har olika ton
+    for (int y = 1; y < l.height - 1; ++y) {
+        const uchar* up = g.constScanLine(y - 1);
+        const uchar* row = g.constScanLine(y);
+        const uchar* down = g.constScanLine(y + 1);
+        for (int x = 1; x < l.width - 1; ++x) {
+            const float gx = float(row[x + 1]) - row[x - 1];
+            const float gy = float(down[x]) - up[x];
+            l.data[y * l.width + x] = std::sqrt(gx * gx + gy * gy);
+        }
+    }
+    return l;
+}
+
+QVector<AutoAlign::Level> AutoAlign::pyramid(const QString& path, int longSide, int levels, QSize* originalSize)
+{
+    QImageReader r(path);
+    const QSize size = ImageMetadata::size(r);
+    *originalSize = size;
+    if (size.isEmpty()) return QVector<Level>();
+    QImage image = ImageMetadata::read(r, size.scaled(longSide, longSide, Qt::KeepAspectRatio));
+    if (image.isNull()) return QVector<Level>();
+    QVector<Level> p;
+    for (int i = 0; i < levels; ++i) {
+        p.prepend(gradient(image, double(image.width()) / size.width()));
+        image = image.scaled(qMax(1, image.width() / 2), qMax(1, image.height() / 2), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return p;
+}
+
+double AutoAlign::score(const Level& before, const Level& after, const QTransform& t)
+{
+    bool invertible;
+    const QTransform inv = t.inverted(&invertible);
+    if (!invertible) return -1;
+    double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+    int n = 0;
+    for (int y = 0; y < before.height; ++y) {
+        const float* row = before.data.constData() + y * before.width;
+        for (int x = 0; x < before.width; ++x) {
+            const QPointF p = inv.map(QPointF((x + 0.5) / before.scale, (y + 0.5) / before.scale));
+            bool inside;
+            const double a = after.at(p.x() * after.scale, p.y() * after.scale, &inside);
+            if (!inside) continue;
+            const double b = row[x];
+            sa += a;
+            sb += b;
+            saa += a * a;
+            sbb += b * b;
+            sab += a * b;
+            ++n;
+        }
+    }
+    // Minst en fjärdedel överlapp, annars räknas det inte som en träff
+    if (n < before.width * before.height / 4) return -1;
+    const double va = saa - sa * sa / n;
+    const double vb = sbb - sb * sb / n;
+    if (va <= 0 || vb <= 0) return -1;
+    return (sab - sa * sb / n) / std::sqrt(va * vb);
+}
+
+QTransform AutoAlign::similarity(const QPointF& beforeCentre, const QPointF& afterCentre,
+                                 double tx, double ty, double angle, double scale)
+{
+    QTransform t;
+    t.translate(beforeCentre.x() + tx, beforeCentre.y() + ty);
+    t.rotateRadians(angle);
+    t.scale(scale, scale);
+    t.translate(-afterCentre.x(), -afterCentre.y());
+    return t;
+}
+
+AutoAlign::Result AutoAlign::align(const QMap<QString,QVariant>& project)
+{
+    Result result;
+    QSize beforeSize, afterSize;
+    const int levels = 4;
+    const QVector<Level> before = pyramid(project.value("BeforePix").toString(), 512, levels, &beforeSize);
+    const QVector<Level> after = pyramid(project.value("AfterPix").toString(), 512, levels, &afterSize);
+    if (before.size() != levels || after.size() != levels) return result;
+
+    QList<QPointF> anchorsAfter, anchorsBefore;
+    for (int i = 1; ; ++i) {
+        const QString b = QString("AnchorBefore%1").arg(i);
+        const QString a = QString("AnchorAfter%1").arg(i);
+        if (!project.contains(b) || !project.contains(a)) break;
+        const QPointF pb = project.value(b).toPointF();
+        const QPointF pa = project.value(a).toPointF();
+        if (pb.isNull() || pa.isNull()) break;
+        anchorsBefore.append(pb);
+        anchorsAfter.append(pa);
+    }
+    if (!anchorsAfter.isEmpty()) {
+        // Fyra par räcker till perspektivet, färre ger förflyttning, likformighet eller affin
+        result.transform = anchorsAfter.size() >= 4 ? AnchorSolver::homography(anchorsAfter, anchorsBefore)
+                                                    : AnchorSolver::fromPoints(anchorsAfter, anchorsBefore);
+        result.fromAnchors = true;
+        result.confidence = qMax(0.0, score(before.last(), after.last(), result.transform));
+        result.ok = true;
+        return result;
+    }
+
+    // Grov sökning på minsta nivån
+    const QPointF cb(beforeSize.width() / 2.0, beforeSize.height() / 2.0);
+    const QPointF ca(afterSize.width() / 2.0, afterSize.height() / 2.0);
+    const double baseScale = double(qMax(beforeSize.width(), beforeSize.height())) / qMax(afterSize.width(), afterSize.height());
+    double best = -2;
+    double p[4] = { 0, 0, 0, baseScale };   // tx, ty, vinkel, skala
+    const Level& b0 = before.first();
+    const Level& a0 = after.first();
+    const double px = 1.0 / b0.scale;       // en nivåpixel i originalkoordinater
+    for (double angle = -10; angle <= 10; angle += 2.5) {
+        for (const double s : { 0.8, 0.9, 1.0, 1.1, 1.25 }) {
+            for (int ty = -b0.height / 4; ty <= b0.height / 4; ty += 2) {
+                for (int tx = -b0.width / 4; tx <= b0.width / 4; tx += 2) {
+                    const double v = score(b0, a0, similarity(cb, ca, tx * px, ty * px, qDegreesToRadians(angle), s * baseScale));
+                    if (v > best) {
+                        best = v;
+                        p[0] = tx * px;
+                        p[1] = ty * px;
+                        p[2] = qDegreesToRadians(angle);
+                        p[3] = s * baseScale;
+                    }
+                }
+            }
+        }
+    }
+    // Förfina nivå för nivå med krympande steg
+    for (int l = 0; l < levels; ++l) {
+        const Level& b = before[l];
+        const Level& a = after[l];
+        double step[4] = { 1.0 / b.scale, 1.0 / b.scale, qDegreesToRadians(1.0) / (1 << l), 0.02 * baseScale / (1 << l) };
+        best = score(b, a, similarity(cb, ca, p[0], p[1], p[2], p[3]));
+        for (int halvings = 0, iterations = 0; halvings < 4 && iterations < 200; ++iterations) {
+            bool improved = false;
+            for (int i = 0; i < 4; ++i) {
+                for (const int sign : { -1, 1 }) {
+                    double q[4] = { p[0], p[1], p[2], p[3] };
+                    q[i] += sign * step[i];
+                    const double v = score(b, a, similarity(cb, ca, q[0], q[1], q[2], q[3]));
+                    if (v > best) {
+                        best = v;
+                        std::copy(q, q + 4, p);
+                        improved = true;
+                    }
+                }
+            }
+            if (!improved) {
+                for (double& s : step) s /= 2;
+                ++halvings;
+            }
+        }
+    }
+    result.transform = similarity(cb, ca, p[0], p[1], p[2], p[3]);
+    result.confidence = qMax(0.0, best);
+    result.ok = best > -1;
+    return result;
+}
@@ -0,0 +1,45 @@
+#ifndef AUTOALIGN_H
+#define AUTOALIGN_H
+
+#include <QImage>
+#include <QTransform>
+#include <QMap>
+#include <QVariant>
+#include <QVector>
+
+// Justering av ett projekt utan GUI, säker att köra från arbetstrådar. Finns
+// ankarpar används de, annars söks en likformighetsavbildning (förflyttning,
+// rotation, skala) fram grovt till fint över en pyramid av gradientbilder.
+// Konfidensen är normaliserad korskorrelation mellan gradienterna i överlappet.
+
+class AutoAlign
+{
+public:
+    struct Result {
+        bool ok = false;
+        bool fromAnchors = false;
+        QTransform transform;   // efterbild -> förebild, originalkoordinater
+        double confidence = 0;
+        bool needsReview() const { return !ok || confidence < reviewThreshold; }
+    };
+    static constexpr double reviewThreshold = 0.5;
+
+    static Result align(const QMap<QString,QVariant>& project);
+
+private:
+    // Gradientbild i en pyramidnivå, scale = nivåpixlar per originalpixel
+    struct Level {
+        int width = 0;
+        int height = 0;
+        double scale = 1;
+        QVector<float> data;
+        float at(double x, double y, bool* inside) const;
+    };
+    static QVector<Level> pyramid(const QString& path, int longSide, int levels, QSize* originalSize);
+    static Level gradient(const QImage& image, double scale);
+    static double score(const Level& before, const Level& after, const QTransform& t);
+    static QTransform similarity(const QPointF& beforeCentre, const QPointF& afterCentre,
+                                 double tx, double ty, double angle, double scale);
+};
+
+#endif // AUTOALIGN_H
@@ -0,0 +1,153 @@
+#include "autostraighten.h"
+#include "anchorsolver.h"
+#include <QVector>
+#include <qmath.h>
+#include <cmath>
+
+static const double binWidth = 0.1;         // grader per fack
+static const double minConfidence = 0.1;    // jämnt fördelade röster ger 0.05
+static const double keystoneWindow = 5;     // grader kring toppen där lodräta kanter räknas
+static const double minKeystone = 0.02;     // relativ breddskillnad mellan över- och underkant
+static const double maxKeystone = 0.5;
+static const double minExplained = 0.25;    // andel av lutningarnas varians som flyktpunkten förklarar
+
+// En lodrät kant, koordinater från bildens mitt. s = dx/dy längs linjen.
+struct Edge {
+    float x;
+    float y;
+    float s;
+    float angle;
+    float weight;
+};
+
+// Sobel i flyttal. Slingorna går över sammanhängande rader så att kompilatorn
+// kan vektorisera dem.
+static void sobel(const QVector<float>& lum, int w, int h, QVector<float>& gx, QVector<float>& gy)
+{
+    gx.fill(0, w * h);
+    gy.fill(0, w * h);
+    for (int y = 1; y < h - 1; y++) {
+        const float* u = lum.constData() + (y - 1) * w;
+        const float* r = u + w;
+        const float* d = r + w;
+        float* ox = gx.data() + y * w + 1;
+        float* oy = gy.data() + y * w + 1;
+        for (int x = 0; x < w - 2; x++) {
+            ox[x] = (u[x + 2] - u[x]) + 2 * (r[x + 2] - r[x]) + (d[x + 2] - d[x]);
+            oy[x] = (d[x] + 2 * d[x + 1] + d[x + 2]) - (u[x] + 2 * u[x + 1] + u[x + 2]);
+        }
+    }
+}
+
+AutoStraighten::Result AutoStraighten::estimate(const QImage& image, const QSize& originalSize)
+{
+    Result result;
+    if (image.isNull() || originalSize.isEmpty()) return result;
+    QImage g = image.convertToFormat(QImage::Format_Grayscale8);
+    if (g.width() > analysisSide || g.height() > analysisSide) {
+        g = g.scaled(analysisSide, analysisSide, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    const int w = g.width();
+    const int h = g.height();
+    if (w < 16 || h < 16) return result;
+    const double sx = double(w) / originalSize.width();
+    const double sy = double(h) / originalSize.height();
+
+    QVector<float> lum(w * h);
+    for (int y = 0; y < h; y++) {
+        const uchar* s = g.constScanLine(y);
+        float* l = lum.data() + y * w;
+        for (int x = 0; x < w; x++) l[x] = s[x];
+    }
+    QVector<float> gx;
+    QVector<float> gy;
+    sobel(lum, w, h, gx, gy);
+    QVector<float> mag(w * h);
+    double sum = 0;
+    for (int i = 0; i < w * h; i++) {
+        mag[i] = std::sqrt(gx[i] * gx[i] + gy[i] * gy[i]);
+        sum += mag[i];
+    }
+    // Bara tydliga kanter röstar, brus och mjuka övergångar har ingen riktning
+    const float threshold = float(qMax(3 * sum / (w * h), 40.0));
+
+    // Gradienten står vinkelrätt mot linjen. Lutningen räknas medurs, som QTransform::rotate.
+    const int bins = 2 * qRound(maxTilt / binWidth) + 1;
+    const int centre = bins / 2;
+    QVector<double> votes(bins, 0);
+    double total = 0;
+    QVector<Edge> verticals;
+    // Skannerns bildkant är ofta rak även när motivet lutar
+    const int border = qMax(2, qMin(w, h) / 50);
+    for (int y = border; y < h - border; y++) {
+        for (int x = border; x < w - border; x++) {
+            const int i = y * w + x;
+            const float m = mag[i];
+            if (m < threshold) continue;
+            const bool vertical = qAbs(gx[i]) >= qAbs(gy[i]);
+            const double angle = qRadiansToDegrees(vertical ? std::atan(gy[i] / gx[i]) : std::atan(-gx[i] / gy[i]));
+            if (qAbs(angle) > maxTilt) continue;
+            votes[centre + qRound(angle / binWidth)] += m;
+            total += m;
+            if (vertical) verticals.append({ x - w / 2.0f, y - h / 2.0f, -gy[i] / gx[i], float(angle), m });
+        }
+    }
+    if (total <= 0) return result;
+
+    // Utjämnat över fem fack, toppen förfinas med en parabel
+    QVector<double> smooth(bins, 0);
+    for (int i = 0; i < bins; i++) {
+        for (int k = qMax(0, i - 2); k <= qMin(bins - 1, i + 2); k++) smooth[i] += votes[k];
+    }
+    int peak = 0;
+    for (int i = 1; i < bins; i++) if (smooth[i] > smooth[peak]) peak = i;
+    double offset = 0;
+    if (peak > 0 && peak < bins - 1) {
+        const double d = smooth[peak - 1] - 2 * smooth[peak] + smooth[peak + 1];
+        if (d < 0) offset = 0.5 * (smooth[peak - 1] - smooth[peak + 1]) / d;
+    }
+    result.angle = (peak - centre + offset) * binWidth;
+    double near = 0;
+    for (int i = 0; i < bins; i++) if (qAbs((i - centre) * binWidth - result.angle) <= 1) near += votes[i];
+    result.confidence = near / total;
+    if (result.confidence < minConfidence) return result;
+    result.ok = true;
+    const QPointF c(originalSize.width() / 2.0, originalSize.height() / 2.0);
+    result.transform = QTransform().translate(c.x(), c.y()).rotate(-result.angle).translate(-c.x(), -c.y());
+
+    // Lodräta linjer mot en flyktpunkt: s = (q * x + a) / (q * y + 1), skrivet
+    // linjärt som s = a + q * (x - s * y). q = 0 är parallella linjer.
+    double sw = 0, sz = 0, szz = 0, ss = 0, szs = 0, sss = 0;
+    for (const Edge& e : verticals) {
+        if (qAbs(e.angle - result.angle) > keystoneWindow) continue;
+        const double z = e.x - e.s * e.y;
+        sw += e.weight;
+        sz += e.weight * z;
+        szz += e.weight * z * z;
+        ss += e.weight * e.s;
+        szs += e.weight * z * e.s;
+        sss += e.weight * e.s * e.s;
+    }
+    const double det = sw * szz - sz * sz;
+    if (sw < 0.25 * total || det <= 0) return result;
+    const double q = (sw * szs - sz * ss) / det;
+    const double a = (ss - q * sz) / sw;
+    const double variance = sss / sw - (ss / sw) * (ss / sw);
+    const double explained = variance > 0 ? q * q * (szz / sw - (sz / sw) * (sz / sw)) / variance : 0;
+    if (qAbs(q) * h < minKeystone || qAbs(q) * h > maxKeystone || explained < minExplained) return result;
+
+    // Bildens vänstra och högra kant följs längs sina linjer och rätas upp till en rektangel
+    QList<QPointF> from;
+    QList<QPointF> to;
+    for (const double y : { -h / 2.0, h / 2.0 }) {
+        for (const double x0 : { -w / 2.0, w / 2.0 }) {
+            const double x = x0 + (a + q * x0) * y;
+            from << QPointF((x + w / 2.0) / sx, (y + h / 2.0) / sy);
+            to << QPointF((x0 + w / 2.0) / sx, (y + h / 2.0) / sy);
+        }
+    }
+    result.transform = AnchorSolver::homography(from, to);
+    result.keystone = true;
+    result.angle = -qRadiansToDegrees(std::atan(a));
+    return result;
+}
@@ -0,0 +1,29 @@
+#ifndef AUTOSTRAIGHTEN_H
+#define AUTOSTRAIGHTEN_H
+
+#include <QImage>
+#include <QTransform>
+
+// Lutning ur bildens dominerande linjer, säker att köra från arbetstrådar.
+// Kantgradienterna på en nedskalad kopia röstar i ett histogram över vinklar
+// nära lodrätt och vågrätt, toppen är bildens lutning. Konvergerar de lodräta
+// linjerna mot en flyktpunkt föreslås i stället en projektiv korrigering.
+
+class AutoStraighten
+{
+public:
+    struct Result {
+        bool ok = false;
+        bool keystone = false;
+        double angle = 0;       // innehållets lutning medurs i grader
+        QTransform transform;   // bild -> uppriktad bild, originalkoordinater
+        double confidence = 0;  // andel av rösterna nära toppen
+    };
+    static constexpr int analysisSide = 1024;
+    static constexpr double maxTilt = 20;
+
+    // image är en proxy av en bild med storleken originalSize
+    static Result estimate(const QImage& image, const QSize& originalSize);
+};
+
+#endif // AUTOSTRAIGHTEN_H
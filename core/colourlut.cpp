@@ -0,0 +1,281 @@
+#include "colourlut.h"
+#include <QPainter>
+#include <QtConcurrent>
+#include <QDebug>
+#include <qmath.h>
+
+static inline double srgbToLinear(double c)
+{
+    c /= 255.0;
+    return c <= 0.04045 ? c / 12.92 : qPow((c + 0.055) / 1.055, 2.4);
+}
+
+static inline double linearToSrgb(double c)
+{
+    c = c <= 0.0031308 ? c * 12.92 : 1.055 * qPow(qMax(c, 0.0), 1.0 / 2.4) - 0.055;
+    return qBound(0.0, c * 255.0, 255.0);
+}
+
+static inline double labF(double t)
+{
+    return t > 0.008856 ? std::cbrt(t) : 7.787 * t + 16.0 / 116.0;
+}
+
+static inline double labFInv(double f)
+{
+    const double f3 = f * f * f;
+    return f3 > 0.008856 ? f3 : (f - 16.0 / 116.0) / 7.787;
+}
+
+// sRGB (D65) -> CIE Lab
+static void rgbToLab(double r, double g, double b, double lab[3])
+{
+    r = srgbToLinear(r);
+    g = srgbToLinear(g);
+    b = srgbToLinear(b);
+    const double fx = labF((0.4124564 * r + 0.3575761 * g + 0.1804375 * b) / 0.95047);
+    const double fy = labF(0.2126729 * r + 0.7151522 * g + 0.0721750 * b);
+    const double fz = labF((0.0193339 * r + 0.1191920 * g + 0.9503041 * b) / 1.08883);
+    lab[0] = 116.0 * fy - 16.0;
+    lab[1] = 500.0 * (fx - fy);
+    lab[2] = 200.0 * (fy - fz);
+}
+
+static QRgb labToRgb(const double lab[3])
+{
+    const double fy = (lab[0] + 16.0) / 116.0;
+    const double x = 0.95047 * labFInv(fy + lab[1] / 500.0);
+    const double y = labFInv(fy);
+    const double z = 1.08883 * labFInv(fy - lab[2] / 200.0);
+    return qRgb(qRound(linearToSrgb(3.2404542 * x - 1.5371385 * y - 0.4985314 * z)),
+                qRound(linearToSrgb(-0.9692660 * x + 1.8760108 * y + 0.0415560 * z)),
+                qRound(linearToSrgb(0.0556434 * x - 0.2040259 * y + 1.0572252 * z)));
+}
+
+static inline int channel(QRgb p, int c)
+{
+    return c == 0 ? qRed(p) : (c == 1 ? qGreen(p) : qBlue(p));
+}
+
+// x + (y - x) * f / 256 för alla fyra kanaler på en gång, f i 0..256
+static inline quint32 lerpPixel(quint32 x, quint32 y, uint f)
+{
+    const quint32 rb = (((x & 0xff00ff) * (256 - f) + (y & 0xff00ff) * f) >> 8) & 0xff00ff;
+    const quint32 ag = (((x >> 8) & 0xff00ff) * (256 - f) + ((y >> 8) & 0xff00ff) * f) & 0xff00ff00;
+    return rb | ag;
+}
+
+void ColourLut::applyRows(uchar* bits, qsizetype bytesPerLine, int w, int first, int last) const
+{
+    if (!m_Curves.isEmpty()) {
+        const quint8* c = m_Curves.constData();
+        for (int y = first; y < last; ++y) {
+            QRgb* p = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+            for (int x = 0; x < w; ++x) {
+                const QRgb v = p[x];
+                p[x] = (v & 0xff000000) | (uint(c[qRed(v)]) << 16) | (uint(c[256 + qGreen(v)]) << 8) | c[512 + qBlue(v)];
+            }
+        }
+        return;
+    }
+    // Trilinjär interpolation, gitterindex och vikt per kanalvärde är förberäknade
+    int index[256];
+    uint frac[256];
+    for (int v = 0; v < 256; ++v) {
+        const int s = v * (cubeSize - 1) * 256 / 255;
+        index[v] = qMin(s >> 8, cubeSize - 2);
+        frac[v] = uint(s - index[v] * 256);
+    }
+    const QRgb* cube = m_Cube.constData();
+    const int n = cubeSize;
+    const int n2 = cubeSize * cubeSize;
+    for (int y = first; y < last; ++y) {
+        QRgb* p = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+        for (int x = 0; x < w; ++x) {
+            const QRgb v = p[x];
+            const int r = qRed(v), g = qGreen(v), b = qBlue(v);
+            const QRgb* c = cube + (index[b] * n + index[g]) * n + index[r];
+            const uint fr = frac[r];
+            const uint fg = frac[g];
+            const quint32 c00 = lerpPixel(c[0], c[1], fr);
+            const quint32 c10 = lerpPixel(c[n], c[n + 1], fr);
+            const quint32 c01 = lerpPixel(c[n2], c[n2 + 1], fr);
+            const quint32 c11 = lerpPixel(c[n2 + n], c[n2 + n + 1], fr);
+            const quint32 out = lerpPixel(lerpPixel(c00, c10, fg), lerpPixel(c01, c11, fg), frac[b]);
+            p[x] = (out & 0x00ffffff) | (v & 0xff000000);
+        }
+    }
+}
+
+// Kurvpost för ett 16-bitarsvärde, linjärt mellan de två närmaste av 256 poster
+static inline quint16 curve16(const quint8* curve, uint v)
+{
+    const uint s = v * 255;
+    const uint i = s / 65535;
+    const quint64 f = s - i * 65535;
+    const quint64 a = curve[i];
+    const quint64 b = curve[qMin(i + 1, 255u)];
+    return quint16(((a * (65535 - f) + b * f) * 257 + 32767) / 65535);
+}
+
+void ColourLut::applyRows64(uchar* bits, qsizetype bytesPerLine, int w, int first, int last) const
+{
+    if (!m_Curves.isEmpty()) {
+        const quint8* c = m_Curves.constData();
+        for (int y = first; y < last; ++y) {
+            QRgba64* p = reinterpret_cast<QRgba64*>(bits + y * bytesPerLine);
+            for (int x = 0; x < w; ++x) {
+                const QRgba64 v = p[x];
+                p[x] = QRgba64::fromRgba64(curve16(c, v.red()), curve16(c + 256, v.green()), curve16(c + 512, v.blue()), v.alpha());
+            }
+        }
+        return;
+    }
+    // Som applyRows men med vikterna i flyttal, kubens 8 bitar skalas upp efteråt
+    const QRgb* cube = m_Cube.constData();
+    const int n = cubeSize;
+    const int n2 = cubeSize * cubeSize;
+    auto position = [](uint v, int& index) {
+        const uint s = v * (cubeSize - 1);
+        index = qMin(int(s / 65535), cubeSize - 2);
+        return float(s - uint(index) * 65535) / 65535.0f;
+    };
+    auto lerp = [](float x, float y, float f) { return x + (y - x) * f; };
+    for (int y = first; y < last; ++y) {
+        QRgba64* p = reinterpret_cast<QRgba64*>(bits + y * bytesPerLine);
+        for (int x = 0; x < w; ++x) {
+            const QRgba64 v = p[x];
+            int ir, ig, ib;
+            const float fr = position(v.red(), ir);
+            const float fg = position(v.green(), ig);
+            const float fb = position(v.blue(), ib);
+            const QRgb* c = cube + (ib * n + ig) * n + ir;
+            quint16 out[3];
+            for (int k = 0; k < 3; ++k) {
+                const float c00 = lerp(channel(c[0], k), channel(c[1], k), fr);
+                const float c10 = lerp(channel(c[n], k), channel(c[n + 1], k), fr);
+                const float c01 = lerp(channel(c[n2], k), channel(c[n2 + 1], k), fr);
+                const float c11 = lerp(channel(c[n2 + n], k), channel(c[n2 + n + 1], k), fr);
+                const float o = lerp(lerp(c00, c10, fg), lerp(c01, c11, fg), fb);
+                out[k] = quint16(qBound(0.0f, o * 257.0f + 0.5f, 65535.0f));
+            }
+            p[x] = QRgba64::fromRgba64(out[0], out[1], out[2], v.alpha());
+        }
+    }
+}
+
+void ColourLut::apply(QImage& image) const
+{
+    if (isNull() || image.isNull()) return;
+    const bool deep = image.format() == QImage::Format_RGBX64 || image.format() == QImage::Format_RGBA64
+                      || image.format() == QImage::Format_RGBA64_Premultiplied;
+    if (!deep && image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32 && image.format() != QImage::Format_ARGB32_Premultiplied) {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    }
+    // Loss från delad data en gång, trådarna skriver direkt i minnet utan scanLine()
+    uchar* bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    const int w = image.width();
+    const int h = image.height();
+    const int chunk = 64;
+    QList<int> starts;
+    for (int y = 0; y < h; y += chunk) starts << y;
+    QtConcurrent::blockingMap(starts, [this, bits, bytesPerLine, w, h, chunk, deep](int y) {
+        if (deep) applyRows64(bits, bytesPerLine, w, y, qMin(y + chunk, h));
+        else applyRows(bits, bytesPerLine, w, y, qMin(y + chunk, h));
+    });
+}
+
+ColourLut ColourLut::estimate(Mode mode, const QImage& source, const QSize& sourceSize, const QTransform& transform,
+                              const QImage& reference, const QSize& referenceSize)
+{
+    ColourLut lut;
+    if (mode == None || source.isNull() || reference.isNull() || sourceSize.isEmpty() || referenceSize.isEmpty()) return lut;
+
+    // Proxybilder i referensens koordinater, källans alfa markerar överlappet
+    const QSize proxySize = referenceSize.scaled(512, 512, Qt::KeepAspectRatio);
+    const QImage ref = reference.scaled(proxySize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(QImage::Format_RGB32);
+    QImage warped(proxySize, QImage::Format_ARGB32_Premultiplied);
+    warped.fill(Qt::transparent);
+    {
+        QPainter p(&warped);
+        p.setRenderHint(QPainter::SmoothPixmapTransform);
+        p.scale(qreal(proxySize.width()) / referenceSize.width(), qreal(proxySize.height()) / referenceSize.height());
+        p.setTransform(transform, true);
+        p.drawImage(QRectF(QPointF(0, 0), sourceSize),
+                    source.scaled(sourceSize.scaled(1024, 1024, Qt::KeepAspectRatio), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    }
+    QVector<QRgb> s;
+    QVector<QRgb> r;
+    for (int y = 0; y < proxySize.height(); ++y) {
+        const QRgb* ws = reinterpret_cast<const QRgb*>(warped.constScanLine(y));
+        const QRgb* rs = reinterpret_cast<const QRgb*>(ref.constScanLine(y));
+        for (int x = 0; x < proxySize.width(); ++x) {
+            if (qAlpha(ws[x]) < 255) continue;
+            s << ws[x];
+            r << rs[x];
+        }
+    }
+    if (s.size() < 256) {
+        qWarning() << "ColourLut: overlap too small for colour matching";
+        return lut;
+    }
+
+    if (mode == Histogram) {
+        lut.m_Curves.resize(768);
+        for (int c = 0; c < 3; ++c) {
+            quint32 hs[256] = {};
+            quint32 hr[256] = {};
+            for (int i = 0; i < s.size(); ++i) {
+                hs[channel(s[i], c)]++;
+                hr[channel(r[i], c)]++;
+            }
+            for (int v = 1; v < 256; ++v) {
+                hs[v] += hs[v - 1];
+                hr[v] += hr[v - 1];
+            }
+            int u = 0;
+            for (int v = 0; v < 256; ++v) {
+                while (u < 255 && hr[u] < hs[v]) ++u;
+                lut.m_Curves[c * 256 + v] = quint8(u);
+            }
+        }
+        return lut;
+    }
+
+    // Medel/varians-överföring (Reinhard) i Lab
+    double meanS[3] = {}, sqS[3] = {}, meanR[3] = {}, sqR[3] = {};
+    double lab[3];
+    for (int i = 0; i < s.size(); ++i) {
+        rgbToLab(qRed(s[i]), qGreen(s[i]), qBlue(s[i]), lab);
+        for (int c = 0; c < 3; ++c) {
+            meanS[c] += lab[c];
+            sqS[c] += lab[c] * lab[c];
+        }
+        rgbToLab(qRed(r[i]), qGreen(r[i]), qBlue(r[i]), lab);
+        for (int c = 0; c < 3; ++c) {
+            meanR[c] += lab[c];
+            sqR[c] += lab[c] * lab[c];
+        }
+    }
+    double gain[3];
+    for (int c = 0; c < 3; ++c) {
+        meanS[c] /= s.size();
+        meanR[c] /= s.size();
+        const double sigmaS = qSqrt(qMax(0.0, sqS[c] / s.size() - meanS[c] * meanS[c]));
+        const double sigmaR = qSqrt(qMax(0.0, sqR[c] / s.size() - meanR[c] * meanR[c]));
+        gain[c] = sigmaS > 1e-3 ? sigmaR / sigmaS : 1.0;
+    }
+    lut.m_Cube.resize(cubeSize * cubeSize * cubeSize);
+    const double step = 255.0 / (cubeSize - 1);
+    for (int b = 0, i = 0; b < cubeSize; ++b) {
+        for (int g = 0; g < cubeSize; ++g) {
+            for (int rr = 0; rr < cubeSize; ++rr, ++i) {
+                rgbToLab(rr * step, g * step, b * step, lab);
+                for (int c = 0; c < 3; ++c) lab[c] = (lab[c] - meanS[c]) * gain[c] + meanR[c];
+                lut.m_Cube[i] = labToRgb(lab);
+            }
+        }
+    }
+    return lut;
+}
@@ -0,0 +1,35 @@
+#ifndef COLOURLUT_H
+#define COLOURLUT_H
+
+#include <QImage>
+#include <QTransform>
+#include <QVector>
+
+// Färgmatchning av efterbilden mot förebilden. Skattas på små proxybilder över
+// överlappet och bakas till en 1D-kurva per kanal (histogram) eller en 3D-LUT
+// (medel/varians i Lab) som sedan appliceras per pixel.
+
+class ColourLut
+{
+public:
+    enum Mode {
+        None,
+        Histogram,
+        MeanVariance
+    };
+    bool isNull() const { return m_Curves.isEmpty() && m_Cube.isEmpty(); }
+    // 32- och 64-bitarsformat ändras på plats, 16 bitar per kanal behålls
+    void apply(QImage& image) const;
+    // source ritas med transform in i referensens koordinater, endast täckta pixlar räknas
+    static ColourLut estimate(Mode mode, const QImage& source, const QSize& sourceSize, const QTransform& transform,
+                              const QImage& reference, const QSize& referenceSize);
+private:
+    // Raderna first..last-1 i bildminnet bits, anropas parallellt
+    void applyRows(uchar* bits, qsizetype bytesPerLine, int w, int first, int last) const;
+    void applyRows64(uchar* bits, qsizetype bytesPerLine, int w, int first, int last) const;
+    static constexpr int cubeSize = 33;
+    QVector<quint8> m_Curves;   // 3 x 256
+    QVector<QRgb> m_Cube;       // cubeSize^3, index (b * N + g) * N + r
+};
+
+#endif // COLOURLUT_H
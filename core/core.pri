@@ -0,0 +1,36 @@
+# Inkluderas av de projekt som länkar mot core
+QT += core gui concurrent network
+CONFIG += c++17
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+win32:CONFIG(release, debug|release): CORE_LIB_DIR = $$OUT_PWD/../core/release
+else:win32:CONFIG(debug, debug|release): CORE_LIB_DIR = $$OUT_PWD/../core/debug
+else: CORE_LIB_DIR = $$OUT_PWD/../core
+
+LIBS += -L$$CORE_LIB_DIR -lBeforeAfterCore
+
+win32-g++: PRE_TARGETDEPS += $$CORE_LIB_DIR/libBeforeAfterCore.a
+else:win32:!win32-g++: PRE_TARGETDEPS += $$CORE_LIB_DIR/BeforeAfterCore.lib
+else: PRE_TARGETDEPS += $$CORE_LIB_DIR/libBeforeAfterCore.a
+
+# zlib för den strömmande PNG-kodaren och arkiven, samma val som i core.pro
+packagesExist(zlib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+} else:!isEmpty(ZLIB_PATH) {
+    win32:!win32-g++: LIBS += -L$$ZLIB_PATH/lib -lzlib
+    else: LIBS += -L$$ZLIB_PATH/lib -lz
+} else:win32 {
+    # Qts kopia ligger redan i QtCore
+    QT += core-private
+} else {
+    LIBS += -lz
+}
+
+# Valfri brotli för galleriets förkomprimerade filer, se core.pro
+packagesExist(libbrotlienc) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libbrotlienc
+}
@@ -0,0 +1,85 @@
+TEMPLATE = lib
+TARGET = BeforeAfterCore
+
+QT       = core gui concurrent network
+
+CONFIG += staticlib c++17
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+    anchorsolver.cpp \
+    archivereader.cpp \
+    archivewriter.cpp \
+    autoalign.cpp \
+    autostraighten.cpp \
+    colourlut.cpp \
+    deepzoom.cpp \
+    epochstack.cpp \
+    gallerybundle.cpp \
+    gallerywriter.cpp \
+    imageencoder.cpp \
+    imagehash.cpp \
+    imagemetadata.cpp \
+    imagepair.cpp \
+    imageprefetcher.cpp \
+    lensdistortion.cpp \
+    masklayer.cpp \
+    previewserver.cpp \
+    remaplut.cpp \
+    scanfilter.cpp \
+    stripexport.cpp \
+    thumbnailcache.cpp \
+    tilecache.cpp \
+    wipeanimation.cpp
+
+HEADERS += \
+    anchorsolver.h \
+    archivereader.h \
+    archivewriter.h \
+    autoalign.h \
+    autostraighten.h \
+    colourlut.h \
+    deepzoom.h \
+    epochstack.h \
+    exportoptions.h \
+    gallerybundle.h \
+    gallerywriter.h \
+    imageencoder.h \
+    imagehash.h \
+    imagemetadata.h \
+    imagepair.h \
+    imageprefetcher.h \
+    lensdistortion.h \
+    masklayer.h \
+    previewserver.h \
+    projectstore.h \
+    projectvalues.h \
+    remaplut.h \
+    scanfilter.h \
+    stripexport.h \
+    thumbnailcache.h \
+    tilecache.h \
+    wipeanimation.h
+
+# zlib för den strömmande PNG-kodaren, galleriet och arkiven: systemets via
+# pkg-config, en egen med ZLIB_PATH=..., annars Qts inbyggda kopia på Windows.
+# Länkningen sker i core.pri.
+packagesExist(zlib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+} else:!isEmpty(ZLIB_PATH) {
+    INCLUDEPATH += $$ZLIB_PATH/include
+} else:win32 {
+    QT += core-private
+    DEFINES += QT_BUNDLED_ZLIB
+}
+
+# Brotli är valfritt, utan det förkomprimeras galleriet bara med gzip
+packagesExist(libbrotlienc) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libbrotlienc
+    DEFINES += HAVE_BROTLI
+}
@@ -0,0 +1,110 @@
+#include "deepzoom.h"
+#include "stripexport.h"
+#include <QImageReader>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <QDebug>
+#include <qmath.h>
+#include <atomic>
+
+int DeepZoom::maxLevel(const QSize& size)
+{
+    return qCeil(std::log2(qMax(1, qMax(size.width(), size.height()))));
+}
+
+QSize DeepZoom::levelSize(const QSize& size, int level)
+{
+    const double f = std::ldexp(1.0, maxLevel(size) - level);
+    return QSize(qMax(1, qCeil(size.width() / f)), qMax(1, qCeil(size.height() / f)));
+}
+
+QRect DeepZoom::tileRect(int column, int row, const QSize& levelSize) const
+{
+    const int x0 = qMax(0, column * m_TileSize - m_Overlap);
+    const int y0 = qMax(0, row * m_TileSize - m_Overlap);
+    const int x1 = qMin(levelSize.width(), (column + 1) * m_TileSize + m_Overlap);
+    const int y1 = qMin(levelSize.height(), (row + 1) * m_TileSize + m_Overlap);
+    return QRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool DeepZoom::writeTileRow(const QImage& image, int top, int row, const QSize& levelSize, const QString& dir) const
+{
+    const int columns = (levelSize.width() + m_TileSize - 1) / m_TileSize;
+    QList<int> tiles;
+    for (int c = 0; c < columns; ++c) tiles.append(c);
+    std::atomic<bool> ok(true);
+    QtConcurrent::blockingMap(tiles, [&](const int& column) {
+        const QRect r = tileRect(column, row, levelSize);
+        const QImage tile = image.copy(r.translated(0, -top));
+        if (!tile.save(QString("%1/%2_%3.jpg").arg(dir).arg(column).arg(row), "JPG", m_Quality)) ok = false;
+    });
+    return ok;
+}
+
+bool DeepZoom::exportLevel(const QString& sourcePath, const QSize& size, int level, const QString& dir) const
+{
+    const QSize ls = levelSize(size, level);
+    const int rows = (ls.height() + m_TileSize - 1) / m_TileSize;
+    if (qint64(ls.width()) * ls.height() * 4 <= m_Budget / 2) {
+        // Nivån ryms, avkoda den i rätt storlek på en gång
+        QImageReader r(sourcePath);
+        if (ls != size) r.setScaledSize(ls);
+        const QImage image = r.read();
+        if (image.isNull()) {
+            qWarning() << "DeepZoom:" << r.errorString() << sourcePath;
+            return false;
+        }
+        for (int row = 0; row < rows; ++row) {
+            if (!writeTileRow(image, 0, row, ls, dir)) return false;
+        }
+        return true;
+    }
+    // Annars en brickrad i taget ur källans remsor
+    StripReader reader(sourcePath);
+    if (!reader.streams() && reader.decodeCost() > m_Budget) {
+        qWarning() << "DeepZoom:" << sourcePath << "cannot be decoded in strips, needs"
+                   << reader.decodeCost() / (1024 * 1024) << "MB";
+    }
+    const double f = double(size.width()) / ls.width();
+    for (int row = 0; row < rows; ++row) {
+        const QRect r = tileRect(0, row, ls);
+        const int sy0 = qFloor(r.top() * f);
+        const int sy1 = qMin(size.height(), qCeil((r.bottom() + 1) * f));
+        QImage band = reader.read(QRect(0, sy0, size.width(), sy1 - sy0));
+        if (band.isNull()) return false;
+        if (f != 1) band = band.scaled(ls.width(), r.height(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        if (!writeTileRow(band, r.top(), row, ls, dir)) return false;
+    }
+    return true;
+}
+
+bool DeepZoom::exportPyramid(const QString& sourcePath, const QString& basePath) const
+{
+    const QSize size = QImageReader(sourcePath).size();
+    if (size.isEmpty()) {
+        qWarning() << "DeepZoom: cannot read" << sourcePath;
+        return false;
+    }
+    const QString filesPath = basePath + "_files";
+    QDir(filesPath).removeRecursively();
+    const int levels = maxLevel(size);
+    for (int level = levels; level >= 0; --level) {
+        const QString dir = filesPath + "/" + QString::number(level);
+        QDir().mkpath(dir);
+        if (!exportLevel(sourcePath, size, level, dir)) return false;
+    }
+    QFile dzi(basePath + ".dzi");
+    if (!dzi.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "DeepZoom: cannot write" << dzi.fileName();
+        return false;
+    }
+    QTextStream out(&dzi);
+    out << QString(R"(<?xml version="1.0" encoding="UTF-8"?>
+<Image xmlns="http://schemas.microsoft.com/deepzoom/2008" Format="jpg" Overlap="%1" TileSize="%2">
+  <Size Width="%3" Height="%4"/>
+</Image>
+)").arg(m_Overlap).arg(m_TileSize).arg(size.width()).arg(size.height());
+    return true;
+}
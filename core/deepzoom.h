@@ -0,0 +1,32 @@
+#ifndef DEEPZOOM_H
+#define DEEPZOOM_H
+
+#include <QImage>
+#include <QString>
+#include <QSize>
+
+// Djupzoom-pyramid i DZI-format. Nivå maxLevel är originalet, varje nivå under
+// är hälften så stor ner till 1x1. Brickorna skrivs som
+// <bas>_files/<nivå>/<kolumn>_<rad>.jpg med overlap pixlar mot grannarna.
+
+class DeepZoom
+{
+public:
+    DeepZoom(qint64 budget, int tileSize = 256, int overlap = 1, int quality = 80)
+        : m_Budget(budget), m_TileSize(tileSize), m_Overlap(overlap), m_Quality(quality) {}
+    // Skriver basePath.dzi och basePath_files/ från sourcePath
+    bool exportPyramid(const QString& sourcePath, const QString& basePath) const;
+    static int maxLevel(const QSize& size);
+    static QSize levelSize(const QSize& size, int level);
+private:
+    bool exportLevel(const QString& sourcePath, const QSize& size, int level, const QString& dir) const;
+    // image täcker nivåns rader från top, skriver alla brickor i raden row parallellt
+    bool writeTileRow(const QImage& image, int top, int row, const QSize& levelSize, const QString& dir) const;
+    QRect tileRect(int column, int row, const QSize& levelSize) const;
+    qint64 m_Budget;
+    int m_TileSize;
+    int m_Overlap;
+    int m_Quality;
+};
+
+#endif // DEEPZOOM_H
@@ -0,0 +1,176 @@
+#include "epochstack.h"
+#include "imagepair.h"
+#include "imageencoder.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QDebug>
+
+const QStringList& EpochStack::epochKeys()
+{
+    static const QStringList keys = [] {
+        QStringList k = { "AfterPix", "HTranslate", "VTranslate", "HShear", "VShear", "HScale", "VScale",
+                          "Rotate", "XRotate", "YRotate", "HPerspective", "VPerspective",
+                          "AfterK1", "AfterK2", "AfterP1", "AfterP2", "ToneMatch",
+                          "AlignConfidence", "NeedsReview", "Registered", "Label" };
+        for (int i = 1; i <= 6; i++) k << QString("AnchorBefore%1").arg(i) << QString("AnchorAfter%1").arg(i);
+        return k;
+    }();
+    return keys;
+}
+
+QVariantMap EpochStack::extract(const QMap<QString,QVariant>& project)
+{
+    QVariantMap e;
+    for (const QString& k : epochKeys()) {
+        if (project.contains(k)) e.insert(k, project.value(k));
+    }
+    return e;
+}
+
+QVariantList EpochStack::epochs(const QMap<QString,QVariant>& project)
+{
+    if (project.contains("Epochs")) return project.value("Epochs").toList();
+    // Äldre projekt: bara efterbilden
+    QVariantList list;
+    if (!project.value("AfterPix").toString().isEmpty()) list.append(extract(project));
+    return list;
+}
+
+int EpochStack::count(const QMap<QString,QVariant>& project)
+{
+    return 1 + int(epochs(project).size());
+}
+
+QString EpochStack::path(const QMap<QString,QVariant>& project, int epoch)
+{
+    if (epoch == 0) return project.value("BeforePix").toString();
+    return pair(project, epoch).value("AfterPix").toString();
+}
+
+QString EpochStack::label(const QMap<QString,QVariant>& project, int epoch)
+{
+    const QString l = epoch == 0 ? project.value("BeforeLabel").toString() : pair(project, epoch).value("Label").toString();
+    if (!l.isEmpty()) return l;
+    return QFileInfo(path(project, epoch)).lastModified().toString("yyyy-MM-dd");
+}
+
+void EpochStack::store(QMap<QString,QVariant>& project)
+{
+    QVariantList list = epochs(project);
+    const int e = current(project);
+    if (e - 1 < list.size()) list[e - 1] = extract(project);
+    project.insert("Epochs", list);
+}
+
+void EpochStack::apply(QMap<QString,QVariant>& project, int epoch)
+{
+    const QVariantList list = project.value("Epochs").toList();
+    if (epoch < 1 || epoch > list.size()) return;
+    for (const QString& k : epochKeys()) project.remove(k);
+    const QVariantMap e = list[epoch - 1].toMap();
+    for (auto it = e.constBegin(); it != e.constEnd(); ++it) project.insert(it.key(), it.value());
+    project.insert("Epoch", epoch);
+}
+
+void EpochStack::select(QMap<QString,QVariant>& project, int epoch)
+{
+    store(project);
+    apply(project, epoch);
+}
+
+int EpochStack::add(QMap<QString,QVariant>& project, const QString& path)
+{
+    store(project);
+    QVariantList list = project.value("Epochs").toList();
+    QVariantMap e;
+    e.insert("AfterPix", path);
+    e.insert("HScale", 1);
+    e.insert("VScale", 1);
+    e.insert("ToneMatch", project.value("ToneMatch"));
+    list.append(e);
+    project.insert("Epochs", list);
+    return int(list.size());
+}
+
+void EpochStack::remove(QMap<QString,QVariant>& project, int epoch)
+{
+    store(project);
+    QVariantList list = project.value("Epochs").toList();
+    if (list.size() < 2 || epoch < 1 || epoch > list.size()) return;
+    const int e = current(project);
+    list.removeAt(epoch - 1);
+    project.insert("Epochs", list);
+    // Togs den aktiva bort blir epoken före aktiv
+    if (e == epoch) apply(project, qMax(1, epoch - 1));
+    else if (e > epoch) project.insert("Epoch", e - 1);
+}
+
+QMap<QString,QVariant> EpochStack::pair(const QMap<QString,QVariant>& project, int epoch)
+{
+    if (epoch == current(project)) return project;
+    QMap<QString,QVariant> p = project;
+    const QVariantList list = epochs(project);
+    for (const QString& k : epochKeys()) p.remove(k);
+    if (epoch < 1 || epoch > list.size()) return p;
+    const QVariantMap e = list[epoch - 1].toMap();
+    for (auto it = e.constBegin(); it != e.constEnd(); ++it) p.insert(it.key(), it.value());
+    p.insert("Epoch", epoch);
+    return p;
+}
+
+void EpochStack::setPair(QMap<QString,QVariant>& project, int epoch, const QMap<QString,QVariant>& pair)
+{
+    if (epoch == current(project)) {
+        for (const QString& k : epochKeys()) {
+            if (pair.contains(k)) project.insert(k, pair.value(k));
+        }
+        return;
+    }
+    store(project);
+    QVariantList list = project.value("Epochs").toList();
+    if (epoch < 1 || epoch > list.size()) return;
+    list[epoch - 1] = extract(pair);
+    project.insert("Epochs", list);
+}
+
+QString EpochStack::registrationStamp(const QMap<QString,QVariant>& pair)
+{
+    QString stamp;
+    for (const char* pix : { "BeforePix", "AfterPix" }) {
+        const QString path = pair.value(pix).toString();
+        stamp += path + "|" + QString::number(QFileInfo(path).lastModified().toMSecsSinceEpoch()) + "|";
+    }
+    return stamp;
+}
+
+bool EpochStack::isRegistered(const QMap<QString,QVariant>& project, int epoch)
+{
+    const QMap<QString,QVariant> p = pair(project, epoch);
+    return p.value("Registered").toString() == registrationStamp(p);
+}
+
+QString EpochStack::fileName(const QMap<QString,QVariant>& project, int epoch, const QString& suffix)
+{
+    if (epoch == 0) return "before." + suffix;
+    if (epoch == current(project)) return "after." + suffix;
+    return QString("epoch%1.%2").arg(epoch).arg(suffix);
+}
+
+bool EpochStack::exportEpochs(const QMap<QString,QVariant>& project, const QString& dirPath,
+                              const ExportOptions& options, const QRect& rect)
+{
+    const QDir dir(dirPath);
+    const int n = count(project);
+    for (int e = 1; e < n; e++) {
+        if (e == current(project)) continue;
+        // En epok i taget, bara referensen och den här epoken är avkodade
+        ImagePair pair(EpochStack::pair(project, e));
+        if (!pair.load(options.memoryBudget() / 4)) return false;
+        const QString path = dir.filePath(fileName(project, e, options.imageSuffix()));
+        const QSize canvas = rect.isEmpty() ? pair.beforeSize() : rect.size();
+        const int quality = ImageEncoder(options).streamQuality(path, pair.afterProxy(), qint64(canvas.width()) * canvas.height());
+        if (!pair.exportAfter(path, options.memoryBudget(), pair.afterLut(), rect, quality)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef EPOCHSTACK_H
+#define EPOCHSTACK_H
+
+#include <QMap>
+#include <QVariant>
+#include <QRect>
+#include "exportoptions.h"
+
+// Ett projekt som en ordnad stapel av daterade bilder (epoker). Epok 0 är
+// förebilden (BeforePix) och referensen som alla andra registreras mot. Den
+// aktiva epoken ligger som efterbild direkt i projektposten (AfterPix,
+// transformen, linsen, ankarna ...), de övriga i listan "Epochs" med samma
+// nycklar. Projekt utan lista är en stapel med två epoker.
+
+class EpochStack
+{
+public:
+    // Nycklarna som hör till en epok och inte till projektet
+    static const QStringList& epochKeys();
+    // Antal epoker inklusive referensen
+    static int count(const QMap<QString,QVariant>& project);
+    static int current(const QMap<QString,QVariant>& project) { return qMax(1, project.value("Epoch", 1).toInt()); }
+    static QString path(const QMap<QString,QVariant>& project, int epoch);
+    static QString label(const QMap<QString,QVariant>& project, int epoch);
+
+    // Lägger den aktiva epokens värden tillbaka i listan
+    static void store(QMap<QString,QVariant>& project);
+    // Gör epoch (1..count-1) till efterbild
+    static void select(QMap<QString,QVariant>& project, int epoch);
+    // Ny epok sist i stapeln, ej registrerad. Returnerar dess index.
+    static int add(QMap<QString,QVariant>& project, const QString& path);
+    static void remove(QMap<QString,QVariant>& project, int epoch);
+
+    // Kopia av projektet med epoch som efterbild, för jobb utanför fönstret
+    static QMap<QString,QVariant> pair(const QMap<QString,QVariant>& project, int epoch);
+    // Skriver tillbaka epokens nycklar från en sådan kopia
+    static void setPair(QMap<QString,QVariant>& project, int epoch, const QMap<QString,QVariant>& pair);
+
+    // Registreringen gäller så länge varken referensen eller epokens bild har ändrats
+    static QString registrationStamp(const QMap<QString,QVariant>& pair);
+    static bool isRegistered(const QMap<QString,QVariant>& project, int epoch);
+
+    // Filnamnet epoken exporteras till: before.jpg, after.jpg för den aktiva, annars epochN.jpg
+    static QString fileName(const QMap<QString,QVariant>& project, int epoch, const QString& suffix = "jpg");
+    // Exporterar alla epoker utom referensen och den aktiva, registrerade mot referensen
+    static bool exportEpochs(const QMap<QString,QVariant>& project, const QString& dirPath,
+                             const ExportOptions& options, const QRect& rect = QRect());
+private:
+    static QVariantList epochs(const QMap<QString,QVariant>& project);
+    static QVariantMap extract(const QMap<QString,QVariant>& project);
+    static void apply(QMap<QString,QVariant>& project, int epoch);
+};
+
+#endif // EPOCHSTACK_H
@@ -0,0 +1,66 @@
+#ifndef EXPORTOPTIONS_H
+#define EXPORTOPTIONS_H
+
+#include <QSettings>
+
+struct ExportOptions
+{
+    enum ImageFormat { Jpeg, ProgressiveJpeg, Png, WebP };
+    // Övre gräns för minnet vid export. Bilder som inte ryms exporteras bandvis.
+    int memoryBudgetMB = 256;
+    // Beskär båda bilderna till den största rektangeln där de överlappar
+    bool autoCrop = false;
+    // Bildformat och kvalitet. Med målstorlek (kB) söks den högsta kvalitet som ryms.
+    int imageFormat = Jpeg;
+    int quality = 85;
+    int targetKB = 0;
+    // Djupzoom-pyramid (DZI) per bild i webbgalleriet
+    bool deepZoom = false;
+    int tileSize = 256;
+    // Svepanimation (MJPEG i AVI) per projekt
+    bool wipeAnimation = false;
+    int animationFrames = 60;
+    int animationWidth = 1280;
+    // Galleriet som ett enda arkiv (.zip eller .tar) i stället för en mapp
+    bool bundle = false;
+    // För statisk webbhotell: bildfilerna får innehållsnamn, HTML och JSON skrivs
+    // även förkomprimerade och assets.json listar namnen
+    bool hashedAssets = false;
+
+    void load(QSettings& s) {
+        s.beginGroup("Export");
+        memoryBudgetMB = s.value("MemoryBudgetMB", memoryBudgetMB).toInt();
+        autoCrop = s.value("AutoCrop", autoCrop).toBool();
+        imageFormat = s.value("ImageFormat", imageFormat).toInt();
+        quality = s.value("Quality", quality).toInt();
+        targetKB = s.value("TargetKB", targetKB).toInt();
+        deepZoom = s.value("DeepZoom", deepZoom).toBool();
+        tileSize = s.value("TileSize", tileSize).toInt();
+        wipeAnimation = s.value("WipeAnimation", wipeAnimation).toBool();
+        animationFrames = s.value("AnimationFrames", animationFrames).toInt();
+        animationWidth = s.value("AnimationWidth", animationWidth).toInt();
+        bundle = s.value("Bundle", bundle).toBool();
+        hashedAssets = s.value("HashedAssets", hashedAssets).toBool();
+        s.endGroup();
+    }
+    void save(QSettings& s) const {
+        s.beginGroup("Export");
+        s.setValue("MemoryBudgetMB", memoryBudgetMB);
+        s.setValue("AutoCrop", autoCrop);
+        s.setValue("ImageFormat", imageFormat);
+        s.setValue("Quality", quality);
+        s.setValue("TargetKB", targetKB);
+        s.setValue("DeepZoom", deepZoom);
+        s.setValue("TileSize", tileSize);
+        s.setValue("WipeAnimation", wipeAnimation);
+        s.setValue("AnimationFrames", animationFrames);
+        s.setValue("AnimationWidth", animationWidth);
+        s.setValue("Bundle", bundle);
+        s.setValue("HashedAssets", hashedAssets);
+        s.endGroup();
+    }
+    qint64 memoryBudget() const { return qint64(memoryBudgetMB) * 1024 * 1024; }
+    QString imageSuffix() const { return imageFormat == Png ? "png" : imageFormat == WebP ? "webp" : "jpg"; }
+};
+
+#endif // EXPORTOPTIONS_H
@@ -0,0 +1,43 @@
+#include "gallerybundle.h"
+#include <QDir>
+#include <QDebug>
+
+GalleryBundle::GalleryBundle(QIODevice* device, ArchiveWriter::Format format, const ExportOptions& options)
+    : m_Gallery(options), m_Archive(device, format)
+{
+    if (!m_Staging.isValid()) qWarning() << "GalleryBundle:" << m_Staging.errorString();
+}
+
+QString GalleryBundle::stagingDir(const QString& name) const
+{
+    const QString dir = m_Staging.filePath(name);
+    QDir(dir).removeRecursively();
+    QDir().mkpath(dir);
+    return dir;
+}
+
+bool GalleryBundle::addProject(const QString& name, const QMap<QString,QVariant>& project)
+{
+    const QString dir = m_Staging.filePath(name);
+    // Pyramiderna byggs utanför låset, bara arkivet skrivs en tråd i taget
+    const bool pair = m_Gallery.hasPair(dir);
+    const QMap<QString,QString> assets = m_Gallery.writeDerivatives(dir);
+    const QJsonObject entry = pair ? m_Gallery.pairEntry(dir, project, assets) : QJsonObject();
+    QMutexLocker locker(&m_Mutex);
+    if (pair) m_Pairs.insert(name, entry);
+    for (auto it = assets.cbegin(); it != assets.cend(); ++it) m_Assets.insert(name + "/" + it.key(), name + "/" + it.value());
+    const bool ok = m_Archive.addDirectory(name, dir);
+    QDir(dir).removeRecursively();
+    return ok;
+}
+
+bool GalleryBundle::finish(const QString& title)
+{
+    QMutexLocker locker(&m_Mutex);
+    QJsonArray pairs;
+    for (const QJsonObject& o : std::as_const(m_Pairs)) pairs.append(o);
+    for (const QPair<QString,QByteArray>& f : m_Gallery.siteFiles(title, pairs, m_Assets)) {
+        if (!m_Archive.addData(f.first, f.second)) return false;
+    }
+    return m_Archive.finish();
+}
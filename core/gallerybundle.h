@@ -0,0 +1,34 @@
+#ifndef GALLERYBUNDLE_H
+#define GALLERYBUNDLE_H
+
+#include <QMutex>
+#include <QTemporaryDir>
+#include "archivewriter.h"
+#include "gallerywriter.h"
+
+// Webbgalleriet som ett enda arkiv. Varje projekt exporteras till en egen
+// arbetsmapp, läggs i arkivet och tas bort direkt, så att bara de projekt som
+// pågår ligger på disk. gallery.json, index.html och ev. assets.json skrivs sist
+// ur minnet.
+// addProject kan anropas från flera trådar.
+
+class GalleryBundle
+{
+public:
+    GalleryBundle(QIODevice* device, ArchiveWriter::Format format, const ExportOptions& options);
+    bool isValid() const { return m_Staging.isValid(); }
+    // Tom mapp som projektet name exporteras till
+    QString stagingDir(const QString& name) const;
+    // Arkiverar och tar bort projektets arbetsmapp
+    bool addProject(const QString& name, const QMap<QString,QVariant>& project);
+    bool finish(const QString& title);
+private:
+    GalleryWriter m_Gallery;
+    ArchiveWriter m_Archive;
+    QTemporaryDir m_Staging;
+    QMutex m_Mutex;
+    QMap<QString,QJsonObject> m_Pairs; // efter namn, som mapparna i en vanlig export
+    QMap<QString,QString> m_Assets;   // projekt/fil -> projekt/innehållsnamn
+};
+
+#endif // GALLERYBUNDLE_H
@@ -0,0 +1,636 @@
+#include "gallerywriter.h"
+#include "deepzoom.h"
+#include "epochstack.h"
+#include "imagepair.h"
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QCryptographicHash>
+#include <QRegularExpression>
+#include <QSet>
+#include <QDebug>
+#include <cstring>
+#ifdef QT_BUNDLED_ZLIB
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+// Hex-tecken av SHA-256 i innehållsnamnen
+static const int hashLength = 10;
+
+static QString shortHash(QCryptographicHash& h)
+{
+    return QString::fromLatin1(h.result().toHex().left(hashLength));
+}
+
+// Filnamnet utan hash för ett innehållsnamn (before.0123456789.jpg -> before.jpg), annars tomt
+static QString plainName(const QString& file)
+{
+    static const QRegularExpression hashed(QString("^(.+)\\.[0-9a-f]{%1}(\\.[^.]+)$").arg(hashLength));
+    const QRegularExpressionMatch m = hashed.match(file);
+    return m.hasMatch() ? m.captured(1) + m.captured(2) : QString();
+}
+
+bool GalleryWriter::isContentNamed(const QString& path)
+{
+    static const QRegularExpression named(QString("\\.[0-9a-f]{%1}(\\.[^./]+$|_files/)").arg(hashLength));
+    return named.match(path).hasMatch();
+}
+
+// name eller en innehållsnamngiven version av den
+static bool hasAsset(const QDir& dir, const QString& name)
+{
+    if (dir.exists(name)) return true;
+    const QFileInfo info(name);
+    for (const QString& f : (const QStringList)dir.entryList({ info.completeBaseName() + ".*." + info.suffix() }, QDir::Files)) {
+        if (plainName(f) == name) return true;
+    }
+    return false;
+}
+
+// Döper om name i dir till sitt innehållsnamn och tar bort äldre versioner av
+// samma fil. Är name redan omdöpt (galleriet skrivs om utan ny export) gäller det.
+static QString hashFile(QDir& dir, const QString& name)
+{
+    QStringList versions;
+    for (const QString& f : (const QStringList)dir.entryList(QDir::Files)) {
+        if (plainName(f) == name) versions << f;
+    }
+    if (!dir.exists(name)) return versions.size() == 1 ? versions.first() : QString();
+    QFile file(dir.filePath(name));
+    QCryptographicHash h(QCryptographicHash::Sha256);
+    if (!file.open(QIODevice::ReadOnly) || !h.addData(&file)) {
+        qWarning() << "GalleryWriter: cannot hash" << file.fileName();
+        return QString();
+    }
+    file.close();
+    const QFileInfo info(name);
+    const QString hashed = info.completeBaseName() + "." + shortHash(h) + "." + info.suffix();
+    for (const QString& f : std::as_const(versions)) {
+        if (f != hashed) dir.remove(f);
+    }
+    if (dir.exists(hashed)) dir.remove(name);
+    else if (!dir.rename(name, hashed)) return QString();
+    return hashed;
+}
+
+// Högsta nivån, filerna komprimeras en gång men skickas många gånger
+static QByteArray gzip(const QByteArray& data)
+{
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return QByteArray();
+    QByteArray out(int(deflateBound(&z, uLong(data.size()))) + 32, 0);
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    z.avail_in = uInt(data.size());
+    z.next_out = reinterpret_cast<Bytef*>(out.data());
+    z.avail_out = uInt(out.size());
+    const bool ok = deflate(&z, Z_FINISH) == Z_STREAM_END;
+    out.resize(int(z.total_out));
+    deflateEnd(&z);
+    return ok ? out : QByteArray();
+}
+
+// Tom utan brotli-biblioteket, då skrivs bara .gz
+static QByteArray brotli(const QByteArray& data)
+{
+#ifdef HAVE_BROTLI
+    QByteArray out(int(BrotliEncoderMaxCompressedSize(size_t(data.size()))), 0);
+    size_t size = size_t(out.size());
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, size_t(data.size()),
+                               reinterpret_cast<const uint8_t*>(data.constData()), &size, reinterpret_cast<uint8_t*>(out.data()))) {
+        return QByteArray();
+    }
+    out.resize(int(size));
+    return out;
+#else
+    Q_UNUSED(data)
+    return QByteArray();
+#endif
+}
+
+bool GalleryWriter::hasPair(const QString& projectDir) const
+{
+    const QDir subdir(projectDir);
+    return hasAsset(subdir, "before." + m_Options.imageSuffix()) && hasAsset(subdir, "after." + m_Options.imageSuffix());
+}
+
+QMap<QString,QString> GalleryWriter::writeDerivatives(const QString& projectDir) const
+{
+    QMap<QString,QString> assets;
+    QDir subdir(projectDir);
+    const QString suffix = m_Options.imageSuffix();
+    if (m_Options.hashedAssets) {
+        QSet<QString> names;
+        for (const QString& f : (const QStringList)subdir.entryList({ "*." + suffix }, QDir::Files)) {
+            const QString plain = plainName(f);
+            names.insert(plain.isEmpty() ? f : plain);
+        }
+        for (const QString& name : std::as_const(names)) {
+            const QString hashed = hashFile(subdir, name);
+            if (!hashed.isEmpty()) assets.insert(name, hashed);
+        }
+    }
+    // Djupzoom: en brickpyramid per bild, viewern hämtar bara synliga brickor
+    if (!m_Options.deepZoom) return assets;
+    const DeepZoom dz(m_Options.memoryBudget(), m_Options.tileSize);
+    for (const char* side : { "before", "after" }) {
+        const QString image = assets.value(side + QString(".") + suffix, side + QString(".") + suffix);
+        if (!m_Options.hashedAssets) {
+            dz.exportPyramid(subdir.filePath(image), subdir.filePath(side));
+            continue;
+        }
+        // Pyramiden bestäms av bilden och brickstorleken. Finns den redan från
+        // ett tidigare bygge behöver den inte göras om.
+        QCryptographicHash h(QCryptographicHash::Sha256);
+        h.addData((image + "/" + QString::number(m_Options.tileSize)).toUtf8());
+        const QString base = side + QString(".") + shortHash(h);
+        const QRegularExpression stale(QString("^%1\\.[0-9a-f]{%2}(\\.dzi|_files)$").arg(QString(side)).arg(hashLength));
+        for (const QString& f : (const QStringList)subdir.entryList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot)) {
+            if (!stale.match(f).hasMatch() || f.startsWith(base)) continue;
+            if (QFileInfo(subdir.filePath(f)).isDir()) QDir(subdir.filePath(f)).removeRecursively();
+            else subdir.remove(f);
+        }
+        if (!subdir.exists(base + ".dzi")) dz.exportPyramid(subdir.filePath(image), subdir.filePath(base));
+        assets.insert(side + QString(".dzi"), base + ".dzi");
+    }
+    return assets;
+}
+
+QJsonObject GalleryWriter::pairEntry(const QString& projectDir, const QMap<QString,QVariant>& project,
+                                     const QMap<QString,QString>& assets) const
+{
+    const QDir subdir(projectDir);
+    auto asset = [&assets](const QString& name) { return assets.value(name, name); };
+    const QString before = asset("before." + m_Options.imageSuffix());
+    const QString after = asset("after." + m_Options.imageSuffix());
+    const QSize size = QImageReader(subdir.filePath(before)).size();
+    QJsonObject o;
+    o["name"] = subdir.dirName();
+    o["before"] = before;
+    o["after"] = after;
+    o["width"] = size.width();
+    o["height"] = size.height();
+    o["aspect"] = size.isEmpty() ? 0.5625 : qRound(10000.0 * size.height() / size.width()) / 10000.0;
+    o["split"] = qRound(project.value("Transparancy", 0.5).toDouble() * 100);
+    // Flera epoker: bildfilerna i tidsordning, sidan visar två intilliggande åt gången
+    const int epochs = EpochStack::count(project);
+    if (epochs > 2) {
+        QJsonArray files;
+        for (int e = 0; e < epochs; e++) {
+            const QString file = asset(EpochStack::fileName(project, e, m_Options.imageSuffix()));
+            if (!subdir.exists(file)) continue;
+            QJsonObject f;
+            f["file"] = file;
+            f["label"] = EpochStack::label(project, e);
+            files.append(f);
+        }
+        if (files.size() > 2) o["epochs"] = files;
+    }
+    if (m_Options.deepZoom && subdir.exists(asset("after.dzi"))) {
+        QJsonObject dz;
+        dz["tile"] = m_Options.tileSize;
+        dz["overlap"] = 1;
+        dz["levels"] = DeepZoom::maxLevel(size);
+        // Pyramidernas namn, brickorna ligger under <namn>_files
+        dz["before"] = QFileInfo(asset("before.dzi")).completeBaseName();
+        dz["after"] = QFileInfo(asset("after.dzi")).completeBaseName();
+        o["dz"] = dz;
+    }
+    // Maskläget visar den sammansatta bilden. Den gäller bara paret före/efter,
+    // så med djupzoom, epoker eller utan composite-fil visas genomskinlighet.
+    const QString composite = asset("composite." + m_Options.imageSuffix());
+    const bool masked = !o.contains("dz") && !o.contains("epochs") && subdir.exists(composite);
+    if (masked) o["composite"] = composite;
+    switch (project.value("ViewMode").toInt()) {
+    case SplitView: o["mode"] = "vertical"; break;
+    case HSplitView: o["mode"] = "horizontal"; break;
+    case MaskView: o["mode"] = masked ? "mask" : "transparent"; break;
+    default: o["mode"] = "transparent"; break;
+    }
+    return o;
+}
+
+QByteArray GalleryWriter::manifest(const QString& title, const QJsonArray& pairs)
+{
+    QJsonObject manifest;
+    manifest["title"] = title;
+    manifest["pairs"] = pairs;
+    return QJsonDocument(manifest).toJson(QJsonDocument::Compact);
+}
+
+QList<QPair<QString,QByteArray>> GalleryWriter::siteFiles(const QString& title, const QJsonArray& pairs,
+                                                          const QMap<QString,QString>& assets) const
+{
+    QList<QPair<QString,QByteArray>> files;
+    files.append({ "gallery.json", manifest(title, pairs) });
+    files.append({ "index.html", indexHtml(title) });
+    if (!m_Options.hashedAssets) return files;
+    QJsonObject map;
+    for (auto it = assets.cbegin(); it != assets.cend(); ++it) map[it.key()] = it.value();
+    files.append({ "assets.json", QJsonDocument(map).toJson(QJsonDocument::Indented) });
+    // Webbhotellet väljer kopia efter Accept-Encoding, utan att komprimera själv
+    for (int i = 0, n = files.size(); i < n; i++) {
+        const QByteArray data = files[i].second;
+        files.append({ files[i].first + ".gz", gzip(data) });
+        const QByteArray br = brotli(data);
+        if (!br.isEmpty()) files.append({ files[i].first + ".br", br });
+    }
+    return files;
+}
+
+bool GalleryWriter::write(const QString& baseDirPath, const QString& title, const QList<QMap<QString,QVariant>>& projects) const
+{
+    QDir baseDir(baseDirPath);
+    QStringList caseDirs;
+
+    // Hitta undermappar med before + after i exportens format
+    for (const QString& entry : (const QStringList)baseDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (hasPair(baseDir.filePath(entry))) caseDirs << entry;
+    }
+    // Manifest: en kompakt post per par, sidan bygger bara de par som syns
+    QJsonArray pairs;
+    QMap<QString,QString> assets;
+    for (const QString& folder : caseDirs) {
+        const QMap<QString,QString> names = writeDerivatives(baseDir.filePath(folder));
+        for (auto it = names.cbegin(); it != names.cend(); ++it) assets.insert(folder + "/" + it.key(), folder + "/" + it.value());
+        QMap<QString,QVariant> project;
+        for (const QMap<QString,QVariant>& p : projects) {
+            if (p.value("ProjectName").toString() == folder) project = p;
+        }
+        pairs.append(pairEntry(baseDir.filePath(folder), project, names));
+    }
+
+    // gallery.json, index.html och ev. assets.json med förkomprimerade kopior
+    for (const QPair<QString,QByteArray>& f : siteFiles(title, pairs, assets)) {
+        QFile file(baseDir.filePath(f.first));
+        if (!file.open(QIODevice::WriteOnly) || file.write(f.second) != f.second.size()) {
+            qWarning() << "Kunde inte skapa" << f.first;
+            return false;
+        }
+    }
+    qDebug() << "HTML-sida genererad till" << baseDir.filePath("index.html");
+    return true;
+}
+
+QByteArray GalleryWriter::indexHtml(const QString& title)
+{
+    QByteArray html;
+    QTextStream out(&html);
+    out << R"(<!DOCTYPE html>
+<html lang="en">
+<head>
+  <meta charset="UTF-8" />
+  <title>)";
+    out << title;
+out << R"(</title>
+  <style>
+    body { margin: 0; font-family: sans-serif; background: #111; color: white; }
+    .pair-container { margin: 2em auto; width: 90vw; max-width: 1200px; }
+    .label { margin-bottom: 0.5em; font-size: 1.2em; }
+
+    .img-container {
+      position: relative;
+      width: 100%;
+      overflow: hidden;
+      background: #222;
+    }
+    .img-container::before {
+      content: "";
+      display: block;
+      padding-top: calc(var(--aspect, 0.5625) * 100%); /* från manifestet */
+    }
+    .img-before, .img-after {
+      position: absolute; top: 0; left: 0;
+      width: 100%; height: 100%; object-fit: contain;
+    }
+    .img-before {
+      position: absolute;
+      top: 0; left: 0;
+      width: 100%; height: 100%;
+      object-fit: contain;
+      pointer-events: none;
+      z-index: 2;
+      transition: clip-path 0.2s, opacity 0.2s;
+    }
+    .img-after {
+      z-index: 1;
+    }
+    .time-label { display: block; text-align: center; }
+    .dz { cursor: grab; touch-action: none; }
+    .dz-layer { overflow: hidden; }
+    .dz-layer img { position: absolute; max-width: none; }
+    select {
+      /* ... */
+      background-color: #000;
+      color: #fff;
+    }
+
+    select::before {
+      /* ... */
+      border-bottom: var(--size) solid #fff;
+    }
+
+    select::after {
+      /* ... */
+      border-top: var(--size) solid #fff;
+    }
+
+    #pager { text-align: center; margin: 2em; }
+    #pager button { background: #000; color: #fff; margin: 0 1em; }
+    input[type=range] {
+      width: 100%;
+      margin-top: 0.5em;
+    }
+  </style>
+</head>
+<body>
+<h1 style="text-align: center;">)";
+    out << title;
+    out << R"(</h1>
+<div id="gallery"></div>
+<div id="pager"></div>
+<script>
+const pageSize = 50;
+const gallery = document.getElementById('gallery');
+const pager = document.getElementById('pager');
+let pairs = [];
+
+function updateView(el) {
+  const before = el.querySelector('.img-before');
+  if (!before) return;
+  const val = el.querySelector('input.split').value;
+  const m = el.querySelector('select').value;
+
+  // Reset style
+  before.style.mixBlendMode = '';
+  before.style.opacity = '';
+  before.style.clipPath = '';
+  before.style.transform = '';
+
+  if (m === 'vertical') {
+    before.style.clipPath = `inset(0 ${100 - val}% 0 0)`;
+  } else if (m === 'horizontal') {
+    before.style.clipPath = `inset(0 0 ${100 - val}% 0)`;
+  } else if (m === 'diagonal') {
+    const pct = val / 50;
+    const x = pct * 100;
+    const y = pct * 100;
+    before.style.clipPath = `polygon(0 100%, 0 ${y}%, ${x}% 0, 100% 0, 100% 100%)`;
+  } else if (m === 'transparent') {
+    before.style.mixBlendMode = 'normal'; // or 'multiply', 'overlay', etc.
+    before.style.opacity = (val / 100).toString();
+  } else if (m === 'mask') {
+    // Sammansatt genom projektets mask, reglaget tonar in den över efterbilden
+    before.style.opacity = (val / 100).toString();
+  }
+  // Maskläget byter förebilden mot den sammansatta bilden
+  if (el.pair.composite) {
+    const src = `${encodeURIComponent(el.pair.name)}/${m === 'mask' ? el.pair.composite : el.pair.before}`;
+    if (before.getAttribute('src') !== src) before.setAttribute('src', src);
+  }
+}
+
+// Platshållaren har redan rätt höjd via --aspect, bilderna läggs in först när den syns
+function pairElement(pair) {
+  const el = document.createElement('div');
+  el.className = 'pair-container';
+  el.innerHTML = `<div class="label"></div>
+    <div class="img-container" style="--aspect: ${pair.aspect}"></div>
+    <input type="range" class="split" min="0" max="100" value="${pair.split}">
+    <select>
+      <option value="vertical">Vertical Split</option>
+      <option value="horizontal">Horizontal Split</option>
+      <option value="diagonal">Diagonal Split</option>
+      <option value="transparent">Transparency</option>
+    </select>`;
+  if (pair.composite) el.querySelector('select').add(new Option('Mask', 'mask'));
+  el.querySelector('.label').textContent = pair.name;
+  el.querySelector('select').value = pair.mode;
+  // Tidsreglage för projekt med fler än två epoker (djupzoom har bara före/efter)
+  if (pair.epochs && !pair.dz) {
+    const time = document.createElement('input');
+    Object.assign(time, { type: 'range', className: 'time', min: 0, max: pair.epochs.length - 2, value: 0 });
+    const label = document.createElement('span');
+    label.className = 'time-label';
+    el.append(time, label);
+    time.addEventListener('input', () => showEpochs(el));
+  }
+  el.querySelector('input.split').addEventListener('input', () => updateView(el));
+  el.querySelector('select').addEventListener('change', () => updateView(el));
+  el.pair = pair;
+  return el;
+}
+
+// Bara de två epoker som syns har en bildkälla, de andra avkodas inte
+function showEpochs(el) {
+  const pair = el.pair;
+  const time = el.querySelector('input.time');
+  if (!time) return;
+  const i = +time.value;
+  el.querySelector('.time-label').textContent = `${pair.epochs[i].label} – ${pair.epochs[i + 1].label}`;
+  const before = el.querySelector('img.img-before');
+  const after = el.querySelector('img.img-after');
+  if (!before || !after) return;
+  const dir = encodeURIComponent(pair.name);
+  before.src = `${dir}/${pair.epochs[i].file}`;
+  after.src = `${dir}/${pair.epochs[i + 1].file}`;
+}
+
+function mount(el) {
+  if (el.cleanup) return;
+  const pair = el.pair;
+  const container = el.querySelector('.img-container');
+  const dir = encodeURIComponent(pair.name);
+  if (pair.dz) {
+    container.classList.add('dz');
+    Object.assign(container.dataset, { width: pair.width, height: pair.height,
+                                       tile: pair.dz.tile, overlap: pair.dz.overlap, levels: pair.dz.levels });
+    container.innerHTML = `<div class="img-before dz-layer" data-src="${dir}/${pair.dz.before}_files"></div>
+      <div class="img-after dz-layer" data-src="${dir}/${pair.dz.after}_files"></div>`;
+    el.cleanup = deepZoom(container);
+  } else {
+    if (el.querySelector('input.time')) {
+      container.innerHTML = `<img class="img-before"><img class="img-after">`;
+      showEpochs(el);
+    } else {
+      container.innerHTML = `<img src="${dir}/${pair.before}" class="img-before">
+        <img src="${dir}/${pair.after}" class="img-after">`;
+    }
+    el.cleanup = () => {};
+  }
+  updateView(el);
+}
+
+function unmount(el) {
+  if (!el.cleanup) return;
+  el.cleanup();
+  el.cleanup = null;
+  const container = el.querySelector('.img-container');
+  container.classList.remove('dz');
+  container.replaceChildren();
+}
+
+const observer = new IntersectionObserver(entries => {
+  for (const e of entries) {
+    if (e.isIntersecting) mount(e.target); else unmount(e.target);
+  }
+}, { rootMargin: '100% 0px' });
+
+function pageFromHash() {
+  const m = /page=(\d+)/.exec(location.hash);
+  return m ? Number(m[1]) - 1 : 0;
+}
+
+function showPage(page) {
+  const pages = Math.max(1, Math.ceil(pairs.length / pageSize));
+  page = Math.min(Math.max(page, 0), pages - 1);
+  observer.disconnect();
+  for (const el of gallery.children) unmount(el);
+  gallery.replaceChildren(...pairs.slice(page * pageSize, (page + 1) * pageSize).map(pairElement));
+  for (const el of gallery.children) observer.observe(el);
+  pager.replaceChildren();
+  if (pages > 1) {
+    const button = (text, target) => {
+      const b = document.createElement('button');
+      b.textContent = text;
+      b.disabled = target < 0 || target >= pages;
+      b.addEventListener('click', () => { location.hash = `page=${target + 1}`; });
+      return b;
+    };
+    pager.append(button('Previous', page - 1), `Page ${page + 1} / ${pages}`, button('Next', page + 1));
+  }
+  window.scrollTo(0, 0);
+}
+
+window.addEventListener('hashchange', () => showPage(pageFromHash()));
+fetch('gallery.json')
+  .then(r => r.json())
+  .then(manifest => {
+    pairs = manifest.pairs;
+    showPage(pageFromHash());
+  })
+  .catch(e => { gallery.textContent = `Could not load gallery.json: ${e}`; });
+
+// Djupzoom: väljer nivå efter skalan och lägger bara ut brickorna som syns.
+// Gamla brickor ligger kvar under tills de nya har laddats.
+function deepZoom(container) {
+  const W = +container.dataset.width, H = +container.dataset.height;
+  const tile = +container.dataset.tile, overlap = +container.dataset.overlap;
+  const maxLevel = +container.dataset.levels;
+  const layers = Array.from(container.querySelectorAll('.dz-layer')).map(el => ({ el, src: el.dataset.src, tiles: new Map() }));
+  let zoom = 1, cx = W / 2, cy = H / 2;
+
+  const fitScale = () => Math.min(container.clientWidth / W, container.clientHeight / H);
+
+  function clampView() {
+    const maxZoom = Math.max(1, 4 / fitScale());
+    zoom = Math.min(Math.max(zoom, 1), maxZoom);
+    const scale = fitScale() * zoom;
+    const hw = container.clientWidth / 2 / scale, hh = container.clientHeight / 2 / scale;
+    cx = hw * 2 >= W ? W / 2 : Math.min(Math.max(cx, hw), W - hw);
+    cy = hh * 2 >= H ? H / 2 : Math.min(Math.max(cy, hh), H - hh);
+  }
+
+  function prune(layer) {
+    const loaded = [...layer.wanted].every(key => layer.tiles.get(key).complete);
+    for (const [key, img] of layer.tiles) {
+      if (layer.wanted.has(key)) continue;
+      if (loaded || img.level === layer.level) {
+        img.remove();
+        layer.tiles.delete(key);
+      }
+    }
+  }
+
+  function render() {
+    clampView();
+    const cw = container.clientWidth, ch = container.clientHeight;
+    const scale = fitScale() * zoom;
+    const level = Math.max(0, Math.min(maxLevel, maxLevel + Math.ceil(Math.log2(scale))));
+    const f = Math.pow(2, maxLevel - level); // originalpixlar per nivåpixel
+    const lw = Math.ceil(W / f), lh = Math.ceil(H / f);
+    const c0 = Math.max(0, Math.floor((cx - cw / 2 / scale) / f / tile));
+    const c1 = Math.min(Math.ceil(lw / tile) - 1, Math.floor((cx + cw / 2 / scale) / f / tile));
+    const r0 = Math.max(0, Math.floor((cy - ch / 2 / scale) / f / tile));
+    const r1 = Math.min(Math.ceil(lh / tile) - 1, Math.floor((cy + ch / 2 / scale) / f / tile));
+    for (const layer of layers) {
+      layer.level = level;
+      layer.wanted = new Set();
+      for (let r = r0; r <= r1; r++) {
+        for (let c = c0; c <= c1; c++) {
+          const key = `${level}/${c}_${r}`;
+          layer.wanted.add(key);
+          if (layer.tiles.has(key)) continue;
+          const img = new Image();
+          const tx = Math.max(0, c * tile - overlap), ty = Math.max(0, r * tile - overlap);
+          img.level = level;
+          img.rect = [tx * f, ty * f,
+                      (Math.min(lw, (c + 1) * tile + overlap) - tx) * f,
+                      (Math.min(lh, (r + 1) * tile + overlap) - ty) * f];
+          img.style.zIndex = level;
+          img.onload = () => prune(layer);
+          img.src = `${layer.src}/${key}.jpg`;
+          layer.tiles.set(key, img);
+          layer.el.appendChild(img);
+        }
+      }
+      for (const img of layer.tiles.values()) {
+        const [x, y, w, h] = img.rect;
+        img.style.left = ((x - cx) * scale + cw / 2) + 'px';
+        img.style.top = ((y - cy) * scale + ch / 2) + 'px';
+        img.style.width = (w * scale) + 'px';
+        img.style.height = (h * scale) + 'px';
+      }
+      prune(layer);
+    }
+  }
+
+  container.addEventListener('wheel', e => {
+    e.preventDefault();
+    const rect = container.getBoundingClientRect();
+    const mx = e.clientX - rect.left - rect.width / 2, my = e.clientY - rect.top - rect.height / 2;
+    const before = fitScale() * zoom;
+    const px = cx + mx / before, py = cy + my / before;
+    zoom *= Math.exp(-e.deltaY * 0.002);
+    clampView();
+    const after = fitScale() * zoom;
+    cx = px - mx / after;
+    cy = py - my / after;
+    render();
+  }, { passive: false });
+
+  let drag = null;
+  container.addEventListener('pointerdown', e => {
+    drag = { x: e.clientX, y: e.clientY };
+    container.setPointerCapture(e.pointerId);
+  });
+  container.addEventListener('pointermove', e => {
+    if (!drag) return;
+    const scale = fitScale() * zoom;
+    cx -= (e.clientX - drag.x) / scale;
+    cy -= (e.clientY - drag.y) / scale;
+    drag = { x: e.clientX, y: e.clientY };
+    render();
+  });
+  container.addEventListener('pointerup', () => { drag = null; });
+  container.addEventListener('dblclick', () => { zoom = 1; render(); });
+  window.addEventListener('resize', render);
+  render();
+  return () => window.removeEventListener('resize', render);
+}
+</script>
+</body>
+</html>
+)";
+    out.flush();
+    return html;
+}
@@ -0,0 +1,44 @@
+#ifndef GALLERYWRITER_H
+#define GALLERYWRITER_H
+
+#include <QMap>
+#include <QVariant>
+#include <QJsonArray>
+#include <QJsonObject>
+#include "exportoptions.h"
+
+// Skriver webbgalleriet (gallery.json, index.html och ev. djupzoom-pyramider)
+// för de projektmappar under baseDirPath som har before och after i exportens
+// format. Delarna finns också var för sig, för paketet som skrivs projekt för
+// projekt (se GalleryBundle).
+//
+// Med hashedAssets döps bilderna om efter innehållet (before.jpg blir
+// before.<hash>.jpg), så att oförändrade bilder behåller sin adress mellan
+// byggen och kan cachas för alltid. assets.json visar de nya namnen.
+
+class GalleryWriter
+{
+public:
+    GalleryWriter(const ExportOptions& options) : m_Options(options) {}
+    bool write(const QString& baseDirPath, const QString& title, const QList<QMap<QString,QVariant>>& projects) const;
+    bool hasPair(const QString& projectDir) const;
+    // Djupzoom-pyramiderna i projektmappen, om de är valda, och innehållsnamnen.
+    // Returnerar filnamn -> innehållsnamn inom mappen, tom utan hashedAssets.
+    QMap<QString,QString> writeDerivatives(const QString& projectDir) const;
+    // Projektets post i gallery.json, mappens namn är projektets
+    QJsonObject pairEntry(const QString& projectDir, const QMap<QString,QVariant>& project,
+                          const QMap<QString,QString>& assets = QMap<QString,QString>()) const;
+    // Filerna i galleriets rot: gallery.json och index.html, med hashedAssets även
+    // assets.json (sökväg -> innehållsnamn) och .gz/.br av alla tre
+    QList<QPair<QString,QByteArray>> siteFiles(const QString& title, const QJsonArray& pairs,
+                                               const QMap<QString,QString>& assets) const;
+    static QByteArray manifest(const QString& title, const QJsonArray& pairs);
+    static QByteArray indexHtml(const QString& title);
+    // Sökvägen är ett innehållsnamn eller ligger i en innehållsnamngiven pyramid,
+    // och kan cachas för alltid
+    static bool isContentNamed(const QString& path);
+private:
+    ExportOptions m_Options;
+};
+
+#endif // GALLERYWRITER_H
@@ -0,0 +1,141 @@
+#include "imageencoder.h"
+#include <QImageWriter>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDebug>
+
+ExportOptions::ImageFormat ImageEncoder::format(const QString& path) const
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "png") return ExportOptions::Png;
+    if (suffix == "webp") return ExportOptions::WebP;
+    return m_Options.imageFormat == ExportOptions::ProgressiveJpeg ? ExportOptions::ProgressiveJpeg : ExportOptions::Jpeg;
+}
+
+bool ImageEncoder::available(ExportOptions::ImageFormat format)
+{
+    if (format == ExportOptions::WebP) return QImageWriter::supportedImageFormats().contains("webp");
+    return true;
+}
+
+QByteArray ImageEncoder::encodeAt(const QImage& image, ExportOptions::ImageFormat format, int quality)
+{
+    static const char* names[] = { "jpg", "jpg", "png", "webp" };
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter w(&buffer, names[format]);
+    // PNG är förlustfri, kvaliteten vore bara en komprimeringsnivå
+    if (format != ExportOptions::Png) w.setQuality(quality);
+    if (format == ExportOptions::ProgressiveJpeg) w.setProgressiveScanWrite(true);
+    if (!w.write(image)) {
+        qWarning() << "ImageEncoder:" << w.errorString();
+        return QByteArray();
+    }
+    return data;
+}
+
+QByteArray ImageEncoder::encodeToSize(const QImage& image, ExportOptions::ImageFormat format, qint64 targetBytes, int* quality)
+{
+    // Varje varv kodar en kvalitet per tråd, jämnt fördelade i intervallet, och
+    // krymper det till mellan den högsta som rymdes och nästa prövade.
+    // Storleken antas växa med kvaliteten.
+    const int threads = qMax(2, QThread::idealThreadCount());
+    int lo = 1;
+    int hi = 100;
+    int bestQuality = -1;
+    QByteArray best;
+    while (lo <= hi) {
+        const int span = hi - lo + 1;
+        const int n = qMin(threads, span);
+        QList<int> qualities;
+        for (int i = 1; i <= n; i++) qualities << lo + span * i / n - 1;
+        const QList<QByteArray> results = QtConcurrent::blockingMapped<QList<QByteArray>>(qualities, [&](int q) {
+            return encodeAt(image, format, q);
+        });
+        int fit = -1;
+        for (int i = 0; i < qualities.size(); i++) {
+            if (!results[i].isEmpty() && results[i].size() <= targetBytes) fit = i;
+        }
+        if (fit >= 0) {
+            bestQuality = qualities[fit];
+            best = results[fit];
+            lo = bestQuality + 1;
+        }
+        if (fit + 1 < qualities.size()) hi = qualities[fit + 1] - 1;
+        else break;
+    }
+    if (bestQuality < 0) {
+        // Inte ens lägsta kvaliteten ryms, den får duga
+        bestQuality = 1;
+        best = encodeAt(image, format, bestQuality);
+        qWarning() << "ImageEncoder: target size" << targetBytes << "not reached, got" << best.size();
+    }
+    if (quality) *quality = bestQuality;
+    return best;
+}
+
+QByteArray ImageEncoder::encode(const QImage& image, ExportOptions::ImageFormat format, int* quality) const
+{
+    if (m_Options.targetKB > 0 && format != ExportOptions::Png) {
+        return encodeToSize(image, format, qint64(m_Options.targetKB) * 1024, quality);
+    }
+    if (quality) *quality = m_Options.quality;
+    return encodeAt(image, format, m_Options.quality);
+}
+
+bool ImageEncoder::write(const QImage& image, const QString& path) const
+{
+    const QByteArray data = encode(image, format(path));
+    if (data.isEmpty()) return false;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "ImageEncoder: cannot write" << path;
+        return false;
+    }
+    return file.write(data) == data.size();
+}
+
+int ImageEncoder::streamQuality(const QString& path, const QImage& proxy, qint64 pixels) const
+{
+    ExportOptions::ImageFormat f = format(path);
+    if (f == ExportOptions::Png) return -1;
+    if (m_Options.targetKB <= 0 || proxy.isNull() || pixels <= 0) return m_Options.quality;
+    // Bandexporten skriver baslinje-JPEG, se StripWriter::create
+    if (f == ExportOptions::ProgressiveJpeg) f = ExportOptions::Jpeg;
+    const qint64 target = qint64(m_Options.targetKB) * 1024 * proxy.width() * proxy.height() / pixels;
+    int quality = m_Options.quality;
+    encodeToSize(proxy, f, qMax<qint64>(1, target), &quality);
+    return quality;
+}
+
+EncoderPool::EncoderPool(const ExportOptions& options) : m_Encoder(options)
+{
+    // Egen pool, så att kodningen inte står i kö bakom omsamplingens jobb i den globala
+    m_Pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+void EncoderPool::write(const QImage& image, const QString& path)
+{
+    // Bilderna hålls i minnet tills de är kodade, vänta in de äldsta om kön växer
+    while (m_Results.size() >= 2 * m_Pool.maxThreadCount()) {
+        if (!m_Results.takeFirst().result()) m_Ok = false;
+    }
+    m_Results.append(QtConcurrent::run(&m_Pool, [this, image, path]() {
+        return m_Encoder.write(image, path);
+    }));
+}
+
+bool EncoderPool::waitForDone()
+{
+    for (QFuture<bool>& f : m_Results) {
+        if (!f.result()) m_Ok = false;
+    }
+    m_Results.clear();
+    const bool ok = m_Ok;
+    m_Ok = true;
+    return ok;
+}
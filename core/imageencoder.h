@@ -0,0 +1,49 @@
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+
+#include <QImage>
+#include <QFuture>
+#include <QThreadPool>
+#include "exportoptions.h"
+
+// Kodning av exporterade bilder enligt exportinställningarna. Med målstorlek
+// kodas flera kvaliteter parallellt i minnet och den högsta som ryms skrivs.
+
+class ImageEncoder
+{
+public:
+    ImageEncoder(const ExportOptions& options) : m_Options(options) {}
+    // Ändelsen avgör formatet, jpg följer inställningen (progressiv eller inte)
+    ExportOptions::ImageFormat format(const QString& path) const;
+    QByteArray encode(const QImage& image, ExportOptions::ImageFormat format, int* quality = nullptr) const;
+    bool write(const QImage& image, const QString& path) const;
+    // Kvalitet för en bild om pixels pixlar som skrivs bandvis till path. Den kan
+    // inte kodas om, så målstorleken skalas till proxyns storlek och söks på den.
+    int streamQuality(const QString& path, const QImage& proxy, qint64 pixels) const;
+
+    static QByteArray encodeAt(const QImage& image, ExportOptions::ImageFormat format, int quality);
+    static QByteArray encodeToSize(const QImage& image, ExportOptions::ImageFormat format, qint64 targetBytes, int* quality = nullptr);
+    static bool available(ExportOptions::ImageFormat format);
+private:
+    ExportOptions m_Options;
+};
+
+// Kodar och skriver på en egen trådpool, så att nästa projekt kan förvrängas
+// medan det förra kodas. Högst två bilder per tråd väntar i kö.
+
+class EncoderPool
+{
+public:
+    EncoderPool(const ExportOptions& options);
+    ~EncoderPool() { waitForDone(); }
+    void write(const QImage& image, const QString& path);
+    // false om någon bild inte kunde skrivas
+    bool waitForDone();
+private:
+    ImageEncoder m_Encoder;
+    QList<QFuture<bool>> m_Results;
+    bool m_Ok = true;
+    QThreadPool m_Pool;
+};
+
+#endif // IMAGEENCODER_H
@@ -0,0 +1,200 @@
+#include "imagehash.h"
+#include "imagemetadata.h"
+#include <QImageReader>
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <QDebug>
+#include <qmath.h>
+#include <algorithm>
+
+static const quint32 hashMagic = 0x42414848; // "BAHH"
+static const quint32 hashVersion = 1;
+static const int hashSide = 32;
+
+bool ImageHash::compute(const QString& path, quint64* hash)
+{
+    // Avkodaren skalar ned direkt, resten görs på en bild om 32 x 32
+    QImageReader r(path);
+    QImage image = ImageMetadata::read(r, QSize(hashSide, hashSide) * 2);
+    if (image.isNull()) return false;
+    image = image.convertToFormat(QImage::Format_Grayscale8).scaled(hashSide, hashSide, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    static const QVector<double> cosines = [] {
+        QVector<double> c(8 * hashSide);
+        for (int u = 0; u < 8; u++) {
+            for (int x = 0; x < hashSide; x++) c[u * hashSide + x] = qCos(M_PI * u * (2 * x + 1) / (2 * hashSide));
+        }
+        return c;
+    }();
+    // Separabel DCT, bara de 8 x 8 lägsta frekvenserna behövs
+    double rows[hashSide][8];
+    for (int y = 0; y < hashSide; y++) {
+        const uchar* line = image.constScanLine(y);
+        for (int u = 0; u < 8; u++) {
+            double sum = 0;
+            for (int x = 0; x < hashSide; x++) sum += line[x] * cosines[u * hashSide + x];
+            rows[y][u] = sum;
+        }
+    }
+    double coefficients[64];
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            double sum = 0;
+            for (int y = 0; y < hashSide; y++) sum += rows[y][u] * cosines[v * hashSide + y];
+            coefficients[v * 8 + u] = sum;
+        }
+    }
+    // Medianen utan likspänningstermen, som bara säger hur ljus bilden är
+    double sorted[63];
+    std::copy(coefficients + 1, coefficients + 64, sorted);
+    std::nth_element(sorted, sorted + 31, sorted + 63);
+    const double median = sorted[31];
+    quint64 h = 0;
+    for (int i = 1; i < 64; i++) {
+        if (coefficients[i] > median) h |= quint64(1) << i;
+    }
+    *hash = h;
+    return true;
+}
+
+QDataStream& operator<<(QDataStream& s, const HashIndex::Entry& e)
+{
+    return s << e.hash << e.fileSize << e.modified << e.ok;
+}
+
+QDataStream& operator>>(QDataStream& s, HashIndex::Entry& e)
+{
+    return s >> e.hash >> e.fileSize >> e.modified >> e.ok;
+}
+
+HashIndex::HashIndex()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/BeforeAfter";
+    QDir().mkpath(dir);
+    m_Path = dir + "/hashes.index";
+    QFile file(m_Path);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    QDataStream s(&file);
+    quint32 magic;
+    quint32 version;
+    s >> magic >> version;
+    if (magic != hashMagic || version != hashVersion) return;
+    s >> m_Entries;
+    if (s.status() != QDataStream::Ok) {
+        qWarning() << "HashIndex: damaged index" << m_Path;
+        m_Entries.clear();
+    }
+}
+
+bool HashIndex::isCurrent(const Entry& e, const QFileInfo& file)
+{
+    return e.fileSize == file.size() && e.modified == file.lastModified().toMSecsSinceEpoch();
+}
+
+void HashIndex::update(const QString& path)
+{
+    const QFileInfo file(path);
+    Entry e;
+    e.fileSize = file.size();
+    e.modified = file.lastModified().toMSecsSinceEpoch();
+    e.ok = ImageHash::compute(path, &e.hash);
+    QMutexLocker locker(&m_Mutex);
+    m_Entries.insert(path, e);
+    m_Dirty = true;
+}
+
+QFuture<void> HashIndex::scan(const QStringList& paths)
+{
+    QSet<QString> stale;
+    {
+        QMutexLocker locker(&m_Mutex);
+        for (const QString& path : paths) {
+            const auto it = m_Entries.constFind(path);
+            if (it == m_Entries.constEnd() || !isCurrent(*it, QFileInfo(path))) stale.insert(path);
+        }
+    }
+    // Listan måste leva tills jobbet är klart
+    m_Scanning = stale.values();
+    return QtConcurrent::map(m_Scanning, [this](const QString& path) { update(path); });
+}
+
+bool HashIndex::hash(const QString& path, quint64* hash)
+{
+    {
+        QMutexLocker locker(&m_Mutex);
+        const auto it = m_Entries.constFind(path);
+        if (it != m_Entries.constEnd() && isCurrent(*it, QFileInfo(path))) {
+            *hash = it->hash;
+            return it->ok;
+        }
+    }
+    update(path);
+    QMutexLocker locker(&m_Mutex);
+    *hash = m_Entries.value(path).hash;
+    return m_Entries.value(path).ok;
+}
+
+void HashIndex::setCandidates(const QStringList& paths)
+{
+    m_Candidates.clear();
+    m_CandidateHashes.clear();
+    for (QHash<quint16,QVector<int>>& table : m_Tables) table.clear();
+    for (const QString& path : paths) {
+        quint64 h;
+        if (!hash(path, &h)) continue;
+        const int i = int(m_Candidates.size());
+        m_Candidates.append(path);
+        m_CandidateHashes.append(h);
+        for (int t = 0; t < 4; t++) m_Tables[t][quint16(h >> (16 * t))].append(i);
+    }
+}
+
+QList<HashIndex::Match> HashIndex::nearest(quint64 hash, int count, int maxDistance) const
+{
+    QList<Match> found;
+    QSet<int> seen;
+    for (int s = 0; s <= 16 && 4 * s <= maxDistance; s++) {
+        // Alla 16-bitarsdelar på avståndet s från frågans, i varje tabell
+        for (int t = 0; t < 4; t++) {
+            const quint16 q = quint16(hash >> (16 * t));
+            for (quint32 flip = (1u << s) - 1; flip < (1u << 16);) {
+                const auto it = m_Tables[t].constFind(quint16(q ^ flip));
+                if (it != m_Tables[t].constEnd()) {
+                    for (int i : *it) {
+                        if (seen.contains(i)) continue;
+                        seen.insert(i);
+                        const int d = ImageHash::distance(hash, m_CandidateHashes[i]);
+                        if (d <= maxDistance) found.append({ m_Candidates[i], d });
+                    }
+                }
+                if (flip == 0) break;
+                // Nästa tal med lika många ettor (Gospers metod)
+                const quint32 c = flip & (0u - flip);
+                const quint32 r = flip + c;
+                flip = (((r ^ flip) >> 2) / c) | r;
+            }
+        }
+        std::stable_sort(found.begin(), found.end(), [](const Match& a, const Match& b) { return a.distance < b.distance; });
+        // Allt inom 4s + 3 är hittat, räcker det är resten längre bort
+        if (found.size() >= count && found[count - 1].distance <= 4 * s + 3) break;
+    }
+    return found.mid(0, count);
+}
+
+bool HashIndex::save()
+{
+    QMutexLocker locker(&m_Mutex);
+    if (!m_Dirty) return true;
+    QFile file(m_Path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "HashIndex: cannot write" << m_Path;
+        return false;
+    }
+    QDataStream s(&file);
+    s << hashMagic << hashVersion << m_Entries;
+    m_Dirty = s.status() != QDataStream::Ok;
+    return !m_Dirty;
+}
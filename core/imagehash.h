@@ -0,0 +1,65 @@
+#ifndef IMAGEHASH_H
+#define IMAGEHASH_H
+
+#include <QHash>
+#include <QMutex>
+#include <QFileInfo>
+#include <QFuture>
+#include <QStringList>
+#include <array>
+
+// 64-bitars perceptuell hash (pHash): bilden i 32 x 32 gråskala, de lägsta 8 x 8
+// DCT-koefficienterna jämförda med sin median. Nära bilder ger nära hashar mätt i
+// Hammingavstånd, oberoende av storlek, ljushet och måttlig kontrast.
+
+class ImageHash
+{
+public:
+    static bool compute(const QString& path, quint64* hash);
+    static int distance(quint64 a, quint64 b) { return qPopulationCount(a ^ b); }
+};
+
+// Hashar per sökväg, sparade i cachekatalogen och omräknade när filen ändras.
+// setCandidates() bygger en multiindexhashning över kandidaterna: hashen delas i
+// fyra 16-bitarsdelar med var sin tabell. Två hashar inom avståndet 4s + 3 har
+// minst en del inom avståndet s, så sökningen behöver bara gå igenom de delar
+// som ligger nära frågans.
+
+class HashIndex
+{
+public:
+    struct Match {
+        QString path;
+        int distance;
+    };
+    HashIndex();
+    ~HashIndex() { save(); }
+    // Räknar fram hashar för de paths som saknas eller har ändrats, parallellt
+    QFuture<void> scan(const QStringList& paths);
+    bool hash(const QString& path, quint64* hash);
+    void setCandidates(const QStringList& paths);
+    // Högst count kandidater inom maxDistance, närmast först
+    QList<Match> nearest(quint64 hash, int count, int maxDistance) const;
+    bool save();
+private:
+    struct Entry {
+        quint64 hash = 0;
+        qint64 fileSize = -1;
+        qint64 modified = -1;
+        bool ok = false;
+    };
+    friend QDataStream& operator<<(QDataStream& s, const Entry& e);
+    friend QDataStream& operator>>(QDataStream& s, Entry& e);
+    static bool isCurrent(const Entry& e, const QFileInfo& file);
+    void update(const QString& path);
+    QString m_Path;
+    QMutex m_Mutex;
+    QHash<QString,Entry> m_Entries;
+    bool m_Dirty = false;
+    QStringList m_Scanning;
+    QStringList m_Candidates;
+    QVector<quint64> m_CandidateHashes;
+    std::array<QHash<quint16,QVector<int>>,4> m_Tables;
+};
+
+#endif // IMAGEHASH_H
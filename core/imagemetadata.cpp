@@ -0,0 +1,264 @@
+#include "imagemetadata.h"
+#include <QImageReader>
+#include <QImageIOHandler>
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <QDebug>
+
+static const quint32 indexMagic = 0x42414d44; // "BAMD"
+static const quint32 indexVersion = 1;
+
+// Läser heltal med TIFF-blockets byteordning, 0 utanför blocket
+class TiffData
+{
+public:
+    TiffData(const QByteArray& data) : m_Data(data), m_Little(data.startsWith("II")) {}
+    bool isValid() const { return (m_Data.startsWith("II") || m_Data.startsWith("MM")) && u16(2) == 42; }
+    quint32 u16(qint64 o) const { return uint(byte(o + (m_Little ? 1 : 0))) << 8 | byte(o + (m_Little ? 0 : 1)); }
+    quint32 u32(qint64 o) const { return m_Little ? u16(o + 2) << 16 | u16(o) : u16(o) << 16 | u16(o + 2); }
+    // ASCII-värdet i en IFD-post
+    QString text(qint64 entry) const {
+        const quint32 count = u32(entry + 4);
+        const qint64 o = count <= 4 ? entry + 8 : u32(entry + 8);
+        if (o < 0 || o + count > m_Data.size()) return QString();
+        return QString::fromLatin1(m_Data.constData() + o, int(count)).section(QChar(0), 0, 0).trimmed();
+    }
+    qint64 size() const { return m_Data.size(); }
+private:
+    uchar byte(qint64 o) const { return o >= 0 && o < m_Data.size() ? uchar(m_Data[o]) : 0; }
+    const QByteArray& m_Data;
+    bool m_Little;
+};
+
+static QDateTime exifTime(const QString& s)
+{
+    return QDateTime::fromString(s, "yyyy:MM:dd HH:mm:ss");
+}
+
+bool ImageMetadata::parseTiff(const QByteArray& tiff, int* orientation, QDateTime* captured, QString* camera)
+{
+    const TiffData d(tiff);
+    if (!d.isValid()) return false;
+    QString make;
+    QString model;
+    QDateTime changed;
+    qint64 exifIfd = 0;
+    for (qint64 ifd = d.u32(4), depth = 0; ifd > 0 && ifd + 2 <= d.size() && depth < 2; depth++) {
+        const int count = int(d.u16(ifd));
+        for (int i = 0; i < count; i++) {
+            const qint64 e = ifd + 2 + 12 * i;
+            if (e + 12 > d.size()) break;
+            switch (d.u16(e)) {
+            case 0x0112: *orientation = int(d.u16(e + 8)); break;
+            case 0x010f: make = d.text(e); break;
+            case 0x0110: model = d.text(e); break;
+            case 0x0132: changed = exifTime(d.text(e)); break;
+            case 0x8769: exifIfd = d.u32(e + 8); break;
+            case 0x9003: *captured = exifTime(d.text(e)); break;
+            }
+        }
+        // IFD0 och sedan EXIF-underkatalogen, där tagningstiden står
+        ifd = depth == 0 ? exifIfd : 0;
+    }
+    if (!captured->isValid()) *captured = changed;
+    *camera = model.startsWith(make) ? model : (make + " " + model).trimmed();
+    return true;
+}
+
+// EXIF-blocket ur en JPEG. Markörerna läses en i taget, bilddatat hoppas över.
+static QByteArray jpegExif(QFile& file)
+{
+    if (file.read(2) != "\xFF\xD8") return QByteArray();
+    for (;;) {
+        const QByteArray m = file.read(4);
+        if (m.size() < 4 || uchar(m[0]) != 0xFF) return QByteArray();
+        const uchar marker = uchar(m[1]);
+        const int length = (uchar(m[2]) << 8 | uchar(m[3])) - 2;
+        if (marker == 0xDA || marker == 0xD9 || length < 0) return QByteArray();
+        if (marker == 0xE1) {
+            const QByteArray payload = file.read(length);
+            if (payload.startsWith(QByteArray("Exif\0\0", 6))) return payload.mid(6);
+        }
+        else if (!file.seek(file.pos() + length)) return QByteArray();
+    }
+}
+
+// EXIF-blocket ur filens huvud, tomt för format utan EXIF
+static QByteArray readExif(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    const QByteArray head = file.peek(4);
+    // TIFF-filer har katalogerna i början, oftast inom de första 64 kB
+    if (head.startsWith("II*") || head.startsWith(QByteArray("MM\0*", 4))) return file.read(64 * 1024);
+    return jpegExif(file);
+}
+
+ImageInfo ImageMetadata::info(const QString& path)
+{
+    ImageInfo info;
+    const QFileInfo fi(path);
+    info.fileSize = fi.size();
+    info.modified = fi.lastModified().toMSecsSinceEpoch();
+    info.captured = fi.lastModified();
+    QImageReader r(path);
+    const QSize stored = r.size();
+    int orientation = 0;
+    QDateTime captured;
+    const QByteArray exif = readExif(path);
+    if (!exif.isEmpty()) parseTiff(exif, &orientation, &captured, &info.camera);
+    info.transformation = r.supportsOption(QImageIOHandler::ImageTransformation) ? int(r.transformation()) : fromExif(orientation);
+    if (captured.isValid()) info.captured = captured;
+    info.size = orientedSize(stored, info.transformation);
+    return info;
+}
+
+int ImageMetadata::transformation(QImageReader& reader)
+{
+    if (reader.supportsOption(QImageIOHandler::ImageTransformation)) return reader.transformation();
+    int orientation = 0;
+    QDateTime captured;
+    QString camera;
+    const QByteArray exif = readExif(reader.fileName());
+    if (exif.isEmpty() || !parseTiff(exif, &orientation, &captured, &camera)) return QImageIOHandler::TransformationNone;
+    return fromExif(orientation);
+}
+
+QSize ImageMetadata::size(const QString& path)
+{
+    QImageReader r(path);
+    return size(r);
+}
+
+QSize ImageMetadata::size(QImageReader& reader)
+{
+    return orientedSize(reader.size(), transformation(reader));
+}
+
+QImage ImageMetadata::read(QImageReader& reader, const QSize& scaled)
+{
+    const int t = transformation(reader);
+    reader.setAutoTransform(false);
+    // Nedskalningen sker i avkodaren, före vändningen
+    if (scaled.isValid()) reader.setScaledSize(orientedSize(scaled, t));
+    return orient(reader.read(), t);
+}
+
+QSize ImageMetadata::orientedSize(const QSize& stored, int transformation)
+{
+    return transformation & QImageIOHandler::TransformationRotate90 ? stored.transposed() : stored;
+}
+
+QTransform ImageMetadata::orientation(int transformation, const QSize& stored)
+{
+    // Som Qt: spegla först, vrid sedan 90° medurs
+    QTransform t;
+    if (transformation & QImageIOHandler::TransformationMirror) t = t * QTransform(-1, 0, 0, 1, stored.width(), 0);
+    if (transformation & QImageIOHandler::TransformationFlip) t = t * QTransform(1, 0, 0, -1, 0, stored.height());
+    if (transformation & QImageIOHandler::TransformationRotate90) t = t * QTransform(0, 1, -1, 0, stored.height(), 0);
+    return t;
+}
+
+QImage ImageMetadata::orient(const QImage& stored, int transformation)
+{
+    if (transformation == QImageIOHandler::TransformationNone) return stored;
+    QImage i = stored.mirrored(transformation & QImageIOHandler::TransformationMirror, transformation & QImageIOHandler::TransformationFlip);
+    if (transformation & QImageIOHandler::TransformationRotate90) i = i.transformed(QTransform().rotate(90));
+    return i;
+}
+
+int ImageMetadata::fromExif(int orientation)
+{
+    static const int transformations[] = {
+        QImageIOHandler::TransformationNone, QImageIOHandler::TransformationMirror,
+        QImageIOHandler::TransformationRotate180, QImageIOHandler::TransformationFlip,
+        QImageIOHandler::TransformationFlipAndRotate90, QImageIOHandler::TransformationRotate90,
+        QImageIOHandler::TransformationMirrorAndRotate90, QImageIOHandler::TransformationRotate270
+    };
+    return orientation >= 1 && orientation <= 8 ? transformations[orientation - 1] : QImageIOHandler::TransformationNone;
+}
+
+static QDataStream& operator<<(QDataStream& s, const ImageInfo& i)
+{
+    return s << i.size << qint32(i.transformation) << i.captured << i.camera << i.fileSize << i.modified;
+}
+
+static QDataStream& operator>>(QDataStream& s, ImageInfo& i)
+{
+    qint32 transformation;
+    s >> i.size >> transformation >> i.captured >> i.camera >> i.fileSize >> i.modified;
+    i.transformation = transformation;
+    return s;
+}
+
+MetadataIndex::MetadataIndex()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/BeforeAfter";
+    QDir().mkpath(dir);
+    m_Path = dir + "/metadata.index";
+    QFile file(m_Path);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    QDataStream s(&file);
+    quint32 magic;
+    quint32 version;
+    s >> magic >> version;
+    if (magic != indexMagic || version != indexVersion) return;
+    s >> m_Infos;
+    if (s.status() != QDataStream::Ok) {
+        qWarning() << "MetadataIndex: damaged index" << m_Path;
+        m_Infos.clear();
+    }
+}
+
+bool MetadataIndex::isCurrent(const ImageInfo& info, const QFileInfo& file)
+{
+    return info.fileSize == file.size() && info.modified == file.lastModified().toMSecsSinceEpoch();
+}
+
+ImageInfo MetadataIndex::info(const QString& path)
+{
+    const QFileInfo file(path);
+    {
+        QMutexLocker locker(&m_Mutex);
+        const auto it = m_Infos.constFind(path);
+        if (it != m_Infos.constEnd() && isCurrent(*it, file)) return *it;
+    }
+    // Läses utanför låset, så att flera trådar kan läsa huvuden samtidigt
+    const ImageInfo info = ImageMetadata::info(path);
+    QMutexLocker locker(&m_Mutex);
+    m_Infos.insert(path, info);
+    m_Dirty = true;
+    return info;
+}
+
+void MetadataIndex::scan(const QStringList& paths)
+{
+    QSet<QString> stale;
+    {
+        QMutexLocker locker(&m_Mutex);
+        for (const QString& path : paths) {
+            const auto it = m_Infos.constFind(path);
+            if (!path.isEmpty() && (it == m_Infos.constEnd() || !isCurrent(*it, QFileInfo(path)))) stale.insert(path);
+        }
+    }
+    QStringList list = stale.values();
+    QtConcurrent::blockingMap(list, [this](const QString& path) { info(path); });
+}
+
+bool MetadataIndex::save()
+{
+    QMutexLocker locker(&m_Mutex);
+    if (!m_Dirty) return true;
+    QFile file(m_Path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "MetadataIndex: cannot write" << m_Path;
+        return false;
+    }
+    QDataStream s(&file);
+    s << indexMagic << indexVersion << m_Infos;
+    m_Dirty = s.status() != QDataStream::Ok;
+    return !m_Dirty;
+}
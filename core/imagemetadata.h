@@ -0,0 +1,70 @@
+#ifndef IMAGEMETADATA_H
+#define IMAGEMETADATA_H
+
+#include <QSize>
+#include <QDateTime>
+#include <QTransform>
+#include <QImage>
+#include <QHash>
+#include <QMutex>
+#include <QFileInfo>
+
+// Det som står i bildens huvud: storlek, EXIF-orientering, tagningstid och
+// kamera. Ingenting avkodas, så uppgifterna går att ta fram för tusentals filer.
+
+struct ImageInfo
+{
+    QSize size;             // som bilden visas, efter orienteringen
+    int transformation = 0; // QImageIOHandler::Transformations, lagrad -> visad
+    QDateTime captured;     // DateTimeOriginal, annars filens ändringstid
+    QString camera;
+    qint64 fileSize = -1;
+    qint64 modified = -1;   // ms sedan epoken
+    bool isValid() const { return !size.isEmpty(); }
+};
+
+class QImageReader;
+
+class ImageMetadata
+{
+public:
+    static ImageInfo info(const QString& path);
+    // Visad storlek ur huvudet, tom om filen inte går att läsa
+    static QSize size(const QString& path);
+    static QSize size(QImageReader& reader);
+    // Orienteringen ur Qts läsare, eller ur EXIF-blocket för format där den inte finns
+    static int transformation(QImageReader& reader);
+    // Avkodar och vänder bilden som den visas, nedskalad till scaled (visad storlek) om den anges
+    static QImage read(QImageReader& reader, const QSize& scaled = QSize());
+    static QSize orientedSize(const QSize& stored, int transformation);
+    // Lagrade pixelkoordinater -> visade, för en bild med den lagrade storleken stored
+    static QTransform orientation(int transformation, const QSize& stored);
+    // Vänder en lagrad bild (eller del av en) som den visas
+    static QImage orient(const QImage& stored, int transformation);
+    // EXIF Orientation (1..8) som QImageIOHandler::Transformations
+    static int fromExif(int orientation);
+    // Läser ett TIFF-block (EXIF i JPEG, eller en hel TIFF-fils början)
+    static bool parseTiff(const QByteArray& tiff, int* orientation, QDateTime* captured, QString* camera);
+};
+
+// ImageInfo per sökväg, sparad i cachekatalogen mellan körningarna. En post läses
+// om när filens storlek eller ändringstid inte längre stämmer. Trådsäker.
+
+class MetadataIndex
+{
+public:
+    MetadataIndex();
+    ~MetadataIndex() { save(); }
+    ImageInfo info(const QString& path);
+    // Läser in alla paths som saknas eller har ändrats, parallellt
+    void scan(const QStringList& paths);
+    bool save();
+private:
+    static bool isCurrent(const ImageInfo& info, const QFileInfo& file);
+    QString m_Path;
+    QMutex m_Mutex;
+    QHash<QString,ImageInfo> m_Infos;
+    bool m_Dirty = false;
+};
+
+#endif // IMAGEMETADATA_H
@@ -0,0 +1,303 @@
+#include "imagepair.h"
+#include "projectvalues.h"
+#include "imageprefetcher.h"
+#include "stripexport.h"
+#include "remaplut.h"
+#include "wipeanimation.h"
+#include "epochstack.h"
+#include "masklayer.h"
+#include "imageencoder.h"
+#include "imagemetadata.h"
+#include <QSharedPointer>
+#include <QDir>
+#include <QPolygonF>
+#include <qmath.h>
+#include <limits>
+
+QTransform ImagePair::afterTransform() const
+{
+    return ProjectValues::afterTransform(m_Project);
+}
+
+bool ImagePair::load(qint64 maxBytes)
+{
+    const QImage before = ImagePrefetcher::decode(beforePath(), maxBytes, &m_BeforeSize);
+    const QImage after = ImagePrefetcher::decode(afterPath(), maxBytes, &m_AfterSize);
+    if (before.isNull() || after.isNull()) {
+        qWarning() << "ImagePair: could not read" << name();
+        return false;
+    }
+    // Samma ordning som i fönstret: färgen skattas ur de okorrigerade proxyerna
+    const ColourLut::Mode mode = static_cast<ColourLut::Mode>(m_Project.value("ToneMatch").toInt());
+    m_AfterLut = ColourLut::estimate(mode, after, m_AfterSize, afterTransform(), before, m_BeforeSize);
+    m_Before = correctProxy(before, m_BeforeSize, ColourLut(), lens("Before"), filter("Before"));
+    m_After = correctProxy(after, m_AfterSize, m_AfterLut, lens("After"), filter("After"));
+    return true;
+}
+
+QSize ImagePair::beforeSizeOrRead() const
+{
+    return m_BeforeSize.isEmpty() ? ImageMetadata::size(beforePath()) : m_BeforeSize;
+}
+
+QSize ImagePair::afterSizeOrRead() const
+{
+    return m_AfterSize.isEmpty() ? ImageMetadata::size(afterPath()) : m_AfterSize;
+}
+
+QRect ImagePair::overlapRect() const
+{
+    return overlapRect(beforeSizeOrRead(), afterSizeOrRead(), afterTransform());
+}
+
+bool ImagePair::exportBefore(const QString& path, qint64 budget, const QRect& rect, int quality) const
+{
+    if (rect.isEmpty()) return StripExporter(budget).exportCopy(beforePath(), path, quality, ColourLut(), lens("Before"), filter("Before"));
+    return StripExporter(budget).exportWarped(beforePath(), path, rect.size(), QTransform::fromTranslate(-rect.x(), -rect.y()),
+                                              Qt::white, quality, ColourLut(), lens("Before"), filter("Before"));
+}
+
+bool ImagePair::exportAfter(const QString& path, qint64 budget, const ColourLut& lut, const QRect& rect, int quality) const
+{
+    const QSize canvas = rect.isEmpty() ? beforeSizeOrRead() : rect.size();
+    if (canvas.isEmpty()) {
+        qWarning() << "ImagePair: could not read" << beforePath();
+        return false;
+    }
+    QTransform t = afterTransform();
+    if (!rect.isEmpty()) t = t * QTransform::fromTranslate(-rect.x(), -rect.y());
+    return StripExporter(budget).exportWarped(afterPath(), path, canvas, t, Qt::white, quality, lut, lens("After"), filter("After"));
+}
+
+QImage ImagePair::renderAfter(qint64 budget, const ColourLut& lut, const QRect& rect) const
+{
+    const QSize canvas = rect.isEmpty() ? beforeSizeOrRead() : rect.size();
+    if (canvas.isEmpty()) {
+        qWarning() << "ImagePair: could not read" << beforePath();
+        return QImage();
+    }
+    QTransform t = afterTransform();
+    if (!rect.isEmpty()) t = t * QTransform::fromTranslate(-rect.x(), -rect.y());
+    return StripExporter(budget).renderWarped(afterPath(), canvas, t, Qt::white, lut, lens("After"), filter("After"));
+}
+
+bool ImagePair::exportComposite(const QString& path, qint64 budget, const ColourLut& lut, const QRect& rect, int quality) const
+{
+    MaskLayer mask;
+    if (!mask.load(m_Project.value("MaskFile").toString()) || mask.isEmpty()) return false;
+    const QSize beforeSize = beforeSizeOrRead();
+    const QSize canvas = rect.isEmpty() ? beforeSize : rect.size();
+    if (canvas.isEmpty()) {
+        qWarning() << "ImagePair: could not read" << beforePath();
+        return false;
+    }
+    const QTransform crop = QTransform::fromTranslate(-rect.x(), -rect.y());
+    // Masken täcker förebildens ram i sin egen, lägre upplösning
+    const qreal scale = qreal(mask.size().width()) / beforeSize.width();
+    const StripExporter::MaskBand band = [&](QImage& alpha, int top) {
+        mask.sample(alpha, QPointF(rect.x(), rect.y() + top), scale);
+    };
+    return StripExporter(budget).exportComposite(beforePath(), crop, lens("Before"), afterPath(), afterTransform() * crop, lut,
+                                                 lens("After"), band, path, canvas, quality, filter("Before"), filter("After"));
+}
+
+bool ImagePair::exportAnimation(const QString& path, int width, int frames, const QRect& rect) const
+{
+    return renderAnimation(path, width, frames, viewMode(), m_Before, m_BeforeSize, m_After, QRectF(QPointF(0,0), m_AfterSize), afterTransform(), rect);
+}
+
+bool ImagePair::exportFolder(const QString& dirPath, const ExportOptions& options)
+{
+    // Proxyerna behövs för färgmatchningen och animationen, de delar på en halv budget
+    if (m_After.isNull() && !load(options.memoryBudget() / 4)) return false;
+    QDir().mkpath(dirPath);
+    const QDir dir(dirPath);
+    const QRect rect = options.autoCrop ? overlapRect() : QRect();
+    const QSize canvas = rect.isEmpty() ? m_BeforeSize : rect.size();
+    const qint64 pixels = qint64(canvas.width()) * canvas.height();
+    const ImageEncoder encoder(options);
+    const QString before = dir.filePath("before." + options.imageSuffix());
+    const QString after = dir.filePath("after." + options.imageSuffix());
+    if (!exportBefore(before, options.memoryBudget(), rect, encoder.streamQuality(before, m_Before, pixels))) return false;
+    if (!exportAfter(after, options.memoryBudget(), m_AfterLut, rect, encoder.streamQuality(after, m_After, pixels))) return false;
+    if (options.wipeAnimation && !exportAnimation(dir.filePath("wipe.avi"), options.animationWidth, options.animationFrames, rect)) return false;
+    if (m_Project.contains("MaskFile")) {
+        const QString composite = dir.filePath("composite." + options.imageSuffix());
+        if (!exportComposite(composite, options.memoryBudget(), m_AfterLut, rect, encoder.streamQuality(composite, m_Before, pixels))) return false;
+    }
+    // Övriga epoker i stapeln, registrerade mot samma referens
+    return EpochStack::exportEpochs(m_Project, dirPath, options, rect);
+}
+
+void ImagePair::drawSplit(QPainter* painter, const QRectF& imageRect, const QImage& image, ViewMode mode, qreal factor)
+{
+    if (mode == ViewMode::EditView) {
+        painter->setOpacity(factor);
+        painter->drawImage(imageRect, image);
+    } else if (mode == ViewMode::SplitView) {
+        QRectF splitRect = imageRect;
+        splitRect.setRight(splitRect.left() + imageRect.width() * factor);
+        painter->setClipRect(splitRect);
+        painter->drawImage(imageRect, image);
+    } else if (mode == ViewMode::HSplitView) {
+        QRectF splitRect = imageRect;
+        splitRect.setBottom(splitRect.top() + imageRect.height() * factor);
+        painter->setClipRect(splitRect);
+        painter->drawImage(imageRect, image);
+    } else {
+        painter->drawImage(imageRect, image);
+    }
+}
+
+QImage ImagePair::correctProxy(const QImage& source, const QSize& originalSize, const ColourLut& lut, const LensDistortion& lens,
+                               const ScanFilter& filter)
+{
+    QImage image = source;
+    // Kärnorna skalas till proxyn, i full upplösning filtreras bara exporten
+    if (!originalSize.isEmpty()) filter.apply(image, qreal(image.width()) / originalSize.width());
+    lut.apply(image);
+    if (lens.isNull() || image.isNull()) return image;
+    const QSize size = image.size();
+    const QSize original = originalSize;
+    const qreal sx = qreal(original.width()) / size.width();
+    const qreal sy = qreal(original.height()) / size.height();
+    const QString key = QString("%1@%2x%3/%4x%5").arg(lens.key()).arg(size.width()).arg(size.height()).arg(original.width()).arg(original.height());
+    const QSharedPointer<const RemapLut> remap = RemapLut::cached(key, QRect(QPoint(0,0), size),
+        [lens, original, sx, sy](const QPointF& o, QPointF& s) {
+            const QPointF p = lens.distort(QPointF(o.x() * sx, o.y() * sy), original);
+            s = QPointF(p.x() / sx, p.y() / sy);
+            return true;
+        }, 8);
+    const QImage premultiplied = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage out(size, QImage::Format_ARGB32_Premultiplied);
+    out.fill(Qt::transparent);
+    remap->remap(premultiplied, QPoint(0,0), out, QPoint(0,0));
+    return out;
+}
+
+QRect ImagePair::overlapRect(const QSize& beforeSize, const QSize& afterSize, const QTransform& transform)
+{
+    const QRectF afterRect(QPointF(0,0), afterSize);
+    for (const QPointF& c : QPolygonF(afterRect)) {
+        if (transform.m13() * c.x() + transform.m23() * c.y() + transform.m33() <= 0) return QRect();
+    }
+    // Båda ramarna är konvexa, så snittet är det också
+    const QPolygonF region = transform.map(QPolygonF(afterRect)).intersected(QPolygonF(QRectF(QPointF(0,0), beforeSize)));
+    if (region.size() < 3) return QRect();
+    const QRectF bounds = region.boundingRect();
+
+    // Vågräta snitt genom polygonen på jämna avstånd. I en konvex polygon ryms
+    // en rektangel mellan två snitt precis om den ryms i båda snitten.
+    const int rows = 256;
+    QVector<double> ys(rows + 1), left(rows + 1), right(rows + 1);
+    for (int i = 0; i <= rows; i++) {
+        const double y = bounds.top() + bounds.height() * i / rows;
+        double l = std::numeric_limits<double>::max();
+        double r = std::numeric_limits<double>::lowest();
+        for (int k = 0; k < region.size(); k++) {
+            const QPointF p = region[k];
+            const QPointF q = region[(k + 1) % region.size()];
+            if (p.y() == q.y()) {
+                if (p.y() == y) {
+                    l = qMin(l, qMin(p.x(), q.x()));
+                    r = qMax(r, qMax(p.x(), q.x()));
+                }
+                continue;
+            }
+            if ((p.y() - y) * (q.y() - y) > 0) continue;
+            const double x = p.x() + (y - p.y()) * (q.x() - p.x()) / (q.y() - p.y());
+            l = qMin(l, x);
+            r = qMax(r, x);
+        }
+        ys[i] = y;
+        left[i] = l;
+        right[i] = r;
+    }
+    double bestArea = 0;
+    QRectF best;
+    for (int i = 0; i < rows; i++) {
+        for (int j = i + 1; j <= rows; j++) {
+            const double l = qMax(left[i], left[j]);
+            const double r = qMin(right[i], right[j]);
+            const double area = (r - l) * (ys[j] - ys[i]);
+            if (area > bestArea) {
+                bestArea = area;
+                best = QRectF(QPointF(l, ys[i]), QPointF(r, ys[j]));
+            }
+        }
+    }
+    // Avrunda inåt så att inga kantpixlar blir tomma
+    const QRect rect(QPoint(qCeil(best.left()), qCeil(best.top())), QPoint(qFloor(best.right()) - 1, qFloor(best.bottom()) - 1));
+    return rect.isValid() ? rect : QRect();
+}
+
+QImage ImagePair::perspectiveProxy(const QImage& proxy, const QSize& originalSize, const QTransform& perspective, QRectF* rect)
+{
+    const QRectF original(QPointF(0,0), originalSize);
+    *rect = original;
+    if (proxy.isNull() || originalSize.isEmpty() || perspective.isAffine()) return proxy;
+    // Bilden får inte korsa horisonten
+    const QPolygonF corners(original);
+    for (const QPointF& c : corners) {
+        if (perspective.m13() * c.x() + perspective.m23() * c.y() + perspective.m33() <= 0) {
+            qWarning("ImagePair: perspective crosses the horizon");
+            return QImage();
+        }
+    }
+    bool invertible;
+    const QTransform inverse = perspective.inverted(&invertible);
+    if (!invertible) return QImage();
+    *rect = perspective.mapRect(original);
+    // Samma upplösning som proxyn, men högst dubbla antalet pixlar
+    qreal scale = qreal(proxy.width()) / originalSize.width();
+    const qreal area = rect->width() * rect->height() * scale * scale;
+    const qreal maxArea = 2.0 * proxy.width() * proxy.height();
+    if (area > maxArea) scale *= qSqrt(maxArea / area);
+    const QSize size = (rect->size() * scale).toSize().expandedTo(QSize(1,1));
+    const QPointF origin = rect->topLeft();
+    const qreal sx = qreal(proxy.width()) / originalSize.width();
+    const qreal sy = qreal(proxy.height()) / originalSize.height();
+    const qreal ox = rect->width() / size.width();
+    const qreal oy = rect->height() / size.height();
+    const RemapLut remap(QRect(QPoint(0,0), size), [&](const QPointF& o, QPointF& s) {
+        const QPointF q(origin.x() + o.x() * ox, origin.y() + o.y() * oy);
+        if (inverse.m13() * q.x() + inverse.m23() * q.y() + inverse.m33() <= 0) return false;
+        const QPointF p = inverse.map(q);
+        s = QPointF(p.x() * sx, p.y() * sy);
+        return true;
+    }, 8);
+    const QImage source = proxy.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage out(size, QImage::Format_ARGB32_Premultiplied);
+    out.fill(Qt::transparent);
+    remap.remap(source, QPoint(0,0), out, QPoint(0,0));
+    return out;
+}
+
+bool ImagePair::renderAnimation(const QString& path, int width, int frames, ViewMode mode,
+                                const QImage& before, const QSize& beforeSize,
+                                const QImage& after, const QRectF& afterRect, const QTransform& transform,
+                                const QRect& rect)
+{
+    // Rutorna ritas från visningsbilderna (proxy, färg- och linskorrigerade),
+    // med samma sammanfogning som HighQualityImageItem::paint
+    if (beforeSize.isEmpty()) return false;
+    // Masken har ingen delning att svepa, förebilden tonas in i stället
+    if (mode == MaskView) mode = EditView;
+    const QRectF view = rect.isEmpty() ? QRectF(QPointF(0,0), beforeSize) : QRectF(rect);
+    width &= ~1;
+    const QSize frameSize(width, qMax(2, qRound(double(width) * view.height() / view.width()) & ~1));
+    const qreal scale = double(width) / view.width();
+    WipeAnimation animation(frameSize, frames);
+    return animation.render(path, [=](QPainter& painter, qreal position) {
+        painter.scale(scale, scale);
+        painter.translate(-view.topLeft());
+        painter.save();
+        painter.setTransform(transform, true);
+        painter.drawImage(afterRect, after);
+        painter.restore();
+        // Delningen sveper över det synliga utsnittet
+        if (mode == SplitView) position = (view.left() + position * view.width()) / beforeSize.width();
+        if (mode == HSplitView) position = (view.top() + position * view.height()) / beforeSize.height();
+        drawSplit(&painter, QRectF(QPointF(0,0), beforeSize), before, mode, position);
+    });
+}
@@ -0,0 +1,88 @@
+#ifndef IMAGEPAIR_H
+#define IMAGEPAIR_H
+
+#include <QMap>
+#include <QVariant>
+#include <QImage>
+#include <QPainter>
+#include "colourlut.h"
+#include "lensdistortion.h"
+#include "scanfilter.h"
+#include "exportoptions.h"
+
+enum ViewMode {
+    EditView,
+    SplitView,
+    HSplitView,
+    MaskView
+};
+
+// Ett före/efter-par ur en projektpost, utan GUI. Används av MainWindow och av
+// den fönsterlösa körningen. Varje instans är fristående, så flera par kan
+// behandlas i olika trådar samtidigt.
+
+class ImagePair
+{
+public:
+    ImagePair(const QMap<QString,QVariant>& project = QMap<QString,QVariant>()) : m_Project(project) {}
+    const QMap<QString,QVariant>& project() const { return m_Project; }
+    QString name() const { return m_Project.value("ProjectName").toString(); }
+    QString beforePath() const { return m_Project.value("BeforePix").toString(); }
+    QString afterPath() const { return m_Project.value("AfterPix").toString(); }
+    QTransform afterTransform() const;
+    LensDistortion lens(const QString& prefix) const { return LensDistortion::fromValues(m_Project, prefix); }
+    ScanFilter filter(const QString& prefix) const { return ScanFilter::fromValues(m_Project, prefix); }
+    ViewMode viewMode() const { return ViewMode(m_Project.value("ViewMode").toInt()); }
+
+    // Avkodar båda bilderna som proxyer inom maxBytes vardera, filtrerade samt färg- och linskorrigerade
+    bool load(qint64 maxBytes);
+    QSize beforeSize() const { return m_BeforeSize; }
+    QSize afterSize() const { return m_AfterSize; }
+    const QImage& beforeProxy() const { return m_Before; }
+    const QImage& afterProxy() const { return m_After; }
+    const ColourLut& afterLut() const { return m_AfterLut; }
+
+    // Största rektangeln där båda bilderna finns, i förebildens koordinater
+    QRect overlapRect() const;
+
+    // Export i full upplösning, bandvis inom budget. Med rect beskärs utdata till den.
+    // quality gäller JPEG och WebP, se ImageEncoder::streamQuality.
+    bool exportBefore(const QString& path, qint64 budget, const QRect& rect = QRect(), int quality = -1) const;
+    bool exportAfter(const QString& path, qint64 budget, const ColourLut& lut, const QRect& rect = QRect(), int quality = -1) const;
+    // Samma efterbild som exportAfter, i minnet som Format_RGB32
+    QImage renderAfter(qint64 budget, const ColourLut& lut, const QRect& rect = QRect()) const;
+    // Före över efter genom projektets mask (MaskFile), false om masken saknas
+    bool exportComposite(const QString& path, qint64 budget, const ColourLut& lut, const QRect& rect = QRect(), int quality = -1) const;
+    // Kräver load()
+    bool exportAnimation(const QString& path, int width, int frames, const QRect& rect = QRect()) const;
+    bool exportFolder(const QString& dirPath, const ExportOptions& options);
+
+    // Ritar image i imageRect med vyläget, används både av paint() och animationsexporten
+    static void drawSplit(QPainter* painter, const QRectF& imageRect, const QImage& image, ViewMode mode, qreal factor);
+    // Filtrerar samt färg- och linskorrigerar en proxy av en bild med storleken originalSize
+    static QImage correctProxy(const QImage& source, const QSize& originalSize, const ColourLut& lut, const LensDistortion& lens,
+                               const ScanFilter& filter = ScanFilter());
+    // Största axelparallella rektangeln i snittet av förebildens ram och efterbildens
+    // transformerade ram. Tom om de inte överlappar.
+    static QRect overlapRect(const QSize& beforeSize, const QSize& afterSize, const QTransform& transform);
+    // Förvränger en proxy med perspektivdelen av efterbildens transform. rect blir
+    // resultatets läge i originalkoordinater, så att resten kan ritas affint.
+    static QImage perspectiveProxy(const QImage& proxy, const QSize& originalSize, const QTransform& perspective, QRectF* rect);
+    // after ritas i afterRect (originalkoordinater) med transform, före ovanpå enligt vyläget.
+    // Rutorna visar rect av förebilden, hela om den är tom.
+    static bool renderAnimation(const QString& path, int width, int frames, ViewMode mode,
+                                const QImage& before, const QSize& beforeSize,
+                                const QImage& after, const QRectF& afterRect, const QTransform& transform,
+                                const QRect& rect = QRect());
+private:
+    QSize beforeSizeOrRead() const;
+    QSize afterSizeOrRead() const;
+    QMap<QString,QVariant> m_Project;
+    QImage m_Before;
+    QImage m_After;
+    QSize m_BeforeSize;
+    QSize m_AfterSize;
+    ColourLut m_AfterLut;
+};
+
+#endif // IMAGEPAIR_H
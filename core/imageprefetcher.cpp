@@ -0,0 +1,98 @@
+#include "imageprefetcher.h"
+#include "imagemetadata.h"
+#include <QImageReader>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QDebug>
+#include <qmath.h>
+
+ImagePrefetcher::ImagePrefetcher(QObject* parent) : QObject(parent)
+{
+    // En tråd med låg prioritet, det aktuella projektets arbete går först
+    m_Pool.setMaxThreadCount(1);
+    m_Pool.setThreadPriority(QThread::LowPriority);
+}
+
+void ImagePrefetcher::setBudget(qint64 bytes)
+{
+    m_Budget = bytes;
+    // Kostnaden räknas i kB
+    m_Cache.setMaxCost(qMax<qint64>(1, bytes / 1024));
+}
+
+QString ImagePrefetcher::key(const QString& path, qint64 maxBytes)
+{
+    return QString("%1|%2|%3").arg(path).arg(QFileInfo(path).lastModified().toMSecsSinceEpoch()).arg(maxBytes);
+}
+
+QImage ImagePrefetcher::decode(const QString& path, qint64 maxBytes, QSize* originalSize)
+{
+    QImageReader r(path);
+    QSize size = ImageMetadata::size(r);
+    // Bilder som inte ryms i budgeten hålls som nedskalad proxy, export sker bandvis från fil
+    const qint64 bytes = qint64(size.width()) * size.height() * 4;
+    const QImage image = ImageMetadata::read(r, maxBytes > 0 && bytes > maxBytes ? (QSizeF(size) * qSqrt(qreal(maxBytes) / bytes)).toSize() : QSize());
+    if (!size.isValid() || image.isNull()) size = image.size();
+    if (originalSize) *originalSize = size;
+    // Proxyn normaliseras en gång här, även 16-bitars källor, så att visning och
+    // ritning aldrig konverterar per bildruta
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+void ImagePrefetcher::prefetch(const QStringList& paths, qint64 maxBytes)
+{
+    QSet<QString> wanted;
+    QList<QPair<QString,QString>> jobs;
+    qint64 total = 0;
+    for (const QString& path : paths) {
+        if (path.isEmpty()) continue;
+        const QString k = key(path, maxBytes);
+        if (wanted.contains(k)) continue;
+        // Uppskattning ur huvudet, proxyn blir högst maxBytes
+        const QSize size = QImageReader(path).size();
+        qint64 bytes = qint64(size.width()) * size.height() * 4;
+        if (maxBytes > 0) bytes = qMin(bytes, maxBytes);
+        if (total + bytes > m_Budget) break;
+        total += bytes;
+        wanted.insert(k);
+        if (!m_Cache.contains(k) && !m_Pending.contains(k)) jobs.append({ k, path });
+    }
+    {
+        QMutexLocker lock(&m_WantedMutex);
+        m_Wanted = wanted;
+    }
+    for (const QPair<QString,QString>& job : jobs) {
+        const QString k = job.first;
+        const QString path = job.second;
+        m_Pending.insert(k);
+        m_Pool.start([this, k, path, maxBytes]() {
+            QSharedPointer<Entry> e;
+            bool stillWanted;
+            {
+                QMutexLocker lock(&m_WantedMutex);
+                stillWanted = m_Wanted.contains(k);
+            }
+            // Användaren har hoppat vidare, hoppa över jobbet
+            if (stillWanted) {
+                e.reset(new Entry);
+                e->image = decode(path, maxBytes, &e->originalSize);
+            }
+            QMetaObject::invokeMethod(this, [this, k, e]() {
+                m_Pending.remove(k);
+                if (!e || e->image.isNull()) return;
+                m_Cache.insert(k, new Entry(*e), qMax<qsizetype>(1, e->image.sizeInBytes() / 1024));
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+QImage ImagePrefetcher::take(const QString& path, qint64 maxBytes, QSize* originalSize)
+{
+    Entry* e = m_Cache.take(key(path, maxBytes));
+    if (!e) return QImage();
+    const QImage image = e->image;
+    if (originalSize) *originalSize = e->originalSize;
+    delete e;
+    return image;
+}
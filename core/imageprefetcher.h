@@ -0,0 +1,41 @@
+#ifndef IMAGEPREFETCHER_H
+#define IMAGEPREFETCHER_H
+
+#include <QObject>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
+
+// Avkodar bilder i förväg (grannprojekten och det som pekaren står över) på en
+// lågprioriterad tråd. Ett nytt prefetch() ersätter det förra: köade jobb som
+// inte längre efterfrågas hoppas över. Resultaten hålls i en cache som inte
+// får överskrida budgeten och lämnas ut med take().
+
+class ImagePrefetcher : public QObject
+{
+public:
+    ImagePrefetcher(QObject* parent = nullptr);
+    void setBudget(qint64 bytes);
+    // paths i prioritetsordning, det som inte ryms i budgeten hämtas inte
+    void prefetch(const QStringList& paths, qint64 maxBytes);
+    // Förhämtad bild eller null, originalSize sätts vid träff
+    QImage take(const QString& path, qint64 maxBytes, QSize* originalSize);
+    // Avkodar path, nedskalad till proxy om den inte ryms i maxBytes. Trådsäker.
+    static QImage decode(const QString& path, qint64 maxBytes, QSize* originalSize = nullptr);
+private:
+    struct Entry {
+        QImage image;
+        QSize originalSize;
+    };
+    static QString key(const QString& path, qint64 maxBytes);
+    qint64 m_Budget = 0;
+    QCache<QString,Entry> m_Cache;
+    QSet<QString> m_Pending;
+    QMutex m_WantedMutex;
+    QSet<QString> m_Wanted;
+    QThreadPool m_Pool;
+};
+
+#endif // IMAGEPREFETCHER_H
@@ -0,0 +1,179 @@
+#include "lensdistortion.h"
+#include <QVector>
+#include <qmath.h>
+
+QPointF LensDistortion::distort(const QPointF& p, const QSize& size) const
+{
+    if (isNull() || size.isEmpty()) return p;
+    const double cx = size.width() * 0.5;
+    const double cy = size.height() * 0.5;
+    const double f = 0.5 * qHypot(size.width(), size.height());
+    const double x = (p.x() - cx) / f;
+    const double y = (p.y() - cy) / f;
+    const double r2 = x * x + y * y;
+    const double radial = 1 + k1 * r2 + k2 * r2 * r2;
+    const double xd = x * radial + 2 * p1 * x * y + p2 * (r2 + 2 * x * x);
+    const double yd = y * radial + p1 * (r2 + 2 * y * y) + 2 * p2 * x * y;
+    return QPointF(xd * f + cx, yd * f + cy);
+}
+
+QPointF LensDistortion::undistort(const QPointF& p, const QSize& size) const
+{
+    if (isNull() || size.isEmpty()) return p;
+    // Fixpunktsiteration, modellen saknar sluten invers
+    QPointF u = p;
+    for (int i = 0; i < 20; ++i) {
+        const QPointF d = distort(u, size) - p;
+        u -= d;
+        if (qAbs(d.x()) + qAbs(d.y()) < 1e-4) break;
+    }
+    return u;
+}
+
+// Gausselimination med partiell pivotering, a är n x n radvis, lösningen hamnar i b
+static bool solveLinearSystem(QVector<double>& a, QVector<double>& b, int n)
+{
+    for (int c = 0; c < n; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < n; ++r) if (qAbs(a[r * n + c]) > qAbs(a[pivot * n + c])) pivot = r;
+        if (qAbs(a[pivot * n + c]) < 1e-15) return false;
+        if (pivot != c) {
+            for (int k = 0; k < n; ++k) std::swap(a[c * n + k], a[pivot * n + k]);
+            std::swap(b[c], b[pivot]);
+        }
+        for (int r = c + 1; r < n; ++r) {
+            const double f = a[r * n + c] / a[c * n + c];
+            for (int k = c; k < n; ++k) a[r * n + k] -= f * a[c * n + k];
+            b[r] -= f * b[c];
+        }
+    }
+    for (int r = n - 1; r >= 0; --r) {
+        double s = b[r];
+        for (int k = r + 1; k < n; ++k) s -= a[r * n + k] * b[k];
+        b[r] = s / a[r * n + r];
+    }
+    return true;
+}
+
+bool LensDistortion::solve(const QList<QPointF>& fixedPoints, const QList<QPointF>& freePoints, const QSize& freeSize,
+                           LensDistortion& lens, QTransform& m, double* rms)
+{
+    const int n = qMin(fixedPoints.size(), freePoints.size());
+    if (n < 3 || freeSize.isEmpty()) return false;
+    const bool affine = n >= 4;
+    const int nm = affine ? 6 : 4;
+    const int nk = 2 * n >= nm + 3 ? 2 : 1;
+    // De tangentiella termerna bara med överbestämning, annars tar de upp klickfelen
+    const int nt = 2 * n >= nm + nk + 2 + 2 ? 2 : 0;
+    const int np = nm + nk + nt;
+
+    // Startvärde: ren förskjutning mellan tyngdpunkterna, aktuella linsparametrar
+    QPointF fixedMean, freeMean;
+    for (int i = 0; i < n; ++i) {
+        fixedMean += fixedPoints[i] / n;
+        freeMean += lens.undistort(freePoints[i], freeSize) / n;
+    }
+    QVector<double> p(np, 0.0);
+    p[0] = 1;
+    if (affine) {
+        p[3] = 1;
+        p[4] = freeMean.x() - fixedMean.x();
+        p[5] = freeMean.y() - fixedMean.y();
+    } else {
+        p[2] = freeMean.x() - fixedMean.x();
+        p[3] = freeMean.y() - fixedMean.y();
+    }
+    p[nm] = lens.k1;
+    if (nk == 2) p[nm + 1] = lens.k2;
+    if (nt == 2) {
+        p[nm + nk] = lens.p1;
+        p[nm + nk + 1] = lens.p2;
+    }
+
+    auto toTransform = [affine](const QVector<double>& v) {
+        if (affine) return QTransform(v[0], v[1], v[2], v[3], v[4], v[5]);
+        return QTransform(v[0], v[1], -v[1], v[0], v[2], v[3]);
+    };
+    auto residuals = [&](const QVector<double>& v) {
+        const QTransform t = toTransform(v);
+        LensDistortion l = lens;
+        l.k1 = v[nm];
+        if (nk == 2) l.k2 = v[nm + 1];
+        if (nt == 2) {
+            l.p1 = v[nm + nk];
+            l.p2 = v[nm + nk + 1];
+        }
+        QVector<double> r(2 * n);
+        for (int i = 0; i < n; ++i) {
+            const QPointF d = l.distort(t.map(fixedPoints[i]), freeSize) - freePoints[i];
+            r[2 * i] = d.x();
+            r[2 * i + 1] = d.y();
+        }
+        return r;
+    };
+    auto sumSquares = [](const QVector<double>& r) {
+        double s = 0;
+        for (double v : r) s += v * v;
+        return s;
+    };
+
+    // Levenberg-Marquardt med numerisk Jacobian
+    QVector<double> r = residuals(p);
+    double cost = sumSquares(r);
+    double lambda = 1e-3;
+    for (int it = 0; it < 100; ++it) {
+        QVector<double> jac(2 * n * np);
+        for (int j = 0; j < np; ++j) {
+            QVector<double> pp = p;
+            const double h = 1e-6 * qMax(1.0, qAbs(p[j]));
+            pp[j] += h;
+            const QVector<double> rr = residuals(pp);
+            for (int i = 0; i < 2 * n; ++i) jac[i * np + j] = (rr[i] - r[i]) / h;
+        }
+        QVector<double> jtj(np * np, 0.0);
+        QVector<double> jtr(np, 0.0);
+        for (int i = 0; i < 2 * n; ++i) {
+            for (int a = 0; a < np; ++a) {
+                jtr[a] += jac[i * np + a] * r[i];
+                for (int b = 0; b < np; ++b) jtj[a * np + b] += jac[i * np + a] * jac[i * np + b];
+            }
+        }
+        bool improved = false;
+        double gain = 0;
+        for (int tries = 0; tries < 10 && !improved; ++tries) {
+            QVector<double> a = jtj;
+            QVector<double> step(np);
+            for (int j = 0; j < np; ++j) {
+                a[j * np + j] += lambda * qMax(jtj[j * np + j], 1e-9);
+                step[j] = -jtr[j];
+            }
+            if (solveLinearSystem(a, step, np)) {
+                QVector<double> candidate = p;
+                for (int j = 0; j < np; ++j) candidate[j] += step[j];
+                const QVector<double> rc = residuals(candidate);
+                const double c = sumSquares(rc);
+                if (c < cost) {
+                    gain = cost - c;
+                    p = candidate;
+                    r = rc;
+                    cost = c;
+                    lambda = qMax(lambda * 0.1, 1e-12);
+                    improved = true;
+                    continue;
+                }
+            }
+            lambda *= 10;
+        }
+        if (!improved || gain < 1e-12 * (1 + cost)) break;
+    }
+
+    lens.k1 = p[nm];
+    if (nk == 2) lens.k2 = p[nm + 1];
+    if (nt == 2) {
+        lens.p1 = p[nm + nk];
+        lens.p2 = p[nm + nk + 1];
+    }
+    m = toTransform(p);
+    if (rms) *rms = qSqrt(cost / n);
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef LENSDISTORTION_H
+#define LENSDISTORTION_H
+
+#include <QPointF>
+#include <QSize>
+#include <QList>
+#include <QMap>
+#include <QVariant>
+#include <QTransform>
+
+// Brown-Conrady-modell med två radiella (k1, k2) och två tangentiella (p1, p2)
+// termer. Koordinaterna normaliseras kring bildens mitt med halva diagonalen,
+// så att hörnen ligger på radien 1. distort() avbildar en korrigerad punkt på
+// den punkt i originalbilden där den faktiskt syns.
+
+class LensDistortion
+{
+public:
+    double k1 = 0;
+    double k2 = 0;
+    double p1 = 0;
+    double p2 = 0;
+    bool isNull() const { return k1 == 0 && k2 == 0 && p1 == 0 && p2 == 0; }
+    QPointF distort(const QPointF& p, const QSize& size) const;
+    QPointF undistort(const QPointF& p, const QSize& size) const;
+    QString key() const { return QString("%1:%2:%3:%4").arg(k1).arg(k2).arg(p1).arg(p2); }
+
+    static LensDistortion fromValues(const QMap<QString,QVariant>& values, const QString& prefix) {
+        LensDistortion l;
+        l.k1 = values.value(prefix + "K1").toDouble();
+        l.k2 = values.value(prefix + "K2").toDouble();
+        l.p1 = values.value(prefix + "P1").toDouble();
+        l.p2 = values.value(prefix + "P2").toDouble();
+        return l;
+    }
+
+    // Skattar k1 (och k2 när punkterna räcker, p1 och p2 från sex par)
+    // för den fria bilden tillsammans med avbildningen m från den fasta bildens
+    // korrigerade koordinater till den fria bildens korrigerade koordinater.
+    // freePoints är råa koordinater i den fria bilden.
+    // Med tre punkter används en likformighetsavbildning, annars affin.
+    static bool solve(const QList<QPointF>& fixedPoints, const QList<QPointF>& freePoints, const QSize& freeSize,
+                      LensDistortion& lens, QTransform& m, double* rms = nullptr);
+};
+
+#endif // LENSDISTORTION_H
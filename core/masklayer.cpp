@@ -0,0 +1,258 @@
+#include "masklayer.h"
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QUuid>
+#include <QtConcurrent>
+#include <QDebug>
+#include <qmath.h>
+#include <cstring>
+
+static const quint32 maskMagic = 0x42414d4b; // "BAMK"
+static const quint32 maskVersion = 1;
+
+// Två kanaler åt gången i ett 32-bitars ord, som Qts BYTE_MUL och INTERPOLATE_PIXEL_255
+static inline uint byteMul(uint x, uint a)
+{
+    uint t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+static inline uint interpolate255(uint x, uint a, uint y, uint b)
+{
+    uint t = (x & 0xff00ff) * a + (y & 0xff00ff) * b;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a + ((y >> 8) & 0xff00ff) * b;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+static bool blendable(const QImage& image)
+{
+    return image.depth() == 32;
+}
+
+// Delar rect i radblock som körs parallellt
+template <typename F>
+static void forRows(const QRect& rect, F rows)
+{
+    const int chunk = 64;
+    QList<int> starts;
+    for (int y = rect.top(); y <= rect.bottom(); y += chunk) starts << y;
+    QtConcurrent::blockingMap(starts, [&](int y) {
+        rows(y, qMin(y + chunk, rect.bottom() + 1));
+    });
+}
+
+MaskLayer::MaskLayer(const QSize& size)
+    : m_Columns((size.width() + tileSize - 1) / tileSize), m_Rows((size.height() + tileSize - 1) / tileSize), m_Size(size)
+{
+    m_Tiles.resize(m_Columns * m_Rows);
+}
+
+bool MaskLayer::isEmpty() const
+{
+    for (const QByteArray& tile : m_Tiles) if (!tile.isEmpty()) return false;
+    return true;
+}
+
+QRect MaskLayer::stroke(const QPointF& center, qreal radius, qreal hardness, qreal flow, bool erase)
+{
+    if (isNull() || radius <= 0) return QRect();
+    const QRect rect = QRect(QPoint(qFloor(center.x() - radius), qFloor(center.y() - radius)),
+                             QPoint(qCeil(center.x() + radius), qCeil(center.y() + radius))).intersected(QRect(QPoint(0,0), m_Size));
+    if (rect.isEmpty()) return QRect();
+    const qreal inner = qBound(0.0, hardness, 1.0) * radius;
+    const qreal soft = qMax(radius - inner, 1e-6);
+    const qreal strength = qBound(0.0, flow, 1.0) * 255;
+    for (int ty = rect.top() / tileSize; ty <= rect.bottom() / tileSize; ty++) {
+        for (int tx = rect.left() / tileSize; tx <= rect.right() / tileSize; tx++) {
+            QByteArray& tile = m_Tiles[ty * m_Columns + tx];
+            if (tile.isEmpty()) {
+                if (erase) continue;
+                tile = QByteArray(tileSize * tileSize, 0);
+            }
+            uchar* data = reinterpret_cast<uchar*>(tile.data());
+            const QRect area = rect.intersected(QRect(tx * tileSize, ty * tileSize, tileSize, tileSize));
+            for (int y = area.top(); y <= area.bottom(); y++) {
+                const qreal dy = y + 0.5 - center.y();
+                uchar* row = data + (y - ty * tileSize) * tileSize;
+                for (int x = area.left(); x <= area.right(); x++) {
+                    const qreal dx = x + 0.5 - center.x();
+                    const qreal d = qSqrt(dx * dx + dy * dy);
+                    if (d >= radius) continue;
+                    // Full täckning innanför inner, sedan mjuk avrundning (smoothstep) ut till radien
+                    qreal w = 1;
+                    if (d > inner) {
+                        const qreal t = (d - inner) / soft;
+                        w = 1 - t * t * (3 - 2 * t);
+                    }
+                    const int amount = qRound(w * strength);
+                    uchar& v = row[x - tx * tileSize];
+                    v = erase ? v - (v * amount + 127) / 255 : v + ((255 - v) * amount + 127) / 255;
+                }
+            }
+        }
+    }
+    return rect;
+}
+
+void MaskLayer::fetchRow(int y, int x0, int x1, uchar* out) const
+{
+    const int ty = y / tileSize;
+    for (int x = x0; x <= x1;) {
+        const int tx = x / tileSize;
+        const int n = qMin(x1 + 1, (tx + 1) * tileSize) - x;
+        const QByteArray& tile = m_Tiles[ty * m_Columns + tx];
+        if (tile.isEmpty()) std::memset(out, 0, n);
+        else std::memcpy(out, tile.constData() + (y - ty * tileSize) * tileSize + (x - tx * tileSize), n);
+        out += n;
+        x += n;
+    }
+}
+
+void MaskLayer::sample(QImage& alpha, const QPointF& origin, qreal scale) const
+{
+    if (alpha.isNull()) return;
+    if (isNull() || isEmpty()) {
+        alpha.fill(0);
+        return;
+    }
+    const int width = alpha.width();
+    const int maxX = m_Size.width() - 1;
+    const int maxY = m_Size.height() - 1;
+    // Maskkolumn och bråkdel (8 bitar) för varje utdatakolumn
+    QVector<int> xs(width);
+    QVector<int> fx(width);
+    for (int i = 0; i < width; i++) {
+        const qreal mx = qBound(0.0, (origin.x() + i + 0.5) * scale - 0.5, qreal(maxX));
+        xs[i] = int(mx);
+        fx[i] = int((mx - xs[i]) * 256);
+    }
+    const int left = xs.first();
+    const int right = qMin(xs.last() + 1, maxX);
+    QByteArray upper(right - left + 1, 0);
+    QByteArray lower(right - left + 1, 0);
+    const uchar* a = reinterpret_cast<const uchar*>(upper.constData());
+    const uchar* b = reinterpret_cast<const uchar*>(lower.constData());
+    int cached = -1;
+    for (int j = 0; j < alpha.height(); j++) {
+        const qreal my = qBound(0.0, (origin.y() + j + 0.5) * scale - 0.5, qreal(maxY));
+        const int y0 = int(my);
+        const int fy = int((my - y0) * 256);
+        if (y0 != cached) {
+            fetchRow(y0, left, right, reinterpret_cast<uchar*>(upper.data()));
+            fetchRow(qMin(y0 + 1, maxY), left, right, reinterpret_cast<uchar*>(lower.data()));
+            cached = y0;
+        }
+        uchar* out = alpha.scanLine(j);
+        for (int i = 0; i < width; i++) {
+            const int x0 = xs[i] - left;
+            const int x1 = qMin(xs[i] + 1, maxX) - left;
+            const int top = a[x0] * (256 - fx[i]) + a[x1] * fx[i];
+            const int bottom = b[x0] * (256 - fx[i]) + b[x1] * fx[i];
+            out[i] = uchar((top * (256 - fy) + bottom * fy + 32768) >> 16);
+        }
+    }
+}
+
+bool MaskLayer::save(const QString& path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "MaskLayer: cannot write" << path;
+        return false;
+    }
+    QDataStream s(&file);
+    s << maskMagic << maskVersion << m_Size;
+    for (int i = 0; i < m_Tiles.size(); i++) {
+        const QByteArray& tile = m_Tiles[i];
+        if (tile.isEmpty() || tile.count(char(0)) == tile.size()) continue;
+        s << qint32(i) << qCompress(tile);
+    }
+    s << qint32(-1);
+    return s.status() == QDataStream::Ok;
+}
+
+bool MaskLayer::load(const QString& path)
+{
+    *this = MaskLayer();
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream s(&file);
+    quint32 magic;
+    quint32 version;
+    QSize size;
+    s >> magic >> version >> size;
+    if (magic != maskMagic || version != maskVersion || size.isEmpty()) {
+        qWarning() << "MaskLayer: not a mask file" << path;
+        return false;
+    }
+    *this = MaskLayer(size);
+    for (;;) {
+        qint32 i;
+        QByteArray data;
+        s >> i;
+        if (i < 0 || s.status() != QDataStream::Ok) break;
+        s >> data;
+        data = qUncompress(data);
+        if (i >= m_Tiles.size() || data.size() != tileSize * tileSize) {
+            qWarning() << "MaskLayer: damaged tile" << i << path;
+            continue;
+        }
+        m_Tiles[i] = data;
+    }
+    return s.status() == QDataStream::Ok;
+}
+
+QString MaskLayer::newPath()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/BeforeAfter/masks";
+    QDir().mkpath(dir);
+    return dir + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".mask";
+}
+
+void MaskLayer::blend(QImage& dst, const QImage& src, const QImage& alpha, const QRect& rect)
+{
+    if (!blendable(dst) || !blendable(src) || alpha.format() != QImage::Format_Alpha8 || alpha.size() != rect.size()) return;
+    // Loss från delad data en gång, scanLine() i trådarna skulle anropa detach() samtidigt
+    uchar* bits = dst.bits();
+    const qsizetype bpl = dst.bytesPerLine();
+    forRows(rect, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            uint* d = reinterpret_cast<uint*>(bits + y * bpl) + rect.left();
+            const uint* s = reinterpret_cast<const uint*>(src.constScanLine(y)) + rect.left();
+            const uchar* a = alpha.constScanLine(y - rect.top());
+            for (int x = 0; x < rect.width(); x++) {
+                // Masken är mest helt av eller på, de fallen slipper multiplikationerna
+                if (a[x] == 0) continue;
+                d[x] = a[x] == 255 ? s[x] : interpolate255(s[x], a[x], d[x], 255 - a[x]);
+            }
+        }
+    });
+}
+
+void MaskLayer::multiply(QImage& dst, const QImage& src, const QImage& alpha, const QRect& rect)
+{
+    if (!blendable(dst) || !blendable(src) || alpha.format() != QImage::Format_Alpha8 || alpha.size() != rect.size()) return;
+    uchar* bits = dst.bits();
+    const qsizetype bpl = dst.bytesPerLine();
+    forRows(rect, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            uint* d = reinterpret_cast<uint*>(bits + y * bpl) + rect.left();
+            const uint* s = reinterpret_cast<const uint*>(src.constScanLine(y)) + rect.left();
+            const uchar* a = alpha.constScanLine(y - rect.top());
+            for (int x = 0; x < rect.width(); x++) {
+                d[x] = a[x] == 0 ? 0 : a[x] == 255 ? s[x] : byteMul(s[x], a[x]);
+            }
+        }
+    });
+}
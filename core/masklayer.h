@@ -0,0 +1,54 @@
+#ifndef MASKLAYER_H
+#define MASKLAYER_H
+
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+
+// Projektets mask, 8 bitar per pixel i rutor om tileSize x tileSize. 0 visar
+// efterbilden, 255 förebilden. Rutor som aldrig målats lagras inte, och en
+// penseldrag rör bara de rutor det täcker. Masken har förebildens proportioner
+// men högst maxSide pixlar på längsta sidan, den samplas bilinjärt uppåt.
+
+class MaskLayer
+{
+public:
+    static constexpr int tileSize = 256;
+    static constexpr int maxSide = 4096;
+
+    MaskLayer() {}
+    MaskLayer(const QSize& size);
+    bool isNull() const { return m_Size.isEmpty(); }
+    bool isEmpty() const;
+    QSize size() const { return m_Size; }
+    // Maskens storlek för en förebild av storleken imageSize
+    static QSize maskSize(const QSize& imageSize) {
+        return imageSize.width() > maxSide || imageSize.height() > maxSide ? imageSize.scaled(maxSide, maxSide, Qt::KeepAspectRatio) : imageSize;
+    }
+
+    // Mjuk pensel i maskkoordinater. hardness är den del av radien som har full
+    // täckning, flow hur mycket ett drag lägger på (0..1). Returnerar ändrat område.
+    QRect stroke(const QPointF& center, qreal radius, qreal hardness, qreal flow, bool erase);
+    void clear() { m_Tiles.fill(QByteArray()); }
+
+    // Fyller alpha (Format_Alpha8) med masken samplad bilinjärt. Pixel (x, y) i alpha
+    // motsvarar punkten origin + (x, y) i en bild som är 1 / scale gånger maskens storlek.
+    void sample(QImage& alpha, const QPointF& origin, qreal scale) const;
+
+    bool save(const QString& path) const;
+    bool load(const QString& path);
+    static QString newPath();
+
+    // dst = src * a + dst * (1 - a) inom rect, alpha täcker rect
+    static void blend(QImage& dst, const QImage& src, const QImage& alpha, const QRect& rect);
+    // dst = src * a inom rect (förmultiplicerat), alpha täcker rect
+    static void multiply(QImage& dst, const QImage& src, const QImage& alpha, const QRect& rect);
+private:
+    void fetchRow(int y, int x0, int x1, uchar* out) const;
+    int m_Columns = 0;
+    int m_Rows = 0;
+    QSize m_Size;
+    QVector<QByteArray> m_Tiles; // tom ruta = noll
+};
+
+#endif // MASKLAYER_H
@@ -0,0 +1,388 @@
+#include "previewserver.h"
+#include "gallerywriter.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QLocale>
+#include <QDebug>
+
+static const qint64 chunkSize = 256 * 1024;
+static const int maxHeader = 64 * 1024;
+
+static QByteArray reason(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 206: return "Partial Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 416: return "Range Not Satisfiable";
+    }
+    return "Error";
+}
+
+static QByteArray contentType(const QString& name)
+{
+    static const QHash<QString,QByteArray> types = {
+        { "html", "text/html; charset=utf-8" }, { "json", "application/json" }, { "js", "text/javascript" },
+        { "css", "text/css" }, { "txt", "text/plain; charset=utf-8" }, { "xml", "application/xml" },
+        { "dzi", "application/xml" }, { "svg", "image/svg+xml" }, { "jpg", "image/jpeg" },
+        { "jpeg", "image/jpeg" }, { "png", "image/png" }, { "webp", "image/webp" },
+        { "avi", "video/x-msvideo" }, { "mp4", "video/mp4" } };
+    return types.value(QFileInfo(name).suffix().toLower(), "application/octet-stream");
+}
+
+static QByteArray httpDate(const QDateTime& t)
+{
+    return QLocale::c().toString(t.toUTC(), "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1();
+}
+
+// Kodningarna i Accept-Encoding, utan dem som har q=0
+static QStringList acceptedEncodings(const QByteArray& header)
+{
+    QStringList result;
+    for (const QByteArray& part : header.split(',')) {
+        const QList<QByteArray> fields = part.split(';');
+        const QByteArray coding = fields.first().trimmed().toLower();
+        bool refused = false;
+        for (int i = 1; i < fields.size(); i++) {
+            const QByteArray f = fields[i].trimmed();
+            if (f.startsWith("q=") && f.mid(2).toDouble() == 0) refused = true;
+        }
+        if (!refused && !coding.isEmpty()) result << QString::fromLatin1(coding);
+    }
+    return result;
+}
+
+// "bytes=a-b", "bytes=a-" eller "bytes=-n". 1 med intervallet i from och to,
+// -1 om det ligger utanför filen, 0 om huvudet inte följs (hela filen skickas).
+static int parseRange(const QByteArray& header, quint64 size, quint64* from, quint64* to)
+{
+    // Flera intervall stöds inte
+    if (!header.startsWith("bytes=") || header.contains(',')) return 0;
+    const QByteArray spec = header.mid(6).trimmed();
+    const int dash = spec.indexOf('-');
+    if (dash < 0) return 0;
+    const QByteArray first = spec.left(dash).trimmed();
+    const QByteArray last = spec.mid(dash + 1).trimmed();
+    bool ok = true;
+    if (first.isEmpty()) {
+        const quint64 n = last.toULongLong(&ok);
+        if (!ok) return 0;
+        if (n == 0 || size == 0) return -1;
+        *from = size - qMin(n, size);
+        *to = size - 1;
+        return 1;
+    }
+    *from = first.toULongLong(&ok);
+    if (!ok) return 0;
+    if (last.isEmpty()) {
+        *to = size - 1;
+    } else {
+        *to = last.toULongLong(&ok);
+        if (!ok) return 0;
+    }
+    if (*from >= size || *from > *to) return -1;
+    *to = qMin(*to, size - 1);
+    return 1;
+}
+
+QString PreviewServer::Request::toString() const
+{
+    QString s = QString("+%1 ms\t").arg(started) + method + " " + path + QString("\t%1\t%2 B").arg(status).arg(bytes);
+    if (!encoding.isEmpty()) s += " " + encoding;
+    return s + QString("\t%1 ms").arg(elapsed);
+}
+
+PreviewServer::PreviewServer(QObject* parent) : QObject(parent)
+{
+    connect(&m_Server, &QTcpServer::newConnection, this, &PreviewServer::accept);
+}
+
+bool PreviewServer::start(const QString& root, quint16 port)
+{
+    stop();
+    const QFileInfo info(root);
+    m_Archived = info.isFile();
+    if (m_Archived ? !m_Archive.open(root) : !info.isDir()) {
+        qWarning() << "PreviewServer: no gallery at" << root;
+        return false;
+    }
+    m_Root = info.absoluteFilePath();
+    // Bara loopback, förhandsvisningen ska inte synas på nätet
+    if (!m_Server.listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "PreviewServer:" << m_Server.errorString();
+        return false;
+    }
+    m_Page.start();
+    m_PageRequests = 0;
+    m_PageBytes = 0;
+    return true;
+}
+
+void PreviewServer::stop()
+{
+    m_Server.close();
+    for (QTcpSocket* socket : (const QList<QTcpSocket*>)m_Connections.keys()) {
+        delete m_Connections.take(socket).file;
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+}
+
+QUrl PreviewServer::url() const
+{
+    return QUrl(QString("http://127.0.0.1:%1/").arg(m_Server.serverPort()));
+}
+
+void PreviewServer::accept()
+{
+    while (QTcpSocket* socket = m_Server.nextPendingConnection()) {
+        m_Connections.insert(socket, Connection());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { readRequest(socket); });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]() { pump(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            delete m_Connections.take(socket).file;
+            socket->deleteLater();
+        });
+    }
+}
+
+void PreviewServer::readRequest(QTcpSocket* socket)
+{
+    if (!m_Connections.contains(socket)) return;
+    Connection& c = m_Connections[socket];
+    c.buffer += socket->readAll();
+    // En begäran i taget, nästa behandlas när svaret är skickat
+    if (c.busy) return;
+    const int end = int(c.buffer.indexOf("\r\n\r\n"));
+    if (end < 0 && c.buffer.size() <= maxHeader) return;
+    c.busy = true;
+    c.timer.start();
+    c.request = Request();
+    c.request.started = m_Page.elapsed();
+    if (end < 0) {
+        c.keepAlive = false;
+        sendStatus(socket, c, 400);
+        return;
+    }
+    const QList<QByteArray> lines = c.buffer.left(end).split('\n');
+    c.buffer.remove(0, end + 4);
+    QHash<QByteArray,QByteArray> headers;
+    for (int i = 1; i < lines.size(); i++) {
+        const int colon = int(lines[i].indexOf(':'));
+        if (colon > 0) headers.insert(lines[i].left(colon).trimmed().toLower(), lines[i].mid(colon + 1).trimmed());
+    }
+    const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() != 3) {
+        c.keepAlive = false;
+        sendStatus(socket, c, 400);
+        return;
+    }
+    const QByteArray connection = headers.value("connection").toLower();
+    c.keepAlive = requestLine[2] == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+    respond(socket, c, requestLine[0], QString::fromLatin1(requestLine[1]), headers);
+}
+
+void PreviewServer::respond(QTcpSocket* socket, Connection& c, const QByteArray& method, const QString& target,
+                            const QHash<QByteArray,QByteArray>& headers)
+{
+    const QString path = QUrl::fromPercentEncoding(target.section('?', 0, 0).toLatin1());
+    c.request.method = QString::fromLatin1(method);
+    c.request.path = path;
+    if (method != "GET" && method != "HEAD") {
+        // Eventuell kropp läses inte, förbindelsen stängs
+        c.keepAlive = false;
+        sendStatus(socket, c, 405, "Allow: GET, HEAD\r\n");
+        return;
+    }
+    // Sökvägen får inte gå ut ur roten. \ och : är avgränsare och enheter på Windows.
+    QStringList parts;
+    for (const QString& part : path.split('/', Qt::SkipEmptyParts)) {
+        if (part == ".." || part.contains('\\') || part.contains(':') || part.contains(QChar(0))) {
+            sendStatus(socket, c, 400);
+            return;
+        }
+        if (part != ".") parts << part;
+    }
+    Resource r;
+    if (!find(parts.join('/'), &r)) {
+        sendStatus(socket, c, 404);
+        return;
+    }
+    if (r.name == "index.html") {
+        // Sidan laddas om, tider och byte räknas härifrån
+        m_Page.restart();
+        m_PageRequests = 0;
+        m_PageBytes = 0;
+        c.request.started = 0;
+    }
+
+    QByteArray extra = "Accept-Ranges: bytes\r\n";
+    extra += GalleryWriter::isContentNamed(r.name) ? "Cache-Control: public, max-age=31536000, immutable\r\n" : "Cache-Control: no-cache\r\n";
+    // Förkomprimerad variant när klienten tar emot den och inget intervall begärs,
+    // samma regel som ett webbhotell med förkomprimerade filer
+    const QByteArray range = headers.value("range");
+    const QStringList accepted = acceptedEncodings(headers.value("accept-encoding"));
+    Resource body = r;
+    bool variants = false;
+    for (const QPair<QString,QString>& v : { qMakePair(QString("br"), QString(".br")), qMakePair(QString("gzip"), QString(".gz")) }) {
+        Resource variant;
+        if (!find(r.name + v.second, &variant)) continue;
+        variants = true;
+        if (range.isEmpty() && c.request.encoding.isEmpty() && accepted.contains(v.first)) {
+            body = variant;
+            c.request.encoding = v.first;
+        }
+    }
+    if (variants) extra += "Vary: Accept-Encoding\r\n";
+    if (!c.request.encoding.isEmpty()) extra += "Content-Encoding: " + c.request.encoding.toLatin1() + "\r\n";
+    const QByteArray etag = body.etag.toLatin1();
+    extra += "ETag: " + etag + "\r\nLast-Modified: " + httpDate(body.modified) + "\r\n";
+
+    const QByteArray match = headers.value("if-none-match");
+    if (!match.isEmpty()) {
+        bool matched = match == "*";
+        for (const QByteArray& tag : match.split(',')) {
+            const QByteArray t = tag.trimmed();
+            if (t == etag || t == "W/" + etag) matched = true;
+        }
+        if (matched) {
+            sendStatus(socket, c, 304, extra);
+            return;
+        }
+    }
+
+    int status = 200;
+    quint64 from = 0;
+    quint64 to = body.size > 0 ? body.size - 1 : 0;
+    const QByteArray ifRange = headers.value("if-range");
+    if (!range.isEmpty() && (ifRange.isEmpty() || ifRange == etag)) {
+        const int parsed = parseRange(range, body.size, &from, &to);
+        if (parsed < 0) {
+            sendStatus(socket, c, 416, extra + "Content-Range: bytes */" + QByteArray::number(body.size) + "\r\n");
+            return;
+        }
+        if (parsed > 0) {
+            status = 206;
+            extra += "Content-Range: bytes " + QByteArray::number(from) + "-" + QByteArray::number(to) + "/" + QByteArray::number(body.size) + "\r\n";
+        }
+    }
+    const quint64 length = body.size > 0 ? to - from + 1 : 0;
+    const bool sendBody = method == "GET" && length > 0;
+    QFile* file = nullptr;
+    if (sendBody && !body.file.isEmpty()) {
+        file = new QFile(body.file);
+        if (!file->open(QIODevice::ReadOnly) || !file->seek(qint64(from))) {
+            qWarning() << "PreviewServer: cannot read" << body.file;
+            delete file;
+            sendStatus(socket, c, 404);
+            return;
+        }
+    }
+
+    c.request.status = status;
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(status) + " " + reason(status) + "\r\n";
+    head += "Content-Type: " + contentType(r.name) + "\r\nContent-Length: " + QByteArray::number(length) + "\r\n";
+    head += extra;
+    head += c.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    socket->write(head);
+    if (!sendBody) return;
+    c.request.bytes = qint64(length);
+    if (!file) {
+        socket->write(m_Archive.read(body.name, from, qint64(length)));
+        return;
+    }
+    c.file = file;
+    c.remaining = length;
+    pump(socket);
+}
+
+void PreviewServer::sendStatus(QTcpSocket* socket, Connection& c, int status, const QByteArray& extraHeaders)
+{
+    c.request.status = status;
+    const QByteArray text = QByteArray::number(status) + " " + reason(status);
+    QByteArray head = "HTTP/1.1 " + text + "\r\n" + extraHeaders;
+    QByteArray body;
+    if (status != 304) {
+        body = c.request.method == "HEAD" ? QByteArray() : text + "\n";
+        head += "Content-Type: text/plain\r\nContent-Length: " + QByteArray::number(text.size() + 1) + "\r\n";
+    }
+    head += c.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    c.request.bytes = body.size();
+    socket->write(head + body);
+}
+
+void PreviewServer::pump(QTcpSocket* socket)
+{
+    const auto it = m_Connections.find(socket);
+    if (it == m_Connections.end() || !it->busy) return;
+    Connection& c = *it;
+    // Högst två bitar väntar i socketen, resten läses när de är skickade
+    while (c.file && c.remaining > 0 && socket->bytesToWrite() < 2 * chunkSize) {
+        const QByteArray data = c.file->read(qMin<qint64>(chunkSize, qint64(c.remaining)));
+        if (data.isEmpty()) {
+            // Filen krympte, Content-Length går inte att hålla
+            qWarning() << "PreviewServer: short read" << c.file->fileName();
+            c.keepAlive = false;
+            c.remaining = 0;
+            break;
+        }
+        socket->write(data);
+        c.remaining -= quint64(data.size());
+    }
+    if (c.remaining == 0 && socket->bytesToWrite() == 0) finish(socket, c);
+}
+
+void PreviewServer::finish(QTcpSocket* socket, Connection& c)
+{
+    delete c.file;
+    c.file = nullptr;
+    c.busy = false;
+    c.request.elapsed = c.timer.elapsed();
+    m_PageRequests++;
+    m_PageBytes += c.request.bytes;
+    const Request request = c.request;
+    const bool keepAlive = c.keepAlive;
+    emit served(request);
+    if (!m_Connections.contains(socket)) return;
+    if (!keepAlive) {
+        socket->disconnectFromHost();
+        return;
+    }
+    // Nästa begäran kan redan ligga i bufferten
+    readRequest(socket);
+}
+
+bool PreviewServer::find(const QString& name, Resource* resource)
+{
+    if (m_Archived) {
+        QString n = name;
+        if (!m_Archive.contains(n)) n = n.isEmpty() ? "index.html" : n + "/index.html";
+        if (!m_Archive.contains(n)) return false;
+        const ArchiveReader::Entry e = m_Archive.entry(n);
+        resource->name = n;
+        resource->file.clear();
+        resource->size = e.size;
+        resource->modified = e.modified;
+        // ZIP har CRC:n, TAR bara storlek och tid
+        resource->etag = e.crc ? QString("\"%1-%2\"").arg(e.crc, 8, 16, QChar('0')).arg(e.size, 0, 16)
+                               : QString("\"%1-%2\"").arg(e.size, 0, 16).arg(e.modified.toSecsSinceEpoch(), 0, 16);
+        return true;
+    }
+    const QDir root(m_Root);
+    QFileInfo info(name.isEmpty() ? m_Root : root.filePath(name));
+    if (info.isDir()) info.setFile(QDir(info.filePath()).filePath("index.html"));
+    if (!info.isFile()) return false;
+    // Den upplösta sökvägen, även genom länkar, måste ligga under roten
+    if (!info.canonicalFilePath().startsWith(QDir(m_Root).canonicalPath() + '/')) return false;
+    resource->name = root.relativeFilePath(info.filePath());
+    resource->file = info.filePath();
+    resource->size = quint64(info.size());
+    resource->modified = info.lastModified();
+    resource->etag = QString("\"%1-%2\"").arg(info.size(), 0, 16).arg(info.lastModified().toMSecsSinceEpoch(), 0, 16);
+    return true;
+}
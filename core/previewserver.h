@@ -0,0 +1,83 @@
+#ifndef PREVIEWSERVER_H
+#define PREVIEWSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QHash>
+#include <QUrl>
+#include "archivereader.h"
+
+// HTTP-server på loopback för att förhandsvisa ett exporterat galleri som det
+// beter sig på ett webbhotell. Roten är en exportmapp eller ett .zip/.tar-paket
+// (läses utan att packas upp). GET och HEAD med ETag/If-None-Match, ett
+// intervall per Range-begäran, och förkomprimerade .br/.gz-filer när klienten
+// tar emot dem. Innehållsnamn cachas för alltid, resten valideras om.
+// Varje svar meddelas med served(), med tid och byte räknat från senaste
+// sidladdning, så att sidans vikt och tiden till första paret kan mätas.
+// Filer ur mappar strömmas i bitar, poster ur paket läses hela.
+
+class PreviewServer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Request {
+        QString method;
+        QString path;
+        int status = 0;
+        QString encoding;   // br, gzip eller tomt
+        qint64 bytes = 0;   // kroppens byte
+        qint64 started = 0; // ms efter sidladdningen
+        qint64 elapsed = 0; // ms från begäran till sista byte
+        QString toString() const;
+    };
+    PreviewServer(QObject* parent = nullptr);
+    // port 0 väljer en ledig port
+    bool start(const QString& root, quint16 port = 0);
+    void stop();
+    bool isListening() const { return m_Server.isListening(); }
+    QUrl url() const;
+    // Sedan senaste begäran av sidan
+    int pageRequests() const { return m_PageRequests; }
+    qint64 pageBytes() const { return m_PageBytes; }
+signals:
+    void served(const PreviewServer::Request& request);
+private:
+    // En fil eller arkivpost som svaret kommer ur
+    struct Resource {
+        QString name;       // relativ sökväg i roten
+        QString file;       // på disk, tom för arkivposter
+        quint64 size = 0;
+        QDateTime modified;
+        QString etag;
+    };
+    struct Connection {
+        QByteArray buffer;
+        bool busy = false;
+        bool keepAlive = true;
+        QFile* file = nullptr;  // kroppen som återstår att strömma
+        quint64 remaining = 0;
+        QElapsedTimer timer;
+        Request request;
+    };
+    void accept();
+    void readRequest(QTcpSocket* socket);
+    void respond(QTcpSocket* socket, Connection& c, const QByteArray& method, const QString& target,
+                 const QHash<QByteArray,QByteArray>& headers);
+    void sendStatus(QTcpSocket* socket, Connection& c, int status, const QByteArray& extraHeaders = QByteArray());
+    void pump(QTcpSocket* socket);
+    void finish(QTcpSocket* socket, Connection& c);
+    bool find(const QString& name, Resource* resource);
+    QString m_Root;
+    bool m_Archived = false;
+    ArchiveReader m_Archive;
+    QTcpServer m_Server;
+    QHash<QTcpSocket*,Connection> m_Connections;
+    QElapsedTimer m_Page;
+    int m_PageRequests = 0;
+    qint64 m_PageBytes = 0;
+};
+
+#endif // PREVIEWSERVER_H
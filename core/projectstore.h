@@ -0,0 +1,34 @@
+#ifndef PROJECTSTORE_H
+#define PROJECTSTORE_H
+
+#include <QSettings>
+#include <QMap>
+#include <QVariant>
+
+// Projektlistan i inställningarna, delas av fönstret och den fönsterlösa körningen
+
+struct ProjectStore
+{
+    static QList<QMap<QString,QVariant>> load(QSettings& s) {
+        QList<QMap<QString,QVariant>> projects;
+        int size = s.beginReadArray("Projects");
+        for (int i = 0; i < size; i++)
+        {
+            s.setArrayIndex(i);
+            projects.append(s.value("Project").toMap());
+        }
+        s.endArray();
+        return projects;
+    }
+    static void save(QSettings& s, const QList<QMap<QString,QVariant>>& projects) {
+        s.beginWriteArray("Projects");
+        for (int i = 0; i < projects.size(); i++)
+        {
+            s.setArrayIndex(i);
+            s.setValue("Project",projects[i]);
+        }
+        s.endArray();
+    }
+};
+
+#endif // PROJECTSTORE_H
@@ -0,0 +1,61 @@
+#ifndef PROJECTVALUES_H
+#define PROJECTVALUES_H
+
+#include <QMap>
+#include <QVariant>
+#include <QTransform>
+#include <qmath.h>
+
+// Värden som räknas fram ur en projektpost, för kod utanför MainWindow
+// (miniatyrer, förhämtning) som arbetar på kopior av posten.
+
+struct ProjectValues
+{
+    static QTransform afterTransform(const QMap<QString,QVariant>& p) {
+        QTransform t;
+        t.translate(p.value("HTranslate").toDouble(), p.value("VTranslate").toDouble());
+        t.shear(p.value("HShear").toDouble(), p.value("VShear").toDouble());
+        t.scale(p.value("HScale").toDouble(), p.value("VScale").toDouble());
+        t.rotate(p.value("XRotate").toDouble(), Qt::XAxis);
+        t.rotate(p.value("YRotate").toDouble(), Qt::YAxis);
+        t.rotate(p.value("Rotate").toDouble(), Qt::ZAxis);
+        // Perspektivet verkar först, i efterbildens koordinater
+        const QTransform perspective(1, 0, p.value("HPerspective").toDouble(), 0, 1, p.value("VPerspective").toDouble(), 0, 0, 1);
+        return perspective * t;
+    }
+    // Delar t = perspective * affine, perspective har bara m13 och m23
+    static void splitPerspective(const QTransform& t, QTransform* perspective, QTransform* affine) {
+        const double w = t.m33() != 0 ? t.m33() : 1;
+        const double p1 = t.m13() / w;
+        const double p2 = t.m23() / w;
+        const double dx = t.dx() / w;
+        const double dy = t.dy() / w;
+        if (perspective) *perspective = QTransform(1, 0, p1, 0, 1, p2, 0, 0, 1);
+        if (affine) *affine = QTransform(t.m11() / w - p1 * dx, t.m12() / w - p1 * dy,
+                                         t.m21() / w - p2 * dx, t.m22() / w - p2 * dy, dx, dy);
+    }
+    // Perspektivet bryts ut först, resten delas upp i förflyttning, rotation, skala och skjuvning
+    static void setAfterTransform(QMap<QString,QVariant>& p, const QTransform& h) {
+        QTransform perspective;
+        QTransform t;
+        splitPerspective(h, &perspective, &t);
+        const double rotationRad = qAtan2(t.m12(), t.m11());
+        QTransform pure = QTransform(t).rotateRadians(-rotationRad);
+        const double scaleX = pure.m11();
+        const double scaleY = pure.m22();
+        pure = QTransform(pure).scale(1.0/scaleX,1.0/scaleY);
+        p.insert("HTranslate", t.dx());
+        p.insert("VTranslate", t.dy());
+        p.insert("Rotate", qRadiansToDegrees(rotationRad));
+        p.insert("HScale", scaleX);
+        p.insert("VScale", scaleY);
+        p.insert("HShear", pure.m21());
+        p.insert("VShear", pure.m12());
+        p.insert("XRotate", 0);
+        p.insert("YRotate", 0);
+        p.insert("HPerspective", perspective.m13());
+        p.insert("VPerspective", perspective.m23());
+    }
+};
+
+#endif // PROJECTVALUES_H
@@ -0,0 +1,179 @@
+#include "remaplut.h"
+#include <QCache>
+#include <QMutex>
+#include <QtConcurrent>
+#include <QDebug>
+#include <qmath.h>
+
+// Pixeltyperna remapRows arbetar direkt i, 8 eller 16 bitar per kanal
+struct Pixel32
+{
+    typedef QRgb Type;
+    static constexpr uint max = 255;
+    static uint red(QRgb p) { return qRed(p); }
+    static uint green(QRgb p) { return qGreen(p); }
+    static uint blue(QRgb p) { return qBlue(p); }
+    static uint alpha(QRgb p) { return qAlpha(p); }
+    static QRgb make(uint r, uint g, uint b, uint a) { return qRgba(int(r), int(g), int(b), int(a)); }
+};
+
+struct Pixel64
+{
+    typedef QRgba64 Type;
+    static constexpr uint max = 65535;
+    static uint red(QRgba64 p) { return p.red(); }
+    static uint green(QRgba64 p) { return p.green(); }
+    static uint blue(QRgba64 p) { return p.blue(); }
+    static uint alpha(QRgba64 p) { return p.alpha(); }
+    static QRgba64 make(uint r, uint g, uint b, uint a) { return QRgba64::fromRgba64(quint16(r), quint16(g), quint16(b), quint16(a)); }
+};
+
+RemapLut::RemapLut(const QRect& outputRect, const Mapping& map, int step)
+    : m_Rect(outputRect), m_Step(step)
+{
+    if (outputRect.isEmpty()) return;
+    m_Columns = (outputRect.width() + step - 1) / step + 1;
+    m_Rows = (outputRect.height() + step - 1) / step + 1;
+    m_Nodes.resize(m_Columns * m_Rows * 2);
+    const qreal limit = qreal(1 << 22);
+    for (int j = 0, i = 0; j < m_Rows; ++j) {
+        for (int k = 0; k < m_Columns; ++k, ++i) {
+            QPointF s;
+            const QPointF o(outputRect.left() + k * step + 0.5, outputRect.top() + j * step + 0.5);
+            if (map(o, s) && qAbs(s.x()) < limit && qAbs(s.y()) < limit) {
+                // Pixelcentrum -> pixelindex, 8 bitars bråkdel
+                m_Nodes[i * 2] = qint32(qFloor((s.x() - 0.5) * 256 + 0.5));
+                m_Nodes[i * 2 + 1] = qint32(qFloor((s.y() - 0.5) * 256 + 0.5));
+            } else {
+                m_Nodes[i * 2] = invalidNode;
+                m_Nodes[i * 2 + 1] = invalidNode;
+            }
+        }
+    }
+}
+
+QRect RemapLut::sourceRect(const QRect& rect, const QRect& clip) const
+{
+    const QRect r = rect.intersected(m_Rect);
+    if (r.isEmpty()) return QRect();
+    const int k0 = (r.left() - m_Rect.left()) / m_Step;
+    const int k1 = qMin(m_Columns - 1, (r.right() - m_Rect.left()) / m_Step + 1);
+    const int j0 = (r.top() - m_Rect.top()) / m_Step;
+    const int j1 = qMin(m_Rows - 1, (r.bottom() - m_Rect.top()) / m_Step + 1);
+    qint32 x0 = std::numeric_limits<qint32>::max(), y0 = x0;
+    qint32 x1 = std::numeric_limits<qint32>::min(), y1 = x1;
+    for (int j = j0; j <= j1; ++j) {
+        for (int k = k0; k <= k1; ++k) {
+            const int i = j * m_Columns + k;
+            if (!nodeValid(i)) continue;
+            x0 = qMin(x0, m_Nodes[i * 2]);
+            x1 = qMax(x1, m_Nodes[i * 2]);
+            y0 = qMin(y0, m_Nodes[i * 2 + 1]);
+            y1 = qMax(y1, m_Nodes[i * 2 + 1]);
+        }
+    }
+    if (x0 > x1) return QRect();
+    return QRect(QPoint((x0 >> 8) - 2, (y0 >> 8) - 2), QPoint((x1 >> 8) + 3, (y1 >> 8) + 3)).intersected(clip);
+}
+
+void RemapLut::remap(const QImage& source, const QPoint& sourceOrigin, QImage& dst, const QPoint& dstOrigin,
+                     const QRgb* background) const
+{
+    const QRect area = QRect(dstOrigin, dst.size()).intersected(m_Rect);
+    if (area.isEmpty()) return;
+    const bool deep = source.depth() == 64;
+    if (deep != (dst.depth() == 64)) {
+        qWarning() << "RemapLut: source and destination depth differ" << source.format() << dst.format();
+        return;
+    }
+    // Loss från delad data en gång, trådarna skriver direkt i minnet utan scanLine()
+    uchar* bits = dst.bits();
+    const qsizetype bytesPerLine = dst.bytesPerLine();
+    // Rader i block om 64 fördelas på trådpoolen
+    QList<QRect> parts;
+    for (int y = area.top(); y <= area.bottom(); y += 64) parts << QRect(area.left(), y, area.width(), qMin(64, area.bottom() + 1 - y));
+    QtConcurrent::blockingMap(parts, [&](const QRect& part) {
+        if (deep) remapRows<Pixel64>(source, sourceOrigin, bits, bytesPerLine, dstOrigin, background, part);
+        else remapRows<Pixel32>(source, sourceOrigin, bits, bytesPerLine, dstOrigin, background, part);
+    });
+}
+
+template <typename Pixel>
+void RemapLut::remapRows(const QImage& source, const QPoint& sourceOrigin, uchar* bits, qsizetype bytesPerLine, const QPoint& dstOrigin,
+                         const QRgb* background, const QRect& area) const
+{
+    typedef typename Pixel::Type P;
+    const int sw = source.width();
+    const int sh = source.height();
+    const qint32 ox = sourceOrigin.x() * 256;
+    const qint32 oy = sourceOrigin.y() * 256;
+    auto fetch = [&](int x, int y) -> P {
+        if (x < 0 || y < 0 || x >= sw || y >= sh) return Pixel::make(0, 0, 0, 0);
+        return reinterpret_cast<const P*>(source.constScanLine(y))[x];
+    };
+    // Vikterna summerar till 65536, summorna ryms i 32 bitar utan tecken även vid 16 bitar per kanal
+    const uint max = Pixel::max;
+    const uint bgR = background ? uint(qRed(*background)) * max / 255 : 0;
+    const uint bgG = background ? uint(qGreen(*background)) * max / 255 : 0;
+    const uint bgB = background ? uint(qBlue(*background)) * max / 255 : 0;
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        P* line = reinterpret_cast<P*>(bits + (y - dstOrigin.y()) * bytesPerLine);
+        const int j = (y - m_Rect.top()) / m_Step;
+        const int fy = (y - m_Rect.top()) % m_Step;
+        for (int tileLeft = area.left(); tileLeft <= area.right();) {
+            const int k = (tileLeft - m_Rect.left()) / m_Step;
+            const int tileRight = qMin(area.right(), m_Rect.left() + (k + 1) * m_Step - 1);
+            const int n00 = j * m_Columns + k;
+            const int n01 = n00 + m_Columns;
+            if (!nodeValid(n00) || !nodeValid(n00 + 1) || !nodeValid(n01) || !nodeValid(n01 + 1)) {
+                tileLeft = tileRight + 1;
+                continue;
+            }
+            // Vänster och höger kant av rutan på den här raden, sedan linjärt längs raden
+            const qint64 lx = m_Nodes[n00 * 2] + qint64(m_Nodes[n01 * 2] - m_Nodes[n00 * 2]) * fy / m_Step;
+            const qint64 ly = m_Nodes[n00 * 2 + 1] + qint64(m_Nodes[n01 * 2 + 1] - m_Nodes[n00 * 2 + 1]) * fy / m_Step;
+            const qint64 rx = m_Nodes[n00 * 2 + 2] + qint64(m_Nodes[n01 * 2 + 2] - m_Nodes[n00 * 2 + 2]) * fy / m_Step;
+            const qint64 ry = m_Nodes[n00 * 2 + 3] + qint64(m_Nodes[n01 * 2 + 3] - m_Nodes[n00 * 2 + 3]) * fy / m_Step;
+            const int fx0 = (tileLeft - m_Rect.left()) % m_Step;
+            for (int x = tileLeft, fx = fx0; x <= tileRight; ++x, ++fx) {
+                const qint32 u = qint32(lx + (rx - lx) * fx / m_Step) - ox;
+                const qint32 v = qint32(ly + (ry - ly) * fx / m_Step) - oy;
+                const int x0 = u >> 8;
+                const int y0 = v >> 8;
+                if (x0 < -1 || y0 < -1 || x0 >= sw || y0 >= sh) continue;
+                const uint wx = u & 255;
+                const uint wy = v & 255;
+                const uint w00 = (256 - wx) * (256 - wy), w10 = wx * (256 - wy);
+                const uint w01 = (256 - wx) * wy, w11 = wx * wy;
+                const P p00 = fetch(x0, y0), p10 = fetch(x0 + 1, y0);
+                const P p01 = fetch(x0, y0 + 1), p11 = fetch(x0 + 1, y0 + 1);
+                const uint a = (Pixel::alpha(p00) * w00 + Pixel::alpha(p10) * w10 + Pixel::alpha(p01) * w01 + Pixel::alpha(p11) * w11 + 32768) >> 16;
+                if (a == 0) continue;
+                const uint r = (Pixel::red(p00) * w00 + Pixel::red(p10) * w10 + Pixel::red(p01) * w01 + Pixel::red(p11) * w11 + 32768) >> 16;
+                const uint g = (Pixel::green(p00) * w00 + Pixel::green(p10) * w10 + Pixel::green(p01) * w01 + Pixel::green(p11) * w11 + 32768) >> 16;
+                const uint b = (Pixel::blue(p00) * w00 + Pixel::blue(p10) * w10 + Pixel::blue(p01) * w01 + Pixel::blue(p11) * w11 + 32768) >> 16;
+                if (background) {
+                    // Förmultiplicerad källa över bakgrunden
+                    const uint ia = max - a;
+                    line[x - dstOrigin.x()] = Pixel::make(qMin(max, r + (bgR * ia + max / 2) / max),
+                                                          qMin(max, g + (bgG * ia + max / 2) / max),
+                                                          qMin(max, b + (bgB * ia + max / 2) / max), max);
+                } else {
+                    line[x - dstOrigin.x()] = Pixel::make(r, g, b, a);
+                }
+            }
+            tileLeft = tileRight + 1;
+        }
+    }
+}
+
+QSharedPointer<const RemapLut> RemapLut::cached(const QString& key, const QRect& outputRect, const Mapping& map, int step)
+{
+    static QMutex mutex;
+    static QCache<QString, QSharedPointer<const RemapLut>> cache(8);
+    QMutexLocker locker(&mutex);
+    if (QSharedPointer<const RemapLut>* hit = cache.object(key)) return *hit;
+    QSharedPointer<const RemapLut> lut(new RemapLut(outputRect, map, step));
+    cache.insert(key, new QSharedPointer<const RemapLut>(lut));
+    return lut;
+}
@@ -0,0 +1,49 @@
+#ifndef REMAPLUT_H
+#define REMAPLUT_H
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include <QSharedPointer>
+#include <functional>
+#include <limits>
+
+// Förberäknad omsamplingstabell. För ett glest rutnät av utdatapunkter (var
+// step:e pixel) lagras källkoordinaten i 24.8 fast punkt; mellan noderna
+// interpoleras linjärt per ruta. Godtyckliga avbildningar (linskorrigering,
+// projektiv transform eller båda) kostar därmed lika lite att sampla.
+
+class RemapLut
+{
+public:
+    // Avbildar utdatapunkt (pixelcentrum) på källpunkt, false om punkten saknar motsvarighet
+    typedef std::function<bool(const QPointF& out, QPointF& source)> Mapping;
+
+    RemapLut() {}
+    RemapLut(const QRect& outputRect, const Mapping& map, int step = 16);
+    bool isNull() const { return m_Nodes.isEmpty(); }
+    QRect outputRect() const { return m_Rect; }
+    // Källområdet som behövs för att fylla rect, inklusive marginal för interpolationen
+    QRect sourceRect(const QRect& rect, const QRect& clip) const;
+    // Samplar source (som täcker källområdet med origo sourceOrigin) bilinjärt in i dst
+    // (som täcker utdata från dstOrigin). Med background läggs resultatet över den
+    // färgen, annars skrivs förmultiplicerad ARGB med transparens utanför källan.
+    // Båda bilderna är antingen 32 bitar (ARGB32) eller 64 (RGBA64), utan konvertering.
+    void remap(const QImage& source, const QPoint& sourceOrigin, QImage& dst, const QPoint& dstOrigin,
+               const QRgb* background = nullptr) const;
+
+    static QSharedPointer<const RemapLut> cached(const QString& key, const QRect& outputRect, const Mapping& map, int step = 16);
+private:
+    template <typename Pixel>
+    void remapRows(const QImage& source, const QPoint& sourceOrigin, uchar* bits, qsizetype bytesPerLine, const QPoint& dstOrigin,
+                   const QRgb* background, const QRect& area) const;
+    bool nodeValid(int i) const { return m_Nodes[i * 2] != invalidNode; }
+    static constexpr qint32 invalidNode = std::numeric_limits<qint32>::min();
+    QRect m_Rect;
+    int m_Step = 16;
+    int m_Columns = 0;
+    int m_Rows = 0;
+    QVector<qint32> m_Nodes; // x,y per nod
+};
+
+#endif // REMAPLUT_H
@@ -0,0 +1,217 @@
+#include "scanfilter.h"
+#include <QtConcurrent>
+#include <qmath.h>
+#include <algorithm>
+
+static const int tileSize = 128;
+
+// Filtrets kärnor för en viss skala
+struct FilterParams
+{
+    int dustRadius = 0;
+    float threshold = 0;
+    float amount = 0;
+    QVector<float> kernel; // gaussvikter, 2r+1
+    int margin() const { return dustRadius + kernel.size() / 2; }
+};
+
+// Normaliserade gaussvikter ut till 3 sigma
+static QVector<float> gaussKernel(qreal sigma)
+{
+    const int r = qMax(1, qCeil(sigma * 3));
+    QVector<float> k(2 * r + 1);
+    float sum = 0;
+    for (int i = -r; i <= r; i++) {
+        k[i + r] = float(qExp(-i * i / (2 * sigma * sigma)));
+        sum += k[i + r];
+    }
+    for (float& v : k) v /= sum;
+    return k;
+}
+
+static inline float median3(float a, float b, float c)
+{
+    return qMax(qMin(a, b), qMin(qMax(a, b), c));
+}
+
+// Median längs rader (step 1) eller kolumner (step w) med fönstret 2r+1, kanten upprepas
+static void median1D(const float* in, float* out, int w, int h, int r, bool vertical)
+{
+    const int length = vertical ? h : w;
+    const int lines = vertical ? w : h;
+    const int step = vertical ? w : 1;
+    const int stride = vertical ? 1 : w;
+    QVector<float> window(2 * r + 1);
+    for (int l = 0; l < lines; l++) {
+        const float* src = in + l * stride;
+        float* dst = out + l * stride;
+        for (int i = 0; i < length; i++) {
+            if (r == 1) {
+                // Vanligast på proxyn, jämförelsenätet slipper sorteringen
+                dst[i * step] = median3(src[qMax(i - 1, 0) * step], src[i * step], src[qMin(i + 1, length - 1) * step]);
+                continue;
+            }
+            for (int k = -r; k <= r; k++) window[k + r] = src[qBound(0, i + k, length - 1) * step];
+            std::nth_element(window.begin(), window.begin() + r, window.end());
+            dst[i * step] = window[r];
+        }
+    }
+}
+
+// Separabel gauss. Yttre slingan över vikterna, den inre över en sammanhängande
+// rad, så att kompilatorn kan vektorisera den.
+static void gaussBlur(const float* in, float* out, float* temp, int w, int h, const QVector<float>& kernel)
+{
+    const int r = kernel.size() / 2;
+    QVector<float> padded(w + 2 * r);
+    for (int y = 0; y < h; y++) {
+        const float* src = in + y * w;
+        for (int x = 0; x < w + 2 * r; x++) padded[x] = src[qBound(0, x - r, w - 1)];
+        float* dst = temp + y * w;
+        std::fill(dst, dst + w, 0.0f);
+        for (int k = 0; k <= 2 * r; k++) {
+            const float c = kernel[k];
+            const float* p = padded.constData() + k;
+            for (int x = 0; x < w; x++) dst[x] += c * p[x];
+        }
+    }
+    for (int y = 0; y < h; y++) {
+        float* dst = out + y * w;
+        std::fill(dst, dst + w, 0.0f);
+        for (int k = 0; k <= 2 * r; k++) {
+            const float c = kernel[k];
+            const float* p = temp + qBound(0, y + k - r, h - 1) * w;
+            for (int x = 0; x < w; x++) dst[x] += c * p[x];
+        }
+    }
+}
+
+// Rutan tile filtreras ur source, med marginal för kärnorna, och skrivs till
+// bildminnet bits. Arbetstrådarna får inte röra QImage-objektet de skriver till.
+static void filterTile(const QImage& source, uchar* bits, qsizetype bytesPerLine, const QRect& tile,
+                       const FilterParams& params, bool deep, bool premultiplied)
+{
+    const int m = params.margin();
+    const QRect area = tile.adjusted(-m, -m, m, m).intersected(source.rect());
+    const int w = area.width();
+    const int h = area.height();
+    const int n = w * h;
+    const float unit = deep ? 65535.0f : 255.0f;
+    // Kanalplan i 0..1
+    QVector<float> planes[3];
+    for (QVector<float>& p : planes) p.resize(n);
+    for (int y = 0; y < h; y++) {
+        const uchar* line = source.constScanLine(area.top() + y);
+        float* r = planes[0].data() + y * w;
+        float* g = planes[1].data() + y * w;
+        float* b = planes[2].data() + y * w;
+        if (deep) {
+            const QRgba64* s = reinterpret_cast<const QRgba64*>(line) + area.left();
+            for (int x = 0; x < w; x++) {
+                r[x] = s[x].red() / unit;
+                g[x] = s[x].green() / unit;
+                b[x] = s[x].blue() / unit;
+            }
+        } else {
+            const QRgb* s = reinterpret_cast<const QRgb*>(line) + area.left();
+            for (int x = 0; x < w; x++) {
+                r[x] = qRed(s[x]) / unit;
+                g[x] = qGreen(s[x]) / unit;
+                b[x] = qBlue(s[x]) / unit;
+            }
+        }
+    }
+
+    QVector<float> a(n);
+    QVector<float> b(n);
+    if (params.dustRadius > 0) {
+        // Damm: ljushetens avvikelse från medianen över tröskeln ersätts med medianen
+        QVector<float> median[3];
+        for (int c = 0; c < 3; c++) {
+            median1D(planes[c].constData(), a.data(), w, h, params.dustRadius, false);
+            median[c].resize(n);
+            median1D(a.constData(), median[c].data(), w, h, params.dustRadius, true);
+        }
+        for (int i = 0; i < n; i++) {
+            const float d = 0.299f * (planes[0][i] - median[0][i]) + 0.587f * (planes[1][i] - median[1][i])
+                            + 0.114f * (planes[2][i] - median[2][i]);
+            if (qAbs(d) <= params.threshold) continue;
+            for (int c = 0; c < 3; c++) planes[c][i] = median[c][i];
+        }
+    }
+    if (params.amount > 0) {
+        // Oskarp mask: v + amount * (v - gauss(v))
+        for (int c = 0; c < 3; c++) {
+            gaussBlur(planes[c].constData(), a.data(), b.data(), w, h, params.kernel);
+            float* v = planes[c].data();
+            const float* blur = a.constData();
+            for (int i = 0; i < n; i++) v[i] += params.amount * (v[i] - blur[i]);
+        }
+    }
+
+    // Bara rutan skrivs tillbaka. Alfa behålls, förmultiplicerade värden hålls under den.
+    const int ox = tile.left() - area.left();
+    const int oy = tile.top() - area.top();
+    for (int y = 0; y < tile.height(); y++) {
+        const float* r = planes[0].constData() + (oy + y) * w + ox;
+        const float* g = planes[1].constData() + (oy + y) * w + ox;
+        const float* bl = planes[2].constData() + (oy + y) * w + ox;
+        uchar* line = bits + (tile.top() + y) * bytesPerLine;
+        if (deep) {
+            QRgba64* d = reinterpret_cast<QRgba64*>(line) + tile.left();
+            for (int x = 0; x < tile.width(); x++) {
+                const float limit = premultiplied ? d[x].alpha() : unit;
+                d[x] = QRgba64::fromRgba64(quint16(qBound(0.0f, r[x] * unit + 0.5f, limit)),
+                                           quint16(qBound(0.0f, g[x] * unit + 0.5f, limit)),
+                                           quint16(qBound(0.0f, bl[x] * unit + 0.5f, limit)), d[x].alpha());
+            }
+        } else {
+            QRgb* d = reinterpret_cast<QRgb*>(line) + tile.left();
+            for (int x = 0; x < tile.width(); x++) {
+                const float limit = premultiplied ? qAlpha(d[x]) : unit;
+                d[x] = qRgba(int(qBound(0.0f, r[x] * unit + 0.5f, limit)),
+                             int(qBound(0.0f, g[x] * unit + 0.5f, limit)),
+                             int(qBound(0.0f, bl[x] * unit + 0.5f, limit)), qAlpha(d[x]));
+            }
+        }
+    }
+}
+
+int ScanFilter::margin() const
+{
+    int m = 0;
+    if (dust > 0) m += qMax(1, dustSize);
+    if (sharpen > 0) m += qMax(1, qCeil(sharpenRadius * 3));
+    return m;
+}
+
+void ScanFilter::apply(QImage& image, qreal scale) const
+{
+    if (isNull() || image.isNull()) return;
+    const QImage::Format f = image.format();
+    const bool deep = f == QImage::Format_RGBX64 || f == QImage::Format_RGBA64 || f == QImage::Format_RGBA64_Premultiplied;
+    if (!deep && f != QImage::Format_RGB32 && f != QImage::Format_ARGB32 && f != QImage::Format_ARGB32_Premultiplied) {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    }
+    FilterParams params;
+    if (dust > 0) {
+        params.dustRadius = qMax(1, qRound(dustSize * scale));
+        params.threshold = dust / 255.0f;
+    }
+    if (sharpen > 0) {
+        params.amount = float(sharpen);
+        params.kernel = gaussKernel(qMax(0.5, sharpenRadius * scale));
+    }
+    // Rutorna läser grannar ur den ofiltrerade bilden och skriver bara sina egna pixlar
+    const QImage source = image;
+    uchar* bits = image.bits(); // koppla loss delad data innan trådarna skriver
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    const bool premultiplied = image.format() == QImage::Format_ARGB32_Premultiplied || image.format() == QImage::Format_RGBA64_Premultiplied;
+    QList<QRect> tiles;
+    for (int y = 0; y < image.height(); y += tileSize) {
+        for (int x = 0; x < image.width(); x += tileSize) tiles << QRect(x, y, tileSize, tileSize).intersected(image.rect());
+    }
+    QtConcurrent::blockingMap(tiles, [&](const QRect& tile) {
+        filterTile(source, bits, bytesPerLine, tile, params, deep, premultiplied);
+    });
+}
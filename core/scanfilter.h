@@ -0,0 +1,40 @@
+#ifndef SCANFILTER_H
+#define SCANFILTER_H
+
+#include <QImage>
+#include <QMap>
+#include <QVariant>
+
+// Rengöring av inskannade bilder, icke-destruktiv: värdena ligger i projektet
+// per bild (prefix Before/After) och filtret körs när bilden visas eller
+// exporteras. Damm och repor hittas som avvikelser från en separabel median
+// och ersätts med den, därefter skärps bilden med oskarp mask. Radierna gäller
+// originalets pixlar, en proxy filtreras med motsvarande mindre kärnor.
+
+class ScanFilter
+{
+public:
+    int dust = 0;               // tröskel i 8-bitarssteg mot medianen, 0 = av
+    int dustSize = 2;           // medianens radie
+    double sharpen = 0;         // oskarp mask, styrka (0 = av)
+    double sharpenRadius = 1;   // gaussens sigma
+    bool isNull() const { return dust <= 0 && sharpen <= 0; }
+    QString key() const { return QString("%1:%2:%3:%4").arg(dust).arg(dustSize).arg(sharpen).arg(sharpenRadius); }
+
+    static ScanFilter fromValues(const QMap<QString,QVariant>& values, const QString& prefix) {
+        ScanFilter f;
+        f.dust = values.value(prefix + "Dust").toInt();
+        f.dustSize = values.value(prefix + "DustSize", f.dustSize).toInt();
+        f.sharpen = values.value(prefix + "Sharpen").toDouble();
+        f.sharpenRadius = values.value(prefix + "SharpenRadius", f.sharpenRadius).toDouble();
+        return f;
+    }
+
+    // Pixlar utanför ett område som filtret läser, i originalets pixlar
+    int margin() const;
+    // Filtrerar image på plats i rutor som körs parallellt. scale är bildens pixlar
+    // per originalpixel (mindre än 1 för en proxy). 32- och 64-bitarsformat behåller djupet.
+    void apply(QImage& image, qreal scale = 1) const;
+};
+
+#endif // SCANFILTER_H
@@ -0,0 +1,762 @@
+#include "stripexport.h"
+#include "remaplut.h"
+#include "masklayer.h"
+#include "imagemetadata.h"
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFileInfo>
+#include <QDebug>
+#include <qmath.h>
+#include <memory>
+#include <cstring>
+#include <utility>
+#ifdef QT_BUNDLED_ZLIB
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+static void appendUInt32(QByteArray& a, quint32 v)
+{
+    a.append(char(v >> 24));
+    a.append(char(v >> 16));
+    a.append(char(v >> 8));
+    a.append(char(v));
+}
+
+StripWriter* StripWriter::create(const QString& path, QIODevice* device, int quality, bool deep)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "png") return new PngStripWriter(device, deep);
+    if (suffix == "tif" || suffix == "tiff") return new BufferedStripWriter(device, "tiff", quality, deep);
+    if (suffix == "webp") return new BufferedStripWriter(device, "webp", quality);
+    // Progressiv JPEG kräver alla koefficienter på en gång, bandvis blir det baslinje
+    return new JpegStripWriter(device, quality);
+}
+
+bool StripWriter::supportsDeep(const QString& path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "png" || suffix == "tif" || suffix == "tiff";
+}
+
+bool ImageStripWriter::begin(const QSize& size)
+{
+    m_Image = QImage(size, m_Deep ? QImage::Format_RGBX64 : QImage::Format_RGB32);
+    m_Row = 0;
+    return !m_Image.isNull();
+}
+
+bool ImageStripWriter::writeRows(const QImage& rows)
+{
+    if (rows.width() != m_Image.width() || m_Row + rows.height() > m_Image.height()) return false;
+    // Banden har normalt redan bildens format, annars konverteras bandet en gång
+    const QImage band = rows.depth() == m_Image.depth() ? rows : rows.convertToFormat(m_Image.format());
+    const size_t bytes = size_t(m_Image.width()) * (m_Image.depth() / 8);
+    for (int y = 0; y < band.height(); y++) {
+        std::memcpy(m_Image.scanLine(m_Row + y), band.constScanLine(y), bytes);
+    }
+    m_Row += rows.height();
+    return true;
+}
+
+bool BufferedStripWriter::finish()
+{
+    QImageWriter w(m_Device, m_Format);
+    w.setQuality(m_Quality);
+    if (!w.write(m_Image)) {
+        qWarning() << "BufferedStripWriter:" << w.errorString();
+        return false;
+    }
+    m_Image = QImage();
+    return true;
+}
+
+// PNG: raderna filtreras (Up) och matas direkt in i zlib, IDAT skrivs i bitar om 64 kB.
+// Med deep skrivs 16 bitar per kanal, stor-endian som formatet kräver.
+
+PngStripWriter::~PngStripWriter()
+{
+    if (m_Stream) {
+        deflateEnd(static_cast<z_stream*>(m_Stream));
+        delete static_cast<z_stream*>(m_Stream);
+    }
+}
+
+bool PngStripWriter::writeChunk(const char* type, const QByteArray& data)
+{
+    QByteArray chunk;
+    appendUInt32(chunk, quint32(data.size()));
+    chunk.append(type, 4);
+    chunk.append(data);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.constData() + 4), uInt(data.size() + 4));
+    appendUInt32(chunk, quint32(crc));
+    return m_Device->write(chunk) == chunk.size();
+}
+
+bool PngStripWriter::begin(const QSize& size)
+{
+    m_Size = size;
+    static const char signature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+    if (m_Device->write(signature, 8) != 8) return false;
+    QByteArray ihdr;
+    appendUInt32(ihdr, quint32(size.width()));
+    appendUInt32(ihdr, quint32(size.height()));
+    ihdr.append(char(m_Deep ? 16 : 8));   // bitdjup
+    ihdr.append(char(2));   // RGB
+    ihdr.append(char(0));   // deflate
+    ihdr.append(char(0));   // adaptiv filtrering
+    ihdr.append(char(0));   // ej interlace
+    if (!writeChunk("IHDR", ihdr)) return false;
+    z_stream* z = new z_stream;
+    z->zalloc = Z_NULL;
+    z->zfree = Z_NULL;
+    z->opaque = Z_NULL;
+    if (deflateInit(z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        delete z;
+        return false;
+    }
+    m_Stream = z;
+    const int rowBytes = size.width() * (m_Deep ? 6 : 3);
+    m_PrevRow = QByteArray(rowBytes, 0);
+    m_Row = QByteArray(rowBytes + 1, 0);
+    return true;
+}
+
+bool PngStripWriter::deflateRows(const uchar* data, int length, bool last)
+{
+    z_stream* z = static_cast<z_stream*>(m_Stream);
+    z->next_in = const_cast<Bytef*>(data);
+    z->avail_in = uInt(length);
+    char buffer[1 << 16];
+    do {
+        z->next_out = reinterpret_cast<Bytef*>(buffer);
+        z->avail_out = sizeof(buffer);
+        if (deflate(z, last ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR) return false;
+        m_Idat.append(buffer, int(sizeof(buffer) - z->avail_out));
+        if (m_Idat.size() >= (1 << 16) || (last && !m_Idat.isEmpty())) {
+            if (!writeChunk("IDAT", m_Idat)) return false;
+            m_Idat.clear();
+        }
+    } while (z->avail_out == 0);
+    return true;
+}
+
+bool PngStripWriter::writeRows(const QImage& rows)
+{
+    const int w = m_Size.width();
+    uchar* prev = reinterpret_cast<uchar*>(m_PrevRow.data());
+    uchar* row = reinterpret_cast<uchar*>(m_Row.data());
+    for (int y = 0; y < rows.height(); ++y) {
+        if (m_Deep) {
+            const QRgba64* src = reinterpret_cast<const QRgba64*>(rows.constScanLine(y));
+            row[0] = 2;
+            for (int x = 0; x < w; ++x) {
+                const quint16 c[3] = { src[x].red(), src[x].green(), src[x].blue() };
+                for (int k = 0; k < 3; ++k) {
+                    const int i = x * 6 + k * 2;
+                    const uchar hi = uchar(c[k] >> 8);
+                    const uchar lo = uchar(c[k]);
+                    row[1 + i] = uchar(hi - prev[i]);
+                    row[2 + i] = uchar(lo - prev[i + 1]);
+                    prev[i] = hi;
+                    prev[i + 1] = lo;
+                }
+            }
+            if (!deflateRows(row, m_Row.size(), false)) return false;
+            continue;
+        }
+        const QRgb* src = reinterpret_cast<const QRgb*>(rows.constScanLine(y));
+        row[0] = 2; // Up
+        for (int x = 0; x < w; ++x) {
+            const uchar r = uchar(qRed(src[x]));
+            const uchar g = uchar(qGreen(src[x]));
+            const uchar b = uchar(qBlue(src[x]));
+            row[1 + x * 3] = uchar(r - prev[x * 3]);
+            row[2 + x * 3] = uchar(g - prev[x * 3 + 1]);
+            row[3 + x * 3] = uchar(b - prev[x * 3 + 2]);
+            prev[x * 3] = r;
+            prev[x * 3 + 1] = g;
+            prev[x * 3 + 2] = b;
+        }
+        if (!deflateRows(row, m_Row.size(), false)) return false;
+    }
+    return true;
+}
+
+bool PngStripWriter::finish()
+{
+    if (!deflateRows(nullptr, 0, true)) return false;
+    return writeChunk("IEND", QByteArray());
+}
+
+// JPEG: baslinje, YCbCr 4:2:0, standardtabeller. Varje MCU-rad (16 pixelrader)
+// kodas så snart den är komplett.
+
+static const int jpegZigZag[64] = {
+    0, 1, 5, 6, 14, 15, 27, 28, 2, 4, 7, 13, 16, 26, 29, 42,
+    3, 8, 12, 17, 25, 30, 41, 43, 9, 11, 18, 24, 31, 40, 44, 53,
+    10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
+    21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63
+};
+
+static const quint8 jpegQuantY[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99
+};
+
+static const quint8 jpegQuantUV[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static const quint8 jpegDcLumBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const quint8 jpegDcChromBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const quint8 jpegDcVals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+static const quint8 jpegAcLumBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const quint8 jpegAcLumVals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+static const quint8 jpegAcChromBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const quint8 jpegAcChromVals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+template <typename T>
+static void buildHuffCodes(const quint8* bits, const quint8* vals, T* codes)
+{
+    quint16 code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; ++length) {
+        for (int i = 0; i < bits[length - 1]; ++i) {
+            codes[vals[k]].code = code++;
+            codes[vals[k]].length = quint8(length);
+            ++k;
+        }
+        code <<= 1;
+    }
+}
+
+// AAN-DCT på åtta värden med godtyckligt steg
+static void jpegDct(float* d, int s)
+{
+    const float tmp0 = d[0] + d[7 * s], tmp7 = d[0] - d[7 * s];
+    const float tmp1 = d[s] + d[6 * s], tmp6 = d[s] - d[6 * s];
+    const float tmp2 = d[2 * s] + d[5 * s], tmp5 = d[2 * s] - d[5 * s];
+    const float tmp3 = d[3 * s] + d[4 * s], tmp4 = d[3 * s] - d[4 * s];
+
+    float tmp10 = tmp0 + tmp3;
+    const float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4 * s] = tmp10 - tmp11;
+    const float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * s] = tmp13 + z1;
+    d[6 * s] = tmp13 - z1;
+
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    const float z5 = (tmp10 - tmp12) * 0.382683433f;
+    const float z2 = tmp10 * 0.541196100f + z5;
+    const float z4 = tmp12 * 1.306562965f + z5;
+    const float z3 = tmp11 * 0.707106781f;
+    const float z11 = tmp7 + z3;
+    const float z13 = tmp7 - z3;
+    d[5 * s] = z13 + z2;
+    d[3 * s] = z13 - z2;
+    d[s] = z11 + z4;
+    d[7 * s] = z11 - z4;
+}
+
+static quint8 jpegScaledQuant(quint8 base, int quality)
+{
+    const int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    return quint8(qBound(1, (base * scale + 50) / 100, 255));
+}
+
+JpegStripWriter::JpegStripWriter(QIODevice* device, int quality)
+    : m_Device(device), m_Quality(quality < 0 ? 75 : qBound(1, quality, 100))
+{
+    static const float aasf[8] = {
+        1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f,
+        1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f
+    };
+    for (int row = 0, k = 0; row < 8; ++row) {
+        for (int col = 0; col < 8; ++col, ++k) {
+            m_fdtblY[k] = 1.0f / (jpegScaledQuant(jpegQuantY[k], m_Quality) * aasf[row] * aasf[col]);
+            m_fdtblUV[k] = 1.0f / (jpegScaledQuant(jpegQuantUV[k], m_Quality) * aasf[row] * aasf[col]);
+        }
+    }
+    buildHuffCodes(jpegDcLumBits, jpegDcVals, m_DcY);
+    buildHuffCodes(jpegDcChromBits, jpegDcVals, m_DcUV);
+    buildHuffCodes(jpegAcLumBits, jpegAcLumVals, m_AcY);
+    buildHuffCodes(jpegAcChromBits, jpegAcChromVals, m_AcUV);
+}
+
+bool JpegStripWriter::begin(const QSize& size)
+{
+    // SOF0 har 16 bitar för bredd och höjd
+    if (size.isEmpty() || size.width() > 65535 || size.height() > 65535) return false;
+    m_Size = size;
+    QByteArray h;
+    h.append("\xFF\xD8", 2);
+    // JFIF APP0
+    h.append("\xFF\xE0\x00\x10JFIF\x00\x01\x01\x00\x00\x01\x00\x01\x00\x00", 18);
+    // DQT, tabellerna i sicksackordning
+    h.append("\xFF\xDB\x00\x84\x00", 5);
+    QByteArray table(64, 0);
+    for (int i = 0; i < 64; ++i) table[jpegZigZag[i]] = char(jpegScaledQuant(jpegQuantY[i], m_Quality));
+    h.append(table);
+    h.append(char(1));
+    for (int i = 0; i < 64; ++i) table[jpegZigZag[i]] = char(jpegScaledQuant(jpegQuantUV[i], m_Quality));
+    h.append(table);
+    // SOF0, tre komponenter, Y delsamplas inte, Cb/Cr 2x2
+    h.append("\xFF\xC0\x00\x11\x08", 5);
+    h.append(char(size.height() >> 8));
+    h.append(char(size.height()));
+    h.append(char(size.width() >> 8));
+    h.append(char(size.width()));
+    h.append("\x03\x01\x22\x00\x02\x11\x01\x03\x11\x01", 10);
+    // DHT
+    h.append("\xFF\xC4\x01\xA2", 4);
+    h.append(char(0x00));
+    h.append(reinterpret_cast<const char*>(jpegDcLumBits), 16);
+    h.append(reinterpret_cast<const char*>(jpegDcVals), 12);
+    h.append(char(0x10));
+    h.append(reinterpret_cast<const char*>(jpegAcLumBits), 16);
+    h.append(reinterpret_cast<const char*>(jpegAcLumVals), 162);
+    h.append(char(0x01));
+    h.append(reinterpret_cast<const char*>(jpegDcChromBits), 16);
+    h.append(reinterpret_cast<const char*>(jpegDcVals), 12);
+    h.append(char(0x11));
+    h.append(reinterpret_cast<const char*>(jpegAcChromBits), 16);
+    h.append(reinterpret_cast<const char*>(jpegAcChromVals), 162);
+    // SOS
+    h.append("\xFF\xDA\x00\x0C\x03\x01\x00\x02\x11\x03\x11\x00\x3F\x00", 14);
+    return m_Device->write(h) == h.size();
+}
+
+void JpegStripWriter::writeBits(quint32 bits, int length)
+{
+    m_BitCount += length;
+    m_BitBuffer |= bits << (24 - m_BitCount);
+    while (m_BitCount >= 8) {
+        const char c = char((m_BitBuffer >> 16) & 0xFF);
+        m_Out.append(c);
+        if (c == char(0xFF)) m_Out.append(char(0));
+        m_BitBuffer <<= 8;
+        m_BitCount -= 8;
+    }
+}
+
+void JpegStripWriter::flushBits()
+{
+    writeBits(0x7F, 7);
+    m_BitBuffer = 0;
+    m_BitCount = 0;
+}
+
+bool JpegStripWriter::flushBuffer()
+{
+    if (m_Out.isEmpty()) return true;
+    const bool ok = m_Device->write(m_Out) == m_Out.size();
+    m_Out.clear();
+    return ok;
+}
+
+// Kategori (antal bitar) och bitmönster för ett DC-/AC-värde
+static std::pair<quint32, int> jpegValueBits(int value)
+{
+    int magnitude = value < 0 ? -value : value;
+    const int bits = value < 0 ? value - 1 : value;
+    int length = 0;
+    while (magnitude) {
+        ++length;
+        magnitude >>= 1;
+    }
+    return std::make_pair(quint32(bits & ((1 << length) - 1)), length);
+}
+
+int JpegStripWriter::encodeBlock(float* block, const float* fdtbl, int dc, const HuffCode* dcCodes, const HuffCode* acCodes)
+{
+    for (int i = 0; i < 64; i += 8) jpegDct(block + i, 1);
+    for (int i = 0; i < 8; ++i) jpegDct(block + i, 8);
+    int du[64];
+    for (int i = 0; i < 64; ++i) {
+        const float v = block[i] * fdtbl[i];
+        du[jpegZigZag[i]] = int(v < 0 ? v - 0.5f : v + 0.5f);
+    }
+    const int diff = du[0] - dc;
+    if (diff == 0) {
+        writeBits(dcCodes[0].code, dcCodes[0].length);
+    } else {
+        const auto v = jpegValueBits(diff);
+        writeBits(dcCodes[v.second].code, dcCodes[v.second].length);
+        writeBits(v.first, v.second);
+    }
+    int last = 63;
+    while (last > 0 && du[last] == 0) --last;
+    if (last == 0) {
+        writeBits(acCodes[0x00].code, acCodes[0x00].length);
+        return du[0];
+    }
+    for (int i = 1; i <= last; ++i) {
+        const int start = i;
+        while (du[i] == 0 && i <= last) ++i;
+        int zeros = i - start;
+        if (zeros >= 16) {
+            for (int n = 0; n < (zeros >> 4); ++n) writeBits(acCodes[0xF0].code, acCodes[0xF0].length);
+            zeros &= 15;
+        }
+        const auto v = jpegValueBits(du[i]);
+        const HuffCode& c = acCodes[(zeros << 4) + v.second];
+        writeBits(c.code, c.length);
+        writeBits(v.first, v.second);
+    }
+    if (last != 63) writeBits(acCodes[0x00].code, acCodes[0x00].length);
+    return du[0];
+}
+
+void JpegStripWriter::encodeMcuRow()
+{
+    const int w = m_Size.width();
+    float y[4][64];
+    float cb[64];
+    float cr[64];
+    float fullCb[256];
+    float fullCr[256];
+    for (int mx = 0; mx < w; mx += 16) {
+        for (int py = 0; py < 16; ++py) {
+            const QRgb* row = reinterpret_cast<const QRgb*>(m_Rows[py].constData());
+            for (int px = 0; px < 16; ++px) {
+                const QRgb p = row[qMin(mx + px, w - 1)];
+                const float r = qRed(p), g = qGreen(p), b = qBlue(p);
+                const int block = (py >> 3) * 2 + (px >> 3);
+                y[block][(py & 7) * 8 + (px & 7)] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+                fullCb[py * 16 + px] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+                fullCr[py * 16 + px] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+            }
+        }
+        for (int cy = 0; cy < 8; ++cy) {
+            for (int cx = 0; cx < 8; ++cx) {
+                const int i = cy * 32 + cx * 2;
+                cb[cy * 8 + cx] = (fullCb[i] + fullCb[i + 1] + fullCb[i + 16] + fullCb[i + 17]) * 0.25f;
+                cr[cy * 8 + cx] = (fullCr[i] + fullCr[i + 1] + fullCr[i + 16] + fullCr[i + 17]) * 0.25f;
+            }
+        }
+        for (int b = 0; b < 4; ++b) m_DcPredY = encodeBlock(y[b], m_fdtblY, m_DcPredY, m_DcY, m_AcY);
+        m_DcPredCb = encodeBlock(cb, m_fdtblUV, m_DcPredCb, m_DcUV, m_AcUV);
+        m_DcPredCr = encodeBlock(cr, m_fdtblUV, m_DcPredCr, m_DcUV, m_AcUV);
+    }
+}
+
+bool JpegStripWriter::writeRows(const QImage& rows)
+{
+    for (int y = 0; y < rows.height(); ++y) {
+        m_Rows.append(QByteArray(reinterpret_cast<const char*>(rows.constScanLine(y)), m_Size.width() * 4));
+        if (m_Rows.size() == 16) {
+            encodeMcuRow();
+            m_Rows.clear();
+            if (!flushBuffer()) return false;
+        }
+        m_RowsDone++;
+    }
+    return true;
+}
+
+bool JpegStripWriter::finish()
+{
+    if (!m_Rows.isEmpty()) {
+        while (m_Rows.size() < 16) m_Rows.append(m_Rows.last());
+        encodeMcuRow();
+        m_Rows.clear();
+    }
+    flushBits();
+    m_Out.append("\xFF\xD9", 2);
+    if (m_RowsDone != m_Size.height()) qWarning() << "JpegStripWriter: expected" << m_Size.height() << "rows, got" << m_RowsDone;
+    return flushBuffer();
+}
+
+// Format som tappar upplösning i 8 bitar per kanal
+static bool deepFormat(QImage::Format format)
+{
+    switch (format) {
+    case QImage::Format_RGBX64:
+    case QImage::Format_RGBA64:
+    case QImage::Format_RGBA64_Premultiplied:
+    case QImage::Format_Grayscale16:
+    case QImage::Format_RGBX16FPx4:
+    case QImage::Format_RGBA16FPx4:
+    case QImage::Format_RGBA16FPx4_Premultiplied:
+    case QImage::Format_RGBX32FPx4:
+    case QImage::Format_RGBA32FPx4:
+    case QImage::Format_RGBA32FPx4_Premultiplied:
+        return true;
+    default:
+        return false;
+    }
+}
+
+StripReader::StripReader(const QString& path) : m_Path(path)
+{
+    QImageReader r(path);
+    m_Transformation = ImageMetadata::transformation(r);
+    m_Size = ImageMetadata::orientedSize(r.size(), m_Transformation);
+    m_Deep = deepFormat(r.imageFormat());
+    m_Streams = r.supportsOption(QImageIOHandler::ClipRect);
+}
+
+QImage StripReader::read(const QRect& rect, bool deep) const
+{
+    const QImage::Format format = deep ? QImage::Format_RGBA64_Premultiplied : QImage::Format_ARGB32_Premultiplied;
+    if (!m_Streams) {
+        // Utan ClipRect skulle varje band avkoda hela bilden, så den avkodas en gång
+        if (m_Full.isNull()) {
+            QImageReader r(m_Path);
+            r.setAutoTransform(false);
+            const QImage i = r.read();
+            if (i.isNull()) {
+                qWarning() << "StripReader:" << r.errorString() << m_Path;
+                return QImage();
+            }
+            m_Full = ImageMetadata::orient(i, m_Transformation);
+        }
+        return m_Full.copy(rect).convertToFormat(format);
+    }
+    QImageReader r(m_Path);
+    r.setAutoTransform(false);
+    // Samma område i filens lagrade orientering
+    const QSize stored = ImageMetadata::orientedSize(m_Size, m_Transformation);
+    r.setClipRect(ImageMetadata::orientation(m_Transformation, stored).inverted().mapRect(rect));
+    QImage i = r.read();
+    if (i.isNull()) {
+        qWarning() << "StripReader:" << r.errorString() << m_Path << rect;
+        return QImage();
+    }
+    // Remsan normaliseras en gång, omsamplingen och färgkurvorna arbetar sedan direkt i den
+    return ImageMetadata::orient(i, m_Transformation).convertToFormat(format);
+}
+
+// Källor som inte kan läsas i remsor avkodas hela, oavsett budgeten
+static void warnUnbounded(const StripReader& reader, const QString& path, qint64 budget)
+{
+    if (!reader.streams() && reader.decodeCost() > budget) {
+        qWarning() << "StripExporter:" << path << "cannot be decoded in strips, needs"
+                   << reader.decodeCost() / (1024 * 1024) << "MB over the budget of" << budget / (1024 * 1024) << "MB";
+    }
+}
+
+int StripExporter::bandHeight(int width, int bytesPerPixel) const
+{
+    // En fjärdedel av budgeten till utdatabandet, resten till källrader
+    const qint64 rows = (m_Budget / 4) / (qint64(width) * bytesPerPixel);
+    return int(qMax<qint64>(16, rows - rows % 16));
+}
+
+// Utdatapunkt -> korrigerad källpunkt -> rå källpunkt
+static RemapLut::Mapping warpMapping(const QTransform& transform, const LensDistortion& lens, const QSize& sourceSize)
+{
+    bool invertible;
+    const QTransform inverse = transform.inverted(&invertible);
+    return [=](const QPointF& o, QPointF& s) {
+        if (!invertible || inverse.m13() * o.x() + inverse.m23() * o.y() + inverse.m33() <= 0) return false;
+        s = lens.distort(inverse.map(o), sourceSize);
+        return true;
+    };
+}
+
+// Källområdet source avkodat, filtrerat och färgkorrigerat. Filtret läser en
+// marginal runt området, så att remsornas kanter blir som i en hel bild.
+static QImage readSource(const StripReader& reader, const QRect& source, const ScanFilter& filter,
+                         const ColourLut& lut, bool deep, QPoint* origin)
+{
+    const int m = filter.margin();
+    const QRect area = source.adjusted(-m, -m, m, m).intersected(reader.rect());
+    QImage s = reader.read(area, deep);
+    filter.apply(s);
+    lut.apply(s);
+    *origin = area.topLeft();
+    return s;
+}
+
+// Fyller band (utdataraderna från top) med källan. Källområdet läses i lägre
+// remsor om det inte ryms i budgeten tillsammans med bandet.
+static void warpBand(const StripReader& reader, const RemapLut::Mapping& map, const ColourLut& lut,
+                     const ScanFilter& filter, QImage& band, int top, const QRgb& bg, qint64 budget)
+{
+    const qint64 bandBytes = qint64(band.bytesPerLine()) * band.height();
+    for (int y = 0; y < band.height();) {
+        int rows = band.height() - y;
+        RemapLut remap(QRect(0, top + y, band.width(), rows), map);
+        QRect source = remap.sourceRect(remap.outputRect(), reader.rect());
+        while (rows > 16 && bandBytes + qint64(source.width()) * source.height() * 4 > budget) {
+            rows /= 2;
+            remap = RemapLut(QRect(0, top + y, band.width(), rows), map);
+            source = remap.sourceRect(remap.outputRect(), reader.rect());
+        }
+        if (!source.isEmpty()) {
+            QPoint origin;
+            const QImage s = readSource(reader, source, filter, lut, false, &origin);
+            if (!s.isNull()) remap.remap(s, origin, band, QPoint(0, top), &bg);
+        }
+        y += rows;
+    }
+}
+
+bool StripExporter::exportWarped(const QString& sourcePath, const QString& path, const QSize& canvas,
+                                 const QTransform& transform, const QColor& background, int quality,
+                                 const ColourLut& lut, const LensDistortion& lens, const ScanFilter& filter)
+{
+    StripReader reader(sourcePath);
+    if (!reader.isValid() || canvas.isEmpty()) {
+        qWarning() << "StripExporter: cannot read" << sourcePath;
+        return false;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "StripExporter: cannot write" << path;
+        return false;
+    }
+    // 16-bitarskällor behåller djupet hela vägen om utdataformatet klarar det
+    const bool deep = reader.isDeep() && StripWriter::supportsDeep(path);
+    std::unique_ptr<StripWriter> writer(StripWriter::create(path, &file, quality, deep));
+    return warp(reader, path, writer.get(), canvas, transform, background, lut, lens, filter, deep);
+}
+
+QImage StripExporter::renderWarped(const QString& sourcePath, const QSize& canvas, const QTransform& transform,
+                                   const QColor& background, const ColourLut& lut, const LensDistortion& lens,
+                                   const ScanFilter& filter)
+{
+    StripReader reader(sourcePath);
+    if (!reader.isValid() || canvas.isEmpty()) {
+        qWarning() << "StripExporter: cannot read" << sourcePath;
+        return QImage();
+    }
+    ImageStripWriter writer;
+    if (!warp(reader, sourcePath, &writer, canvas, transform, background, lut, lens, filter, false)) return QImage();
+    return writer.image();
+}
+
+bool StripExporter::warp(const StripReader& reader, const QString& name, StripWriter* writer, const QSize& canvas,
+                         const QTransform& transform, const QColor& background, const ColourLut& lut,
+                         const LensDistortion& lens, const ScanFilter& filter, bool deep)
+{
+    warnUnbounded(reader, name, m_Budget);
+    const RemapLut::Mapping map = warpMapping(transform, lens, reader.size());
+    if (!writer->begin(canvas)) {
+        qWarning() << "StripExporter: cannot encode" << canvas << "to" << name;
+        return false;
+    }
+
+    const QRgb bg = background.rgb();
+    const int pixelBytes = deep ? 8 : 4;
+    const qint64 rowBytes = qint64(canvas.width()) * pixelBytes;
+    const int maxRows = bandHeight(canvas.width(), pixelBytes);
+    for (int top = 0; top < canvas.height();) {
+        int rows = qMin(maxRows, canvas.height() - top);
+        RemapLut remap(QRect(0, top, canvas.width(), rows), map);
+        QRect source = remap.sourceRect(remap.outputRect(), reader.rect());
+        // Krymp bandet tills de källrader som behövs ryms i budgeten
+        while (rows > 16 && rowBytes * rows + qint64(source.width()) * source.height() * pixelBytes > m_Budget) {
+            rows /= 2;
+            remap = RemapLut(QRect(0, top, canvas.width(), rows), map);
+            source = remap.sourceRect(remap.outputRect(), reader.rect());
+        }
+        QImage band(canvas.width(), rows, deep ? QImage::Format_RGBX64 : QImage::Format_RGB32);
+        band.fill(background);
+        if (!source.isEmpty()) {
+            QPoint origin;
+            const QImage s = readSource(reader, source, filter, lut, deep, &origin);
+            if (!s.isNull()) remap.remap(s, origin, band, QPoint(0, top), &bg);
+        }
+        if (!writer->writeRows(band)) {
+            qWarning() << "StripExporter: write failed" << name;
+            return false;
+        }
+        top += rows;
+    }
+    return writer->finish();
+}
+
+bool StripExporter::exportComposite(const QString& beforePath, const QTransform& beforeTransform, const LensDistortion& beforeLens,
+                                    const QString& afterPath, const QTransform& afterTransform, const ColourLut& afterLut,
+                                    const LensDistortion& afterLens, const MaskBand& mask, const QString& path,
+                                    const QSize& canvas, int quality,
+                                    const ScanFilter& beforeFilter, const ScanFilter& afterFilter)
+{
+    StripReader before(beforePath);
+    StripReader after(afterPath);
+    if (!before.isValid() || !after.isValid() || canvas.isEmpty()) {
+        qWarning() << "StripExporter: cannot read" << beforePath << afterPath;
+        return false;
+    }
+    warnUnbounded(before, beforePath, m_Budget);
+    warnUnbounded(after, afterPath, m_Budget);
+    const RemapLut::Mapping beforeMap = warpMapping(beforeTransform, beforeLens, before.size());
+    const RemapLut::Mapping afterMap = warpMapping(afterTransform, afterLens, after.size());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "StripExporter: cannot write" << path;
+        return false;
+    }
+    std::unique_ptr<StripWriter> writer(StripWriter::create(path, &file, quality));
+    if (!writer->begin(canvas)) {
+        qWarning() << "StripExporter: cannot encode" << canvas << "to" << path;
+        return false;
+    }
+
+    const QRgb bg = QColor(Qt::white).rgb();
+    // Två utdataband och masken delar på bandets del av budgeten
+    const int maxRows = qMax(16, bandHeight(canvas.width()) / 2);
+    for (int top = 0; top < canvas.height(); top += maxRows) {
+        const int rows = qMin(maxRows, canvas.height() - top);
+        QImage alpha(canvas.width(), rows, QImage::Format_Alpha8);
+        mask(alpha, top);
+        QImage band(canvas.width(), rows, QImage::Format_RGB32);
+        band.fill(bg);
+        warpBand(after, afterMap, afterLut, afterFilter, band, top, bg, m_Budget);
+        QImage over(canvas.width(), rows, QImage::Format_RGB32);
+        over.fill(bg);
+        warpBand(before, beforeMap, ColourLut(), beforeFilter, over, top, bg, m_Budget);
+        MaskLayer::blend(band, over, alpha, band.rect());
+        if (!writer->writeRows(band)) {
+            qWarning() << "StripExporter: write failed" << path;
+            return false;
+        }
+    }
+    return writer->finish();
+}
+
+bool StripExporter::exportCopy(const QString& sourcePath, const QString& path, int quality,
+                               const ColourLut& lut, const LensDistortion& lens, const ScanFilter& filter)
+{
+    StripReader reader(sourcePath);
+    return exportWarped(sourcePath, path, reader.size(), QTransform(), Qt::white, quality, lut, lens, filter);
+}
@@ -0,0 +1,186 @@
+#ifndef STRIPEXPORT_H
+#define STRIPEXPORT_H
+
+#include <QImage>
+#include <QTransform>
+#include <QIODevice>
+#include <QFile>
+#include <QColor>
+#include "colourlut.h"
+#include "lensdistortion.h"
+#include "scanfilter.h"
+#include <functional>
+
+// Bandvis export: källan avkodas i remsor och utdata strömmas rad för rad
+// till kodaren, så att minnet begränsas av budgeten och inte av bildstorleken.
+
+class StripWriter
+{
+public:
+    virtual ~StripWriter() {}
+    virtual bool begin(const QSize& size) = 0;
+    // rows måste vara lika bred som size och i Format_RGB32/ARGB32, eller
+    // Format_RGBX64 om skrivaren skapats med deep
+    virtual bool writeRows(const QImage& rows) = 0;
+    virtual bool finish() = 0;
+    // deep ger 16 bitar per kanal för de format som klarar det, se supportsDeep
+    static StripWriter* create(const QString& path, QIODevice* device, int quality = -1, bool deep = false);
+    static bool supportsDeep(const QString& path);
+};
+
+class PngStripWriter : public StripWriter
+{
+public:
+    PngStripWriter(QIODevice* device, bool deep = false) : m_Device(device), m_Deep(deep) {}
+    ~PngStripWriter();
+    bool begin(const QSize& size) override;
+    bool writeRows(const QImage& rows) override;
+    bool finish() override;
+private:
+    bool writeChunk(const char* type, const QByteArray& data);
+    bool deflateRows(const uchar* data, int length, bool last);
+    QIODevice* m_Device;
+    bool m_Deep;
+    QSize m_Size;
+    QByteArray m_PrevRow;
+    QByteArray m_Row;
+    QByteArray m_Idat;
+    void* m_Stream = nullptr;
+};
+
+class JpegStripWriter : public StripWriter
+{
+public:
+    JpegStripWriter(QIODevice* device, int quality = -1);
+    bool begin(const QSize& size) override;
+    bool writeRows(const QImage& rows) override;
+    bool finish() override;
+private:
+    struct HuffCode { quint16 code = 0; quint8 length = 0; };
+    void encodeMcuRow();
+    int encodeBlock(float* block, const float* fdtbl, int dc, const HuffCode* dcCodes, const HuffCode* acCodes);
+    void writeBits(quint32 bits, int length);
+    void flushBits();
+    bool flushBuffer();
+    QIODevice* m_Device;
+    int m_Quality;
+    QSize m_Size;
+    // 16 rader (en MCU-rad vid 4:2:0) buffras innan kodning
+    QList<QByteArray> m_Rows;
+    int m_RowsDone = 0;
+    float m_fdtblY[64];
+    float m_fdtblUV[64];
+    HuffCode m_DcY[12];
+    HuffCode m_DcUV[12];
+    HuffCode m_AcY[256];
+    HuffCode m_AcUV[256];
+    int m_DcPredY = 0;
+    int m_DcPredCb = 0;
+    int m_DcPredCr = 0;
+    quint32 m_BitBuffer = 0;
+    int m_BitCount = 0;
+    QByteArray m_Out;
+};
+
+// Raderna samlas till en hel bild i minnet, som image() lämnar ut
+class ImageStripWriter : public StripWriter
+{
+public:
+    ImageStripWriter(bool deep = false) : m_Deep(deep) {}
+    bool begin(const QSize& size) override;
+    bool writeRows(const QImage& rows) override;
+    bool finish() override { return m_Row == m_Image.height(); }
+    const QImage& image() const { return m_Image; }
+protected:
+    bool m_Deep;
+    QImage m_Image;
+    int m_Row = 0;
+};
+
+// Format utan strömmande kodare (WebP, TIFF): raderna samlas till en hel bild
+// som kodas i finish(). Minnet begränsas då inte av budgeten.
+class BufferedStripWriter : public ImageStripWriter
+{
+public:
+    BufferedStripWriter(QIODevice* device, const QByteArray& format, int quality = -1, bool deep = false)
+        : ImageStripWriter(deep), m_Device(device), m_Format(format), m_Quality(quality) {}
+    bool finish() override;
+private:
+    QIODevice* m_Device;
+    QByteArray m_Format;
+    int m_Quality;
+};
+
+class StripReader
+{
+public:
+    StripReader(const QString& path);
+    bool isValid() const { return m_Size.isValid(); }
+    QSize size() const { return m_Size; }
+    QRect rect() const { return QRect(QPoint(0,0), m_Size); }
+    // Filen har mer än 8 bitar per kanal (16-bitars TIFF/PNG, flyttal)
+    bool isDeep() const { return m_Deep; }
+    // Avkodar rect, returneras som Format_ARGB32_Premultiplied eller med deep
+    // Format_RGBA64_Premultiplied. Storlek och rect gäller bilden som den visas,
+    // efter EXIF-orienteringen.
+    // Bara format vars läsare stöder ClipRect avkodas i remsor. JPEG gör det men
+    // avkodar från toppen för varje band: minnet begränsas, tiden växer med
+    // antalet band. PNG och TIFF saknar stödet och avkodas hela en gång, sedan
+    // klipps banden ur den bilden. Då gäller inte budgeten, se decodeCost().
+    QImage read(const QRect& rect, bool deep = false) const;
+    bool streams() const { return m_Streams; }
+    // Byte som hela bilden tar i minnet när den inte kan läsas i remsor
+    qint64 decodeCost() const { return qint64(m_Size.width()) * m_Size.height() * (m_Deep ? 8 : 4); }
+private:
+    QString m_Path;
+    QSize m_Size;
+    int m_Transformation = 0;
+    bool m_Deep = false;
+    bool m_Streams = true;
+    mutable QImage m_Full;
+};
+
+class StripExporter
+{
+public:
+    StripExporter(qint64 budget) : m_Budget(budget) {}
+    // Kostnad för att rendera helt i minnet (utdata + källa)
+    static qint64 fullMemoryCost(const QSize& canvas, const QSize& source) {
+        return qint64(canvas.width()) * canvas.height() * 4 + qint64(source.width()) * source.height() * 4;
+    }
+    bool exceedsBudget(const QSize& canvas, const QSize& source) const {
+        return fullMemoryCost(canvas, source) > m_Budget;
+    }
+    // Renderar sourcePath transformerad in i en canvas av storleken canvas och skriver till path.
+    // lens är källans linsfel, det korrigeras i samma omsampling som transformen.
+    // 16-bitarskällor skrivs med 16 bitar per kanal till PNG och TIFF. filter körs på
+    // källans remsor i full upplösning, före färgkorrigeringen.
+    bool exportWarped(const QString& sourcePath, const QString& path, const QSize& canvas,
+                      const QTransform& transform, const QColor& background = Qt::white, int quality = -1,
+                      const ColourLut& lut = ColourLut(), const LensDistortion& lens = LensDistortion(),
+                      const ScanFilter& filter = ScanFilter());
+    // Som exportWarped men till en Format_RGB32-bild i minnet, null om det misslyckas
+    QImage renderWarped(const QString& sourcePath, const QSize& canvas, const QTransform& transform,
+                        const QColor& background = Qt::white, const ColourLut& lut = ColourLut(),
+                        const LensDistortion& lens = LensDistortion(), const ScanFilter& filter = ScanFilter());
+    // Fyller ett Format_Alpha8-band med maskens värden för utdataraderna från top
+    typedef std::function<void(QImage& alpha, int top)> MaskBand;
+    // Lägger beforePath över afterPath genom masken (255 = förebilden) och skriver till path.
+    // Båda bilderna omsamplas bandvis som i exportWarped.
+    bool exportComposite(const QString& beforePath, const QTransform& beforeTransform, const LensDistortion& beforeLens,
+                         const QString& afterPath, const QTransform& afterTransform, const ColourLut& afterLut,
+                         const LensDistortion& afterLens, const MaskBand& mask, const QString& path,
+                         const QSize& canvas, int quality = -1,
+                         const ScanFilter& beforeFilter = ScanFilter(), const ScanFilter& afterFilter = ScanFilter());
+    // Skriver om sourcePath till path utan att hela bilden avkodas
+    bool exportCopy(const QString& sourcePath, const QString& path, int quality = -1,
+                    const ColourLut& lut = ColourLut(), const LensDistortion& lens = LensDistortion(),
+                    const ScanFilter& filter = ScanFilter());
+private:
+    bool warp(const StripReader& reader, const QString& name, StripWriter* writer, const QSize& canvas, const QTransform& transform,
+              const QColor& background, const ColourLut& lut, const LensDistortion& lens, const ScanFilter& filter, bool deep);
+    int bandHeight(int width, int bytesPerPixel = 4) const;
+    qint64 m_Budget;
+};
+
+#endif // STRIPEXPORT_H
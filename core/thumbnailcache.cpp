@@ -0,0 +1,95 @@
+#include "thumbnailcache.h"
+#include "projectvalues.h"
+#include "imagemetadata.h"
+#include <QImageReader>
+#include <QPainter>
+#include <QFileInfo>
+#include <QDir>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDebug>
+
+ThumbnailCache::ThumbnailCache(QObject* parent) : QObject(parent)
+{
+    m_Dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/BeforeAfter/thumbnails";
+    QDir().mkpath(m_Dir);
+    // Kostnad i kB, räcker till några tusen miniatyrer
+    m_Memory.setMaxCost(64 * 1024);
+    m_Pool.setMaxThreadCount(2);
+}
+
+QString ThumbnailCache::key(const QMap<QString,QVariant>& project)
+{
+    // Versionen ändras när miniatyrerna ritas på ett nytt sätt (2: EXIF-orientering)
+    QString k = "2|";
+    for (const char* pix : { "BeforePix", "AfterPix" }) {
+        const QString path = project.value(pix).toString();
+        k += path + "|" + QString::number(QFileInfo(path).lastModified().toMSecsSinceEpoch()) + "|";
+    }
+    const QTransform t = ProjectValues::afterTransform(project);
+    for (const qreal v : { t.m11(), t.m12(), t.m13(), t.m21(), t.m22(), t.m23(), t.m31(), t.m32(), t.m33() }) {
+        k += QString::number(v, 'g', 10) + ",";
+    }
+    return QCryptographicHash::hash(k.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+QString ThumbnailCache::filePath(const QString& key) const
+{
+    return m_Dir + "/" + key + ".png";
+}
+
+QImage ThumbnailCache::thumbnail(const QString& key, const QMap<QString,QVariant>& project)
+{
+    if (const QImage* i = m_Memory.object(key)) return *i;
+    if (m_Pending.contains(key)) return QImage();
+    m_Pending.insert(key);
+    const QString path = filePath(key);
+    m_Pool.start([this, key, path, project]() {
+        QImage image(path);
+        if (image.isNull()) {
+            image = render(project, thumbnailSize());
+            if (!image.isNull()) image.save(path, "PNG");
+        }
+        QMetaObject::invokeMethod(this, [this, key, image]() {
+            m_Pending.remove(key);
+            m_Memory.insert(key, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+            emit ready(key);
+        }, Qt::QueuedConnection);
+    });
+    return QImage();
+}
+
+QImage ThumbnailCache::render(const QMap<QString,QVariant>& project, const QSize& size)
+{
+    QImageReader br(project.value("BeforePix").toString());
+    const QSize beforeSize = ImageMetadata::size(br);
+    if (beforeSize.isEmpty()) return QImage();
+    const QSize fitted = beforeSize.scaled(size, Qt::KeepAspectRatio);
+    const qreal scale = qreal(fitted.width()) / beforeSize.width();
+    // Avkoda direkt i miniatyrstorlek (dubbel för utjämningens skull)
+    const QImage before = ImageMetadata::read(br, beforeSize.scaled(fitted * 2, Qt::KeepAspectRatio));
+
+    QImage out(size, QImage::Format_ARGB32_Premultiplied);
+    out.fill(Qt::transparent);
+    QPainter p(&out);
+    p.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    p.translate((size.width() - fitted.width()) / 2.0, (size.height() - fitted.height()) / 2.0);
+    p.scale(scale, scale);
+    const QRectF beforeRect(QPointF(0, 0), beforeSize);
+    p.setClipRect(beforeRect);
+
+    QImageReader ar(project.value("AfterPix").toString());
+    const QSize afterSize = ImageMetadata::size(ar);
+    if (!afterSize.isEmpty()) {
+        const qreal afterScale = scale * qMax(qAbs(project.value("HScale").toDouble()), qAbs(project.value("VScale").toDouble()));
+        const QImage after = ImageMetadata::read(ar, afterSize.scaled((QSizeF(afterSize) * qBound(0.01, afterScale * 2, 1.0)).toSize().expandedTo(QSize(1, 1)), Qt::KeepAspectRatio));
+        p.save();
+        p.setTransform(ProjectValues::afterTransform(project), true);
+        p.drawImage(QRectF(QPointF(0, 0), afterSize), after);
+        p.restore();
+        p.setClipRect(QRectF(0, 0, beforeSize.width() / 2.0, beforeSize.height()));
+    }
+    p.drawImage(beforeRect, before);
+    p.end();
+    return out;
+}
@@ -0,0 +1,39 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QMap>
+#include <QVariant>
+#include <QThreadPool>
+
+// Miniatyrer per projekt, i minnet och som PNG i cachekatalogen. Nyckeln
+// bygger på bildernas sökvägar, ändringstider och transformen, så en ändring
+// i någon av dem ger en ny miniatyr. Saknade miniatyrer skapas i bakgrunden
+// från en nedskalad avkodning och meddelas med ready().
+
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    ThumbnailCache(QObject* parent = nullptr);
+    static QString key(const QMap<QString,QVariant>& project);
+    // Null-bild om miniatyren inte finns ännu
+    QImage thumbnail(const QString& key, const QMap<QString,QVariant>& project);
+    // Förebilden till vänster, den transformerade efterbilden till höger
+    static QImage render(const QMap<QString,QVariant>& project, const QSize& size);
+    static QSize thumbnailSize() { return QSize(128, 96); }
+signals:
+    void ready(const QString& key);
+private:
+    QString filePath(const QString& key) const;
+    QString m_Dir;
+    QCache<QString,QImage> m_Memory;
+    QSet<QString> m_Pending;
+    // Sist, så att pågående jobb väntas in innan resten förstörs
+    QThreadPool m_Pool;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,72 @@
+#include "tilecache.h"
+#include "stripexport.h"
+#include <QMutexLocker>
+#include <QSharedPointer>
+
+TileCache::TileCache(qint64 budget, QObject* parent) : QObject(parent)
+{
+    // Kostnaden räknas i kB
+    m_Cache.setMaxCost(qMax<qint64>(1, budget / 1024));
+    m_Pool.setMaxThreadCount(1);
+}
+
+void TileCache::request(const QString& path, const QRect& rect, const QSize& imageSize)
+{
+    const QRect area = rect.intersected(QRect(QPoint(0,0), imageSize));
+    QSet<QString> wanted;
+    QRect missing;
+    if (!path.isEmpty() && !area.isEmpty()) {
+        for (int ty = area.top() / tileSize; ty <= area.bottom() / tileSize; ty++) {
+            for (int tx = area.left() / tileSize; tx <= area.right() / tileSize; tx++) {
+                const QString k = key(path, tx, ty);
+                wanted.insert(k);
+                if (!m_Cache.contains(k) && !m_Pending.contains(k)) missing |= QRect(tx, ty, 1, 1);
+            }
+        }
+    }
+    {
+        QMutexLocker lock(&m_WantedMutex);
+        m_Wanted.insert(path, wanted);
+    }
+    if (missing.isEmpty()) return;
+
+    // Saknade rutor avkodas i ett svep, JPEG läses ändå radvis ner till blockets slut
+    const QRect tiles = missing;
+    const QRect block = QRect(tiles.x() * tileSize, tiles.y() * tileSize, tiles.width() * tileSize, tiles.height() * tileSize)
+                            .intersected(QRect(QPoint(0,0), imageSize));
+    for (int ty = tiles.top(); ty <= tiles.bottom(); ty++) {
+        for (int tx = tiles.left(); tx <= tiles.right(); tx++) m_Pending.insert(key(path, tx, ty));
+    }
+    m_Pool.start([this, path, tiles, block]() {
+        bool stillWanted = false;
+        {
+            QMutexLocker lock(&m_WantedMutex);
+            const QSet<QString>& w = m_Wanted[path];
+            for (int ty = tiles.top(); ty <= tiles.bottom() && !stillWanted; ty++) {
+                for (int tx = tiles.left(); tx <= tiles.right() && !stillWanted; tx++) stillWanted = w.contains(key(path, tx, ty));
+            }
+        }
+        // Pekaren har flyttat sig, hoppa över jobbet
+        QSharedPointer<QImage> image(new QImage);
+        if (stillWanted) *image = StripReader(path).read(block);
+        QMetaObject::invokeMethod(this, [this, path, tiles, block, image]() {
+            for (int ty = tiles.top(); ty <= tiles.bottom(); ty++) {
+                for (int tx = tiles.left(); tx <= tiles.right(); tx++) {
+                    const QString k = key(path, tx, ty);
+                    m_Pending.remove(k);
+                    if (image->isNull()) continue;
+                    const QRect r = QRect(tx * tileSize, ty * tileSize, tileSize, tileSize).intersected(block);
+                    QImage* t = new QImage(image->copy(r.translated(-block.topLeft())));
+                    m_Cache.insert(k, t, qMax<qsizetype>(1, t->sizeInBytes() / 1024));
+                }
+            }
+            if (!image->isNull()) emit ready();
+        }, Qt::QueuedConnection);
+    });
+}
+
+QImage TileCache::tile(const QString& path, int tx, int ty) const
+{
+    const QImage* t = m_Cache.object(key(path, tx, ty));
+    return t ? *t : QImage();
+}
@@ -0,0 +1,40 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
+
+// Rutor om tileSize x tileSize ur originalbilder i full upplösning, för luppen.
+// request() köar avkodningen av det som saknas på en egen tråd, tile() lämnar
+// bara ut det som redan finns. Ett nytt request() för samma bild ersätter det
+// förra: köade jobb som inte längre efterfrågas hoppas över. Nya rutor
+// meddelas med ready().
+
+class TileCache : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int tileSize = 256;
+    TileCache(qint64 budget, QObject* parent = nullptr);
+    // Rutorna som täcker rect (i bildens pixlar) behövs
+    void request(const QString& path, const QRect& rect, const QSize& imageSize);
+    // Rutan (tx, ty) om den är avkodad, annars null
+    QImage tile(const QString& path, int tx, int ty) const;
+signals:
+    void ready();
+private:
+    static QString key(const QString& path, int tx, int ty) { return QString("%1|%2|%3").arg(path).arg(tx).arg(ty); }
+    QCache<QString,QImage> m_Cache;
+    QSet<QString> m_Pending;
+    QMutex m_WantedMutex;
+    QHash<QString,QSet<QString>> m_Wanted;
+    // Sist, så att pågående jobb väntas in innan resten förstörs
+    QThreadPool m_Pool;
+};
+
+#endif // TILECACHE_H
@@ -0,0 +1,181 @@
+#include "wipeanimation.h"
+#include <QFile>
+#include <QBuffer>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDebug>
+#include <qmath.h>
+
+static void appendUInt16LE(QByteArray& a, quint16 v)
+{
+    a.append(char(v));
+    a.append(char(v >> 8));
+}
+
+static void appendUInt32LE(QByteArray& a, quint32 v)
+{
+    a.append(char(v));
+    a.append(char(v >> 8));
+    a.append(char(v >> 16));
+    a.append(char(v >> 24));
+}
+
+bool AviMjpegWriter::writeUInt32At(qint64 pos, quint32 value)
+{
+    QByteArray a;
+    appendUInt32LE(a, value);
+    return m_Device->seek(pos) && m_Device->write(a) == 4;
+}
+
+bool AviMjpegWriter::begin(const QSize& size, int fps)
+{
+    const qint64 base = m_Device->pos();
+    m_RiffPos = base;
+    QByteArray h;
+    h.append("RIFF", 4);
+    appendUInt32LE(h, 0);               // fylls i av finish()
+    h.append("AVI ", 4);
+    h.append("LIST", 4);
+    appendUInt32LE(h, 4 + 64 + 12 + 64 + 48);
+    h.append("hdrl", 4);
+
+    h.append("avih", 4);
+    appendUInt32LE(h, 56);
+    appendUInt32LE(h, quint32(1000000 / qMax(1, fps)));
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, 0x10);            // AVIF_HASINDEX
+    m_TotalFramesPos = base + h.size();
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, 1);               // en ström
+    m_AvihBufferPos = base + h.size();
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, quint32(size.width()));
+    appendUInt32LE(h, quint32(size.height()));
+    h.append(16, '\0');
+
+    h.append("LIST", 4);
+    appendUInt32LE(h, 4 + 64 + 48);
+    h.append("strl", 4);
+    h.append("strh", 4);
+    appendUInt32LE(h, 56);
+    h.append("vids", 4);
+    h.append("MJPG", 4);
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, 0);               // prioritet och språk
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, 1);               // dwScale
+    appendUInt32LE(h, quint32(fps));    // dwRate
+    appendUInt32LE(h, 0);
+    m_LengthPos = base + h.size();
+    appendUInt32LE(h, 0);
+    m_StrhBufferPos = base + h.size();
+    appendUInt32LE(h, 0);
+    appendUInt32LE(h, quint32(-1));     // standardkvalitet
+    appendUInt32LE(h, 0);
+    appendUInt16LE(h, 0);
+    appendUInt16LE(h, 0);
+    appendUInt16LE(h, quint16(size.width()));
+    appendUInt16LE(h, quint16(size.height()));
+
+    h.append("strf", 4);
+    appendUInt32LE(h, 40);
+    appendUInt32LE(h, 40);
+    appendUInt32LE(h, quint32(size.width()));
+    appendUInt32LE(h, quint32(size.height()));
+    appendUInt16LE(h, 1);
+    appendUInt16LE(h, 24);
+    h.append("MJPG", 4);
+    appendUInt32LE(h, quint32(size.width() * size.height() * 3));
+    h.append(16, '\0');
+
+    h.append("LIST", 4);
+    appendUInt32LE(h, 0);               // fylls i av finish()
+    m_MoviPos = base + h.size();
+    h.append("movi", 4);
+    m_Index.clear();
+    m_Frames = 0;
+    m_MaxFrameSize = 0;
+    return m_Device->write(h) == h.size();
+}
+
+bool AviMjpegWriter::addFrame(const QByteArray& jpeg)
+{
+    // Indexets offset räknas från 'movi'
+    m_Index.append("00dc", 4);
+    appendUInt32LE(m_Index, 0x10);      // AVIIF_KEYFRAME
+    appendUInt32LE(m_Index, quint32(m_Device->pos() - m_MoviPos));
+    appendUInt32LE(m_Index, quint32(jpeg.size()));
+    QByteArray chunk("00dc", 4);
+    appendUInt32LE(chunk, quint32(jpeg.size()));
+    if (m_Device->write(chunk) != chunk.size()) return false;
+    if (m_Device->write(jpeg) != jpeg.size()) return false;
+    if (jpeg.size() % 2 && m_Device->write("\0", 1) != 1) return false;
+    m_MaxFrameSize = qMax(m_MaxFrameSize, quint32(jpeg.size()));
+    ++m_Frames;
+    return true;
+}
+
+bool AviMjpegWriter::finish()
+{
+    const qint64 moviEnd = m_Device->pos();
+    QByteArray idx("idx1", 4);
+    appendUInt32LE(idx, quint32(m_Index.size()));
+    if (m_Device->write(idx) != idx.size() || m_Device->write(m_Index) != m_Index.size()) return false;
+    const qint64 end = m_Device->pos();
+    return writeUInt32At(m_RiffPos + 4, quint32(end - m_RiffPos - 8))
+        && writeUInt32At(m_MoviPos - 4, quint32(moviEnd - m_MoviPos))
+        && writeUInt32At(m_TotalFramesPos, m_Frames)
+        && writeUInt32At(m_LengthPos, m_Frames)
+        && writeUInt32At(m_AvihBufferPos, m_MaxFrameSize + 8)
+        && writeUInt32At(m_StrhBufferPos, m_MaxFrameSize + 8)
+        && m_Device->seek(end);
+}
+
+qreal WipeAnimation::position(int frame, int frames)
+{
+    if (frames < 2) return 1;
+    const qreal u = qreal(frame) / (frames - 1);
+    const qreal pingPong = u < 0.5 ? 2 * u : 2 - 2 * u;
+    return 0.5 - 0.5 * qCos(M_PI * pingPong);
+}
+
+bool WipeAnimation::render(const QString& path, const Renderer& renderer) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "WipeAnimation: cannot write" << path;
+        return false;
+    }
+    AviMjpegWriter avi(&file);
+    if (!avi.begin(m_FrameSize, m_Fps)) return false;
+    const auto encodeFrame = [this, &renderer](const int& frame) {
+        QImage image(m_FrameSize, QImage::Format_RGB32);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        renderer(painter, position(frame, m_Frames));
+        painter.end();
+        QByteArray jpeg;
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "JPG", m_Quality);
+        return jpeg;
+    };
+    // En omgång rutor per tråd åt gången, de skrivs i ordning när omgången är klar
+    const int batch = qMax(1, QThread::idealThreadCount());
+    for (int first = 0; first < m_Frames; first += batch) {
+        QList<int> frames;
+        for (int i = first; i < qMin(m_Frames, first + batch); ++i) frames.append(i);
+        const QList<QByteArray> jpegs = QtConcurrent::blockingMapped<QList<QByteArray>>(frames, encodeFrame);
+        for (const QByteArray& jpeg : jpegs) {
+            if (jpeg.isEmpty() || !avi.addFrame(jpeg)) {
+                qWarning() << "WipeAnimation: write failed" << path;
+                return false;
+            }
+        }
+    }
+    return avi.finish();
+}
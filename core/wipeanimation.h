@@ -0,0 +1,56 @@
+#ifndef WIPEANIMATION_H
+#define WIPEANIMATION_H
+
+#include <QImage>
+#include <QPainter>
+#include <QIODevice>
+#include <functional>
+
+// Minimal AVI med en MJPEG-ström. Bildrutorna strömmas till enheten när de
+// läggs till, endast indexet (16 byte per ruta) hålls i minnet tills finish()
+// skriver det och fyller i storlekarna i huvudet. Enheten måste gå att söka i.
+
+class AviMjpegWriter
+{
+public:
+    AviMjpegWriter(QIODevice* device) : m_Device(device) {}
+    bool begin(const QSize& size, int fps);
+    bool addFrame(const QByteArray& jpeg);
+    bool finish();
+private:
+    bool writeUInt32At(qint64 pos, quint32 value);
+    QIODevice* m_Device;
+    QByteArray m_Index;
+    qint64 m_RiffPos = 0;
+    qint64 m_MoviPos = 0;
+    quint32 m_Frames = 0;
+    quint32 m_MaxFrameSize = 0;
+    qint64 m_TotalFramesPos = 0;
+    qint64 m_LengthPos = 0;
+    qint64 m_AvihBufferPos = 0;
+    qint64 m_StrhBufferPos = 0;
+};
+
+// Renderar en svepanimation ruta för ruta. Rutorna ritas parallellt i omgångar
+// om en per tråd och kodas direkt till JPEG, så minnet är detsamma oavsett
+// antalet rutor.
+
+class WipeAnimation
+{
+public:
+    // Ritar en ruta, position går 0..1. Anropas från flera trådar samtidigt.
+    typedef std::function<void(QPainter& painter, qreal position)> Renderer;
+
+    WipeAnimation(const QSize& frameSize, int frames, int fps = 30, int quality = 85)
+        : m_FrameSize(frameSize), m_Frames(frames), m_Fps(fps), m_Quality(quality) {}
+    bool render(const QString& path, const Renderer& renderer) const;
+    // Fram och tillbaka med mjuk start och stopp
+    static qreal position(int frame, int frames);
+private:
+    QSize m_FrameSize;
+    int m_Frames;
+    int m_Fps;
+    int m_Quality;
+};
+
+#endif // WIPEANIMATION_H
@@ -0,0 +1,210 @@
+#include <QCoreApplication>
+#include <QSettings>
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QTextStream>
+#include <QDebug>
+#include <atomic>
+#include "projectstore.h"
+#include "exportoptions.h"
+#include "imagepair.h"
+#include "gallerywriter.h"
+#include "gallerybundle.h"
+#include "autoalign.h"
+#include "projectvalues.h"
+#include "imagemetadata.h"
+#include "regression.h"
+#include "previewserver.h"
+
+// Fönsterlös körning mot samma projekt och inställningar som programmet.
+//   BeforeAfterRunner list [--by-date] [--info]
+//   BeforeAfterRunner export <dir> [--title <title>] [project ...]
+//   BeforeAfterRunner export <file.zip|file.tar|-> [--title <title>] [project ...]
+//   BeforeAfterRunner align [project ...]
+//   BeforeAfterRunner verify <golden dir> [--record] [--samples <dir>] [--slack <factor>]
+//   BeforeAfterRunner serve <dir|file.zip|file.tar> [--port <port>]
+
+static int usage()
+{
+    QTextStream(stderr) << "usage: BeforeAfterRunner list [--by-date] [--info]\n"
+                           "       BeforeAfterRunner export <dir|file.zip|file.tar|-> [--title <title>] [--hashed] [project ...]\n"
+                           "       BeforeAfterRunner align [project ...]\n"
+                           "       BeforeAfterRunner verify <golden dir> [--record] [--samples <dir>] [--slack <factor>]\n"
+                           "       BeforeAfterRunner serve <dir|file.zip|file.tar> [--port <port>]\n";
+    return 1;
+}
+
+// Alla projekt om names är tom, annars de namngivna i listans ordning
+static QList<int> selectProjects(const QList<QMap<QString,QVariant>>& projects, const QStringList& names)
+{
+    QList<int> indexes;
+    for (int i = 0; i < projects.size(); i++) {
+        if (names.isEmpty() || names.contains(projects[i].value("ProjectName").toString())) indexes.append(i);
+    }
+    return indexes;
+}
+
+static int exportProjects(const QList<QMap<QString,QVariant>>& projects, ExportOptions options, QStringList args)
+{
+    if (args.isEmpty()) return usage();
+    const QString target = args.takeFirst();
+    // Ett arkiv i stället för en mapp, - skriver ZIP till standard ut
+    const bool toStdout = target == "-";
+    const bool bundled = toStdout || target.endsWith(".zip", Qt::CaseInsensitive) || target.endsWith(".tar", Qt::CaseInsensitive);
+    const QString dirPath = QDir(target).absolutePath();
+    QString title = "Before/After Gallery";
+    const int t = args.indexOf("--title");
+    if (t > -1) {
+        if (t + 1 >= args.size()) return usage();
+        title = args[t + 1];
+        args.remove(t, 2);
+    }
+    // Innehållsnamn och förkomprimerade filer för ett statiskt webbhotell
+    if (args.removeAll("--hashed") > 0) options.hashedAssets = true;
+    QList<ImagePair> pairs;
+    for (int i : selectProjects(projects, args)) pairs.append(ImagePair(projects[i]));
+    if (pairs.isEmpty()) return 1;
+
+    // Paren exporteras parallellt, budgeten delas mellan trådarna
+    const int threads = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    ExportOptions perThread = options;
+    perThread.memoryBudgetMB = qMax(16, options.memoryBudgetMB / qMin<int>(threads, pairs.size()));
+    QElapsedTimer timer;
+    timer.start();
+    std::atomic<int> failed(0);
+    if (bundled) {
+        QFile file(dirPath);
+        if (!(toStdout ? file.open(stdout, QIODevice::WriteOnly) : file.open(QIODevice::WriteOnly))) {
+            qWarning() << "Cannot write" << target;
+            return 1;
+        }
+        // Högst en arbetsmapp per tråd ligger på disk samtidigt
+        GalleryBundle bundle(&file, toStdout ? ArchiveWriter::Zip : ArchiveWriter::formatFor(dirPath), options);
+        if (!bundle.isValid()) return 1;
+        QtConcurrent::blockingMap(pairs, [&](ImagePair& pair) {
+            bool ok = pair.exportFolder(bundle.stagingDir(pair.name()), perThread);
+            if (!bundle.addProject(pair.name(), pair.project())) ok = false;
+            if (!ok) {
+                qWarning() << "Export failed:" << pair.name();
+                ++failed;
+            }
+        });
+        if (!bundle.finish(title)) return 1;
+    }
+    else {
+        QtConcurrent::blockingMap(pairs, [&](ImagePair& pair) {
+            if (!pair.exportFolder(QDir(dirPath).filePath(pair.name()), perThread)) {
+                qWarning() << "Export failed:" << pair.name();
+                ++failed;
+            }
+        });
+        GalleryWriter(options).write(dirPath, title, projects);
+    }
+    QTextStream(toStdout ? stderr : stdout) << pairs.size() - failed << " of " << pairs.size() << " exported in " << timer.elapsed() << " ms\n";
+    return failed ? 1 : 0;
+}
+
+// Projektnamnen, med info även förebildens storlek och tagningstid. Allt
+// kommer ur bildhuvudena, inga pixlar avkodas.
+static int listProjects(const QList<QMap<QString,QVariant>>& projects, bool byDate, bool info)
+{
+    QTextStream out(stdout);
+    if (!byDate && !info) {
+        for (const QMap<QString,QVariant>& p : projects) out << p.value("ProjectName").toString() << "\n";
+        return 0;
+    }
+    MetadataIndex index;
+    QStringList paths;
+    for (const QMap<QString,QVariant>& p : projects) paths << p.value("BeforePix").toString();
+    index.scan(paths);
+    QList<int> order = selectProjects(projects, QStringList());
+    QList<ImageInfo> infos;
+    for (const QString& path : std::as_const(paths)) infos.append(index.info(path));
+    if (byDate) std::stable_sort(order.begin(), order.end(), [&infos](int a, int b) { return infos[a].captured < infos[b].captured; });
+    for (int i : order) {
+        out << projects[i].value("ProjectName").toString();
+        if (info) out << "\t" << infos[i].size.width() << "x" << infos[i].size.height() << "\t" << infos[i].captured.toString(Qt::ISODate);
+        out << "\n";
+    }
+    return 0;
+}
+
+static int alignProjects(QSettings& s, QList<QMap<QString,QVariant>> projects, const QStringList& names)
+{
+    const QList<int> indexes = selectProjects(projects, names);
+    const QList<AutoAlign::Result> results = QtConcurrent::blockingMapped<QList<AutoAlign::Result>>(indexes, [&projects](int i) {
+        return AutoAlign::align(projects[i]);
+    });
+    QTextStream out(stdout);
+    for (int i = 0; i < indexes.size(); i++) {
+        const AutoAlign::Result& r = results[i];
+        QMap<QString,QVariant>& p = projects[indexes[i]];
+        if (r.ok) ProjectValues::setAfterTransform(p, r.transform);
+        p.insert("AlignConfidence", r.confidence);
+        p.insert("NeedsReview", r.needsReview());
+        out << p.value("ProjectName").toString() << "\t" << (r.ok ? "" : "failed ") << r.confidence << (r.needsReview() ? "\treview\n" : "\n");
+    }
+    ProjectStore::save(s, projects);
+    return 0;
+}
+
+// Exporten mot referensbilderna i goldenDir, se Regression
+static int verify(QStringList args)
+{
+    if (args.isEmpty()) return usage();
+    const QString goldenDir = args.takeFirst();
+    const bool record = args.removeAll("--record") > 0;
+    QString samples;
+    double slack = 1.5;
+    for (int i = 0; i + 1 < args.size(); i += 2) {
+        if (args[i] == "--samples") samples = args[i + 1];
+        else if (args[i] == "--slack") slack = args[i + 1].toDouble();
+        else return usage();
+    }
+    Regression regression(goldenDir, record, slack);
+    regression.setSamples(samples);
+    return regression.run();
+}
+
+// Galleriet på loopback tills processen avbryts, en rad per svar
+static int serve(QStringList args)
+{
+    if (args.isEmpty()) return usage();
+    const QString root = args.takeFirst();
+    quint16 port = 0;
+    const int p = args.indexOf("--port");
+    if (p > -1) {
+        if (p + 1 >= args.size()) return usage();
+        port = quint16(args[p + 1].toUInt());
+    }
+    PreviewServer server;
+    if (!server.start(root, port)) return 1;
+    QTextStream out(stdout);
+    out << server.url().toString() << Qt::endl;
+    QObject::connect(&server, &PreviewServer::served, [&out, &server](const PreviewServer::Request& r) {
+        out << r.toString() << "\t(" << server.pageRequests() << " requests, " << server.pageBytes() << " B since page)" << Qt::endl;
+    });
+    return QCoreApplication::exec();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments().mid(1);
+    if (args.isEmpty()) return usage();
+    const QString command = args.takeFirst();
+
+    QSettings s("Veinge Musik och Data","BeforeAfter");
+    ExportOptions options;
+    options.load(s);
+    const QList<QMap<QString,QVariant>> projects = ProjectStore::load(s);
+
+    if (command == "list") return listProjects(projects, args.contains("--by-date"), args.contains("--info"));
+    if (command == "export") return exportProjects(projects, options, args);
+    if (command == "align") return alignProjects(s, projects, args);
+    if (command == "verify") return verify(args);
+    if (command == "serve") return serve(args);
+    return usage();
+}
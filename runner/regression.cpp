@@ -0,0 +1,308 @@
+#include "regression.h"
+#include "imagepair.h"
+#include "projectvalues.h"
+#include "anchorsolver.h"
+#include "autoalign.h"
+#include "gallerywriter.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <qmath.h>
+
+static const QSize syntheticBefore(1600, 1200);
+static const QSize syntheticAfter(1400, 1100);
+
+// Mjuka vågor för omsamplingen och skarpa block för kanterna, definierad överallt
+static QRgb pattern(double x, double y, const QSize& size)
+{
+    const int block = (qFloor(x / 97) + qFloor(y / 89)) & 1 ? 40 : 0;
+    const int r = qBound(0, int(128 + 100 * qSin(x / 23) * qCos(y / 31)) + block, 255);
+    const int g = qBound(0, int(128 + 100 * qSin((x + y) / 47)), 255);
+    const int b = qBound(0, int(255 * x / size.width()) - block, 255);
+    return qRgb(r, g, b);
+}
+
+// Efterbilden samplas ur mönstret genom t (efter -> före), utan omsampling
+static QImage syntheticImage(const QSize& size, const QTransform& t)
+{
+    QImage image(size, QImage::Format_RGB32);
+    for (int y = 0; y < size.height(); y++) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < size.width(); x++) {
+            const QPointF p = t.map(QPointF(x + 0.5, y + 0.5)) - QPointF(0.5, 0.5);
+            line[x] = pattern(p.x(), p.y(), syntheticBefore);
+        }
+    }
+    return image;
+}
+
+// PSNR och största avvikelse efter nedskalning till en fjärdedel, så att
+// halvpixelförskjutningar och kodningsbrus inte räknas som fel
+static void difference(const QImage& a, const QImage& b, double* psnr, int* maxDiff)
+{
+    const QSize small = (a.size() / 4).expandedTo(QSize(1, 1));
+    const QImage sa = a.convertToFormat(QImage::Format_RGB32).scaled(small, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    const QImage sb = b.convertToFormat(QImage::Format_RGB32).scaled(small, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    double sum = 0;
+    *maxDiff = 0;
+    for (int y = 0; y < small.height(); y++) {
+        const QRgb* la = reinterpret_cast<const QRgb*>(sa.constScanLine(y));
+        const QRgb* lb = reinterpret_cast<const QRgb*>(sb.constScanLine(y));
+        for (int x = 0; x < small.width(); x++) {
+            for (const int d : { qRed(la[x]) - qRed(lb[x]), qGreen(la[x]) - qGreen(lb[x]), qBlue(la[x]) - qBlue(lb[x]) }) {
+                sum += d * d;
+                *maxDiff = qMax(*maxDiff, qAbs(d));
+            }
+        }
+    }
+    const double mse = sum / (3.0 * small.width() * small.height());
+    *psnr = mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99;
+}
+
+// Största avståndet mellan två transformer över ett rutnät i bilden
+static double residual(const QTransform& a, const QTransform& b, const QSize& size)
+{
+    double worst = 0;
+    for (int j = 0; j <= 10; j++) {
+        for (int i = 0; i <= 10; i++) {
+            const QPointF p(size.width() * i / 10.0, size.height() * j / 10.0);
+            const QPointF d = a.map(p) - b.map(p);
+            worst = qMax(worst, qHypot(d.x(), d.y()));
+        }
+    }
+    return worst;
+}
+
+static QMap<QString,QVariant> newProject(const QString& name, const QString& before, const QString& after, const QTransform& t)
+{
+    QMap<QString,QVariant> p;
+    p.insert("ProjectName", name);
+    p.insert("BeforePix", before);
+    p.insert("AfterPix", after);
+    p.insert("ViewMode", 0);
+    p.insert("Transparancy", 0.5);
+    ProjectValues::setAfterTransform(p, t);
+    return p;
+}
+
+// Fasta exportinställningar, oberoende av användarens
+static ExportOptions regressionOptions(int budgetMB)
+{
+    ExportOptions o;
+    o.imageFormat = ExportOptions::Png;
+    o.memoryBudgetMB = budgetMB;
+    return o;
+}
+
+Regression::Regression(const QString& goldenDir, bool record, double slack)
+    : m_Golden(QDir(goldenDir).absolutePath()), m_Record(record), m_Slack(slack)
+{
+}
+
+void Regression::skip(const QString& name)
+{
+    m_Skipped++;
+    QTextStream(stdout) << "skip  " << name << "  no references\n";
+}
+
+void Regression::check(const QString& name, bool ok, const QString& detail)
+{
+    m_Checks++;
+    if (!ok) m_Failed++;
+    QTextStream(stdout) << (ok ? "ok    " : "FAIL  ") << name << (detail.isEmpty() ? "" : "  " + detail) << "\n";
+}
+
+void Regression::timed(const QString& name, const std::function<void()>& f)
+{
+    QElapsedTimer timer;
+    timer.start();
+    f();
+    m_Timings[name] = timer.elapsed();
+}
+
+void Regression::compareImage(const QString& name, const QString& path)
+{
+    const QString golden = m_Golden + "/" + name;
+    const QImage image(path);
+    if (m_Record) {
+        QDir().mkpath(QFileInfo(golden).path());
+        check(name, image.save(golden, "PNG"), "recorded");
+        return;
+    }
+    if (!m_References) {
+        check(name + " readable", !image.isNull());
+        skip(name);
+        return;
+    }
+    const QImage reference(golden);
+    if (image.isNull() || reference.isNull() || image.size() != reference.size()) {
+        check(name, false, reference.isNull() ? "no reference" : "size differs");
+        return;
+    }
+    double psnr;
+    int maxDiff;
+    difference(image, reference, &psnr, &maxDiff);
+    check(name, psnr >= 38 && maxDiff <= 32, QString("%1 dB, max %2").arg(psnr, 0, 'f', 1).arg(maxDiff));
+}
+
+void Regression::compareFile(const QString& name, const QString& path)
+{
+    const QString golden = m_Golden + "/" + name;
+    QFile file(path);
+    const QByteArray data = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    if (m_Record) {
+        QFile out(golden);
+        check(name, out.open(QIODevice::WriteOnly) && out.write(data) == data.size(), "recorded");
+        return;
+    }
+    if (!m_References) {
+        check(name + " written", !data.isEmpty());
+        skip(name);
+        return;
+    }
+    QFile reference(golden);
+    check(name, reference.open(QIODevice::ReadOnly) && reference.readAll() == data);
+}
+
+void Regression::exportCase(const QString& name, const QMap<QString,QVariant>& project, const QString& workDir)
+{
+    const QString dir = workDir + "/export/" + name;
+    bool ok = false;
+    timed(name, [&]() {
+        ImagePair pair(project);
+        ok = pair.exportFolder(dir, regressionOptions(256));
+    });
+    check(name + " export", ok);
+    if (!ok) return;
+    compareImage(name + "/before.png", dir + "/before.png");
+    compareImage(name + "/after.png", dir + "/after.png");
+    m_Projects.append(project);
+}
+
+void Regression::syntheticCases(const QString& workDir)
+{
+    const QList<QPair<QString,QTransform>> cases = {
+        { "identity", QTransform() },
+        { "similarity", QTransform().translate(120, -80).rotate(7).scale(1.1, 1.1) },
+        { "perspective", QTransform(1.02, 0.03, 0.00004, -0.02, 0.98, 0.00002, 30, 20, 1) }
+    };
+    for (const QPair<QString,QTransform>& c : cases) {
+        // Transformen som den blir efter projektpostens uppdelning
+        QMap<QString,QVariant> project = newProject(c.first, "", "", c.second);
+        const QTransform t = ProjectValues::afterTransform(project);
+        const QString source = workDir + "/synthetic/" + c.first;
+        QDir().mkpath(source);
+        syntheticImage(syntheticBefore, QTransform()).save(source + "/before.png");
+        syntheticImage(syntheticAfter, t).save(source + "/after.png");
+        project.insert("BeforePix", source + "/before.png");
+        project.insert("AfterPix", source + "/after.png");
+        exportCase(c.first, project, workDir);
+
+        // Omsamplad efterbild mot förebilden i mitten, där båda finns
+        const QString exported = workDir + "/export/" + c.first + "/after.png";
+        const QRect centre(syntheticBefore.width() / 4, syntheticBefore.height() / 4, syntheticBefore.width() / 2, syntheticBefore.height() / 2);
+        double psnr;
+        int maxDiff;
+        difference(QImage(exported).copy(centre), QImage(source + "/before.png").copy(centre), &psnr, &maxDiff);
+        check(c.first + " matches before", psnr >= 30, QString("%1 dB").arg(psnr, 0, 'f', 1));
+
+        // Bandvis i minsta budget ska ge samma bild
+        const QString banded = workDir + "/banded/" + c.first;
+        const bool ok = ImagePair(project).exportFolder(banded, regressionOptions(1));
+        difference(QImage(exported), QImage(banded + "/after.png"), &psnr, &maxDiff);
+        check(c.first + " banded", ok && psnr >= 50, QString("%1 dB, max %2").arg(psnr, 0, 'f', 1).arg(maxDiff));
+
+        // Automatisk justering utan ankare, bara likformigheter kan hittas
+        if (t.type() <= QTransform::TxRotate) {
+            const AutoAlign::Result r = AutoAlign::align(project);
+            const double d = residual(r.transform, t, syntheticAfter);
+            check(c.first + " auto-align", r.ok && d <= syntheticBefore.width() * 0.005, QString("%1 px").arg(d, 0, 'f', 2));
+        }
+    }
+}
+
+void Regression::solverCases()
+{
+    const QSize size(4000, 3000);
+    const QList<QPointF> after = { QPointF(400, 300), QPointF(3600, 500), QPointF(2000, 2700), QPointF(300, 2600),
+                                   QPointF(3500, 2800), QPointF(1800, 1200) };
+    const QList<QPair<QString,QTransform>> cases = {
+        { "translation", QTransform::fromTranslate(35.5, -12.25) },
+        { "similarity", QTransform().translate(80, 40).rotate(-3.5).scale(0.97, 0.97) },
+        { "affine", QTransform(1.01, 0.02, -0.015, 0.99, 25, -30) },
+        { "homography", QTransform(1.01, 0.02, 0.00003, -0.015, 0.99, -0.00002, 25, -30, 1) }
+    };
+    for (int i = 0; i < cases.size(); i++) {
+        const int n = i < 3 ? i + 1 : int(after.size());
+        QList<QPointF> a = after.mid(0, n);
+        QList<QPointF> b;
+        for (const QPointF& p : a) b << cases[i].second.map(p);
+        const QTransform solved = i < 3 ? AnchorSolver::fromPoints(a, b) : AnchorSolver::homography(a, b);
+        const double d = residual(solved, cases[i].second, size);
+        check("solver " + cases[i].first, d <= 0.01, QString("%1 px").arg(d, 0, 'g', 3));
+    }
+}
+
+void Regression::sampleCases(const QString& workDir)
+{
+    const QDir samples(m_Samples);
+    for (const QString& name : samples.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name)) {
+        const QDir dir(samples.filePath(name));
+        if (!dir.exists("before.jpg") || !dir.exists("after.jpg")) continue;
+        QMap<QString,QVariant> project = newProject(name, dir.filePath("before.jpg"), dir.filePath("after.jpg"), QTransform());
+        // Justeringen räknas in i fallets tid
+        QElapsedTimer timer;
+        timer.start();
+        const AutoAlign::Result r = AutoAlign::align(project);
+        if (r.ok) ProjectValues::setAfterTransform(project, r.transform);
+        const qint64 alignTime = timer.elapsed();
+        exportCase(name, project, workDir);
+        m_Timings[name] = m_Timings.value(name).toInteger() + alignTime;
+    }
+}
+
+int Regression::run()
+{
+    QTemporaryDir work;
+    if (!work.isValid()) return 1;
+    // Referenserna jämförs bara när de finns, lösarna och exportens egna
+    // kontroller körs alltid. Mappen skapas bara vid inspelning.
+    if (m_Record) QDir().mkpath(m_Golden);
+    QFile budgets(m_Golden + "/budgets.json");
+    m_References = !m_Record && budgets.open(QIODevice::ReadOnly);
+    if (m_References) m_Budgets = QJsonDocument::fromJson(budgets.readAll()).object();
+    budgets.close();
+
+    solverCases();
+    syntheticCases(work.path());
+    if (!m_Samples.isEmpty()) sampleCases(work.path());
+    GalleryWriter(regressionOptions(256)).write(work.path() + "/export", "Regression", m_Projects);
+    compareFile("gallery.json", work.path() + "/export/gallery.json");
+    compareFile("index.html", work.path() + "/export/index.html");
+
+    // Tidsbudgetar: uppmätt tid gånger slack, med lite marginal för korta fall
+    for (auto it = m_Timings.constBegin(); it != m_Timings.constEnd(); ++it) {
+        const qint64 ms = it.value().toInteger();
+        if (m_Record) continue;
+        if (!m_References) {
+            skip(it.key() + " time");
+            continue;
+        }
+        if (!m_Budgets.contains(it.key())) {
+            check(it.key() + " time", false, QString("%1 ms, no budget").arg(ms));
+            continue;
+        }
+        const qint64 budget = m_Budgets.value(it.key()).toInteger();
+        check(it.key() + " time", ms <= budget * m_Slack + 100, QString("%1 ms, budget %2 ms").arg(ms).arg(budget));
+    }
+    if (m_Record) {
+        if (budgets.open(QIODevice::WriteOnly)) budgets.write(QJsonDocument(m_Timings).toJson());
+        else check("budgets.json", false, "cannot write");
+    }
+    QTextStream(stdout) << m_Checks - m_Failed << " of " << m_Checks << " checks passed, " << m_Skipped << " skipped\n";
+    return m_Failed ? 1 : 0;
+}
@@ -0,0 +1,53 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <QString>
+#include <QImage>
+#include <QJsonObject>
+#include <QMap>
+#include <QVariant>
+#include <functional>
+
+// Regressionskontroll av exporten, körs utan fönster från BeforeAfterRunner
+// och från testmålet i tests/.
+// Syntetiska par med kända transformer exporteras och jämförs med sparade
+// referensbilder (perceptuell tolerans), med förebilden själv och med en
+// bandvis export i liten budget. Lösarna kontrolleras mot kända transformer,
+// galleriets filer mot referensen och varje fall mot sin sparade tidsbudget.
+// Med record skrivs referenserna och budgetarna om i stället. Utan budgets.json
+// i goldenDir hoppas jämförelserna med referenser och tider över.
+
+class Regression
+{
+public:
+    Regression(const QString& goldenDir, bool record, double slack);
+    // Mapp med exempelprojekt (undermappar med before.jpg och after.jpg)
+    void setSamples(const QString& dir) { m_Samples = dir; }
+    // 0 om allt stämmer
+    int run();
+    // Jämförelser som hoppades över för att referenserna saknas
+    int skipped() const { return m_Skipped; }
+private:
+    void skip(const QString& name);
+    void check(const QString& name, bool ok, const QString& detail = QString());
+    void timed(const QString& name, const std::function<void()>& f);
+    void compareImage(const QString& name, const QString& path);
+    void compareFile(const QString& name, const QString& path);
+    void exportCase(const QString& name, const QMap<QString,QVariant>& project, const QString& workDir);
+    void syntheticCases(const QString& workDir);
+    void solverCases();
+    void sampleCases(const QString& workDir);
+    QString m_Golden;
+    QString m_Samples;
+    bool m_Record;
+    bool m_References = false;
+    double m_Slack;
+    QJsonObject m_Budgets;
+    QJsonObject m_Timings;
+    QList<QMap<QString,QVariant>> m_Projects;
+    int m_Failed = 0;
+    int m_Checks = 0;
+    int m_Skipped = 0;
+};
+
+#endif // REGRESSION_H
@@ -0,0 +1,20 @@
+TARGET = BeforeAfterRunner
+
+QT       -= widgets
+
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp \
+    regression.cpp
+
+HEADERS += \
+    regression.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
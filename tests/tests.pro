@@ -0,0 +1,22 @@
+# Regressionskontrollen som testmål: samma kod som "BeforeAfterRunner verify"
+# mot referenserna i golden/. Spela in dem med
+#   BeforeAfterRunner verify tests/golden --record --samples .
+TARGET = tst_regression
+
+QT       += testlib
+QT       -= widgets
+
+CONFIG += testcase console
+CONFIG -= app_bundle
+
+include(../core/core.pri)
+
+INCLUDEPATH += ../runner
+DEFINES += GOLDEN_DIR=\\\"$$PWD/golden\\\" SAMPLES_DIR=\\\"$$PWD/..\\\"
+
+SOURCES += \
+    tst_regression.cpp \
+    ../runner/regression.cpp
+
+HEADERS += \
+    ../runner/regression.h
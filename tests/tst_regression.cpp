@@ -0,0 +1,24 @@
+#include "regression.h"
+#include <QtTest>
+
+class TestRegression : public QObject
+{
+    Q_OBJECT
+private slots:
+    void verify();
+};
+
+void TestRegression::verify()
+{
+    // Exempelplatserna ligger i förrådets rot
+    Regression regression(GOLDEN_DIR, false, 1.5);
+    regression.setSamples(SAMPLES_DIR);
+    QCOMPARE(regression.run(), 0);
+    if (regression.skipped()) {
+        qWarning("%d comparisons skipped, record references with BeforeAfterRunner verify tests/golden --record --samples .",
+                 regression.skipped());
+    }
+}
+
+QTEST_GUILESS_MAIN(TestRegression)
+#include "tst_regression.moc"